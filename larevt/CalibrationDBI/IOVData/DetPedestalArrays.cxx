@@ -0,0 +1,97 @@
+/**
+ * \file DetPedestalArrays.cxx
+ *
+ * \ingroup IOVData
+ *
+ * \brief Implementation for class DetPedestalArrays
+ */
+
+/** \addtogroup IOVData
+
+    @{*/
+#include "DetPedestalArrays.h"
+#include "IOVDataError.h"
+#include "IOVDataConstants.h"
+#include <algorithm>
+#include <new>
+#include <string>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace lariov {
+
+  void DetPedestalArrays::AlignedDelete::operator()(float* p) const {
+    ::operator delete[](p, std::align_val_t(kPEDESTAL_ALIGNMENT));
+  }
+
+  DetPedestalArrays::AlignedFloats DetPedestalArrays::Allocate(size_t n) {
+    // whole cache lines, so that vector loops may run past the last channel
+    size_t bytes = (n * sizeof(float) + kPEDESTAL_ALIGNMENT - 1) / kPEDESTAL_ALIGNMENT * kPEDESTAL_ALIGNMENT;
+    return AlignedFloats(static_cast<float*>(::operator new[](bytes, std::align_val_t(kPEDESTAL_ALIGNMENT))));
+  }
+
+  void DetPedestalArrays::Fill(const Snapshot<DetPedestal>& data) {
+
+    fValid = false;
+    fNChannels = 0;
+    const std::vector<DetPedestal>& rows = data.Data();
+    if (rows.empty()) {
+      fValid = true;
+      return;
+    }
+
+    unsigned int first = rows.front().Channel();
+    size_t span = size_t(rows.back().Channel() - first) + 1;
+    if (!Snapshot<DetPedestal>::IsDense(span, rows.size())) return;
+
+    if (span > fCapacity) {
+      fMean = Allocate(span);
+      fRms  = Allocate(span);
+      fCapacity = span;
+    }
+    std::fill(fMean.get(), fMean.get() + span, 0.f);
+    std::fill(fRms.get(), fRms.get() + span, 0.f);
+    fPresent.assign(span, 0);
+    for (const DetPedestal& ped: rows) {
+      size_t i = ped.Channel() - first;
+      fMean[i] = ped.PedMean();
+      fRms[i]  = ped.PedRms();
+      fPresent[i] = 1;
+    }
+    fFirstChannel = first;
+    fNChannels = span;
+    fValid = true;
+  }
+
+  void DetPedestalArrays::SubtractPedestals(unsigned int first_ch, size_t n_channels, size_t n_ticks,
+                                            const short* adc, float* out) const {
+    for (size_t c = 0; c < n_channels; ++c) {
+      unsigned int ch = first_ch + c;
+      if (!HasChannel(ch)) {
+        std::string msg("Channel not found: ");
+        msg += std::to_string(ch);
+        throw IOVDataError(msg);
+      }
+      Subtract(adc + c * n_ticks, fMean[ch - fFirstChannel], n_ticks, out + c * n_ticks);
+    }
+  }
+
+  void DetPedestalArrays::Subtract(const short* adc, float ped, size_t n, float* out) {
+    size_t i = 0;
+#ifdef __SSE2__
+    // 8 samples at a time: sign-extend the shorts to int, convert, subtract
+    const __m128 vped = _mm_set1_ps(ped);
+    for (; i + 8 <= n; i += 8) {
+      __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(adc + i));
+      __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+      __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+      _mm_storeu_ps(out + i,     _mm_sub_ps(lo, vped));
+      _mm_storeu_ps(out + i + 4, _mm_sub_ps(hi, vped));
+    }
+#endif
+    for (; i < n; ++i) out[i] = adc[i] - ped;
+  }
+
+}//end namespace lariov
+/** @} */ // end of doxygen group
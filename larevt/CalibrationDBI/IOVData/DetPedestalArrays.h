@@ -0,0 +1,84 @@
+/**
+ * \file DetPedestalArrays.h
+ *
+ * \ingroup IOVData
+ *
+ * \brief Class def header for a class DetPedestalArrays
+ */
+
+/** \addtogroup IOVData
+
+    @{*/
+#ifndef IOVDATA_DETPEDESTALARRAYS_H
+#define IOVDATA_DETPEDESTALARRAYS_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "DetPedestal.h"
+#include "Snapshot.h"
+
+namespace lariov {
+
+  /**
+     \class DetPedestalArrays
+     Pedestal means and RMS of a Snapshot<DetPedestal> as two contiguous
+     float arrays, aligned to kPEDESTAL_ALIGNMENT bytes and indexed by
+     channel - FirstChannel(), for loops over many channels.
+     Channels without a pedestal have mean and RMS 0 (see HasChannel()).
+     Sparse channel sets (see Snapshot::IsDense()) are not converted
+     and leave the arrays invalid.
+  */
+  class DetPedestalArrays {
+
+    public:
+
+      DetPedestalArrays() : fFirstChannel(0), fNChannels(0), fCapacity(0), fValid(false) {}
+
+      /// Rebuild the arrays from the (finalized) snapshot
+      void Fill(const Snapshot<DetPedestal>& data);
+
+      /// Whether the arrays hold the pedestals of the last Fill()
+      bool Valid() const {return fValid;}
+
+      unsigned int FirstChannel() const {return fFirstChannel;}
+      size_t NChannels() const {return fNChannels;}
+
+      bool HasChannel(unsigned int ch) const {
+        size_t i = ch - fFirstChannel; // wraps around below fFirstChannel
+        return fValid && i < fNChannels && fPresent[i];
+      }
+
+      const float* PedMean() const {return fMean.get();}
+      const float* PedRms()  const {return fRms.get();}
+
+      /// Subtract the pedestals of channels first_ch ... first_ch + n_channels - 1
+      /// from their ADC samples: n_ticks samples per channel, channel after channel.
+      /// Throws IOVDataError if a channel has no pedestal (or !Valid()).
+      void SubtractPedestals(unsigned int first_ch, size_t n_channels, size_t n_ticks,
+                             const short* adc, float* out) const;
+
+      /// out[i] = adc[i] - ped for n samples (SIMD where available)
+      static void Subtract(const short* adc, float ped, size_t n, float* out);
+
+    private:
+
+      struct AlignedDelete {
+        void operator()(float* p) const;
+      };
+      using AlignedFloats = std::unique_ptr<float[], AlignedDelete>;
+
+      static AlignedFloats Allocate(size_t n);
+
+      unsigned int fFirstChannel;
+      size_t fNChannels;
+      size_t fCapacity;
+      AlignedFloats fMean;
+      AlignedFloats fRms;
+      std::vector<unsigned char> fPresent;
+      bool fValid;
+  };
+} // end namespace lariov
+
+#endif
+/** @} */ // end of doxygen group
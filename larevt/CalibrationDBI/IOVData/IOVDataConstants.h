@@ -8,8 +8,16 @@ namespace lariov {
 
   const std::string kTREE_PREFIX = "iov";
 
-  const unsigned short kMAX_SUBSTAMP_LENGTH = 6;
-  const unsigned int   kMAX_SUBSTAMP_VALUE  = ((unsigned int)pow(10,kMAX_SUBSTAMP_LENGTH)) - 1;
+  constexpr unsigned short kMAX_SUBSTAMP_LENGTH = 6;
+  constexpr unsigned int   kMAX_SUBSTAMP_VALUE  = 999999; // 10^kMAX_SUBSTAMP_LENGTH - 1
+
+  // Snapshots keep a direct channel index if the channel range spans at most
+  // kSNAPSHOT_DENSE_FACTOR slots per row (plus kSNAPSHOT_DENSE_SLACK).
+  constexpr size_t kSNAPSHOT_DENSE_FACTOR = 4;
+  constexpr size_t kSNAPSHOT_DENSE_SLACK  = 1024;
+
+  // Alignment (bytes) of the pedestal arrays (DetPedestalArrays)
+  constexpr size_t kPEDESTAL_ALIGNMENT = 64;
 
   namespace DataSource {
     enum ds {Database, File, Default};
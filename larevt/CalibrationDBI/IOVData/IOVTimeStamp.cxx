@@ -14,9 +14,7 @@
 #include "IOVTimeStamp.h"
 #include "IOVDataError.h"
 #include "IOVDataConstants.h"
-#include <sstream>
-#include <limits>
-#include <iomanip>
+#include <cstdio>
 
 namespace lariov {
 
@@ -24,13 +22,14 @@ namespace lariov {
   /**Create unique database timestamp of the form <fStamp>.<fSubStamp>,
      where fSubStamp is prepended with zeroes to ensure six digits
   */
-  void IOVTimeStamp::CalcDBStamp() {
-    if (fSubStamp > kMAX_SUBSTAMP_VALUE) {
-      throw IOVDataError("SubStamp of an IOVTimeStamp cannot have more than six digits!");
-    }
-    std::stringstream stream;
-    stream << fStamp <<"."<<std::setfill('0')<<std::setw(kMAX_SUBSTAMP_LENGTH)<< fSubStamp;
-    fDBStamp = stream.str();
+  std::string IOVTimeStamp::DBStamp() const {
+    char buf[32];
+    int n = std::snprintf(buf, sizeof(buf), "%lu.%0*u", fStamp, int(kMAX_SUBSTAMP_LENGTH), fSubStamp);
+    return std::string(buf, n);
+  }
+
+  void IOVTimeStamp::ThrowSubStampError() {
+    throw IOVDataError("SubStamp of an IOVTimeStamp cannot have more than six digits!");
   }
 
   IOVTimeStamp IOVTimeStamp::GetFromString(const std::string& ts) {
@@ -53,54 +52,4 @@ namespace lariov {
 
     return IOVTimeStamp(stamp,substamp);
   }
-
-  IOVTimeStamp IOVTimeStamp::MinTimeStamp() {
-    return IOVTimeStamp(0,0);
-  }
-
-  IOVTimeStamp IOVTimeStamp::MaxTimeStamp() {
-    return IOVTimeStamp(std::numeric_limits<unsigned long>::max(), kMAX_SUBSTAMP_VALUE);
-  }
-
-  ///implementation of assignment operator
-  IOVTimeStamp& IOVTimeStamp::operator=( const IOVTimeStamp& ts ) {
-    if (this == &ts) return *this;
-    fStamp = ts.Stamp();
-    fSubStamp = ts.SubStamp();
-    fDBStamp = ts.DBStamp();
-    return *this;
-  }
-
-  ///implementation of operator<
-  bool IOVTimeStamp::operator<(const IOVTimeStamp& ts) const {
-    if (this->Stamp() < ts.Stamp()) return true;
-    else if (this->Stamp() == ts.Stamp() && this->SubStamp() < ts.SubStamp()) return true;
-    else return false;
-  }
-
-  ///implementation of equality operator
-  bool IOVTimeStamp::operator==(const IOVTimeStamp& ts) const {
-    if ( fStamp == ts.Stamp() && fSubStamp == ts.SubStamp() ) return true;
-    return false;
-  }
-
-  ///remaining comparison operators implemented in terms of == and <
-  bool IOVTimeStamp::operator!=(const IOVTimeStamp& ts) const {
-    return !( *this == ts);
-  }
-
-  bool IOVTimeStamp::operator<=(const IOVTimeStamp& ts) const {
-    if ( *this < ts || *this == ts) return true;
-    else return false;
-  }
-
-  bool IOVTimeStamp::operator>=(const IOVTimeStamp& ts) const {
-    if ( !( *this < ts) ) return true;
-    else return false;
-  }
-
-  bool IOVTimeStamp::operator>(const IOVTimeStamp& ts) const {
-    if ( !( *this <= ts) ) return true;
-    else return false;
-  }
 }
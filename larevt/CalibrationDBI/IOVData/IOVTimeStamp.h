@@ -14,11 +14,16 @@
 #ifndef IOVDATA_IOVTIMESTAMP_H
 #define IOVDATA_IOVTIMESTAMP_H
 
+#include "IOVDataConstants.h"
+#include <limits>
 #include <string>
+#include <type_traits>
 
 namespace lariov {
   /**
      \class IOVTimeStamp
+     Trivially copyable value type (16 bytes).  The database string is only
+     formatted when DBStamp() is called.
   */
 
   class IOVTimeStamp {
@@ -26,53 +31,53 @@ namespace lariov {
     public:
 
       ///Constructor
-      IOVTimeStamp(unsigned long stamp, unsigned int substamp = 0) :
+      constexpr IOVTimeStamp(unsigned long stamp, unsigned int substamp = 0) :
         fStamp(stamp), fSubStamp(substamp) {
-	this->CalcDBStamp();
+	if (substamp > kMAX_SUBSTAMP_VALUE) ThrowSubStampError();
       }
 
-      ///Default destructor
-      virtual ~IOVTimeStamp(){}
-
-      unsigned long Stamp() const { return fStamp; }
-      unsigned long SubStamp() const { return fSubStamp; }
-      const std::string& DBStamp() const { return fDBStamp; }
-
-      void SetStamp(unsigned long stamp, unsigned int substamp = 0) {fStamp = stamp; fSubStamp = substamp; this->CalcDBStamp();}
-
+      constexpr unsigned long Stamp() const { return fStamp; }
+      constexpr unsigned long SubStamp() const { return fSubStamp; }
 
       /**
         This function combines the stamp and substamp into a unique string to be used
 	as a database timestamp.
       */
-      void CalcDBStamp();
+      std::string DBStamp() const;
+
+      constexpr void SetStamp(unsigned long stamp, unsigned int substamp = 0) {
+	if (substamp > kMAX_SUBSTAMP_VALUE) ThrowSubStampError();
+	fStamp = stamp;
+	fSubStamp = substamp;
+      }
 
       static IOVTimeStamp GetFromString(const std::string& ts);
-      static IOVTimeStamp MinTimeStamp();
-      static IOVTimeStamp MaxTimeStamp();
+      static constexpr IOVTimeStamp MinTimeStamp() { return IOVTimeStamp(0,0); }
+      static constexpr IOVTimeStamp MaxTimeStamp()
+        { return IOVTimeStamp(std::numeric_limits<unsigned long>::max(), kMAX_SUBSTAMP_VALUE); }
 
 
       ///comparison operators
-      bool operator<(const IOVTimeStamp& ts) const;
-      bool operator<=(const IOVTimeStamp& ts) const;
-      bool operator>=(const IOVTimeStamp& ts) const;
-      bool operator>(const IOVTimeStamp& ts) const;
-
-      bool operator==(const IOVTimeStamp& ts) const;
-      bool operator!=(const IOVTimeStamp& ts) const;
+      constexpr bool operator<(const IOVTimeStamp& ts) const
+        { return fStamp < ts.fStamp || (fStamp == ts.fStamp && fSubStamp < ts.fSubStamp); }
+      constexpr bool operator<=(const IOVTimeStamp& ts) const { return !(ts < *this); }
+      constexpr bool operator>=(const IOVTimeStamp& ts) const { return !(*this < ts); }
+      constexpr bool operator>(const IOVTimeStamp& ts) const { return ts < *this; }
 
-      ///assignment operator
-      IOVTimeStamp& operator=( const IOVTimeStamp& ts);
+      constexpr bool operator==(const IOVTimeStamp& ts) const
+        { return fStamp == ts.fStamp && fSubStamp == ts.fSubStamp; }
+      constexpr bool operator!=(const IOVTimeStamp& ts) const { return !(*this == ts); }
 
 
     protected:
 
+      [[noreturn]] static void ThrowSubStampError();
+
       unsigned long fStamp;
       unsigned int fSubStamp;
-
-      std::string fDBStamp;
   };
+
+  static_assert(std::is_trivially_copyable<IOVTimeStamp>::value, "IOVTimeStamp must be trivially copyable");
+  static_assert(sizeof(IOVTimeStamp) == 16, "IOVTimeStamp must stay 16 bytes");
 }
 #endif
-
-
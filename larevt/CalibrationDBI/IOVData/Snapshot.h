@@ -34,13 +34,23 @@ namespace lariov {
 
       /// Default constructor
       Snapshot() :
-        fStart(0,0), fEnd(0,0) {}
+        fStart(0,0), fEnd(0,0), fAllChanged(true), fIndexBase(0), fIndexed(true), fSorted(true), fSortedRows(0) {}
 
       /// Default destructor
       ~Snapshot(){}
 
+      /// Remove all rows (a full update follows)
       void Clear();
 
+      /// Start an incremental update: keep the rows, forget the changed channels
+      void ClearChanges() { fChanged.clear(); fAllChanged = false; }
+
+      /// Channels added, replaced or removed since Clear() or ClearChanges()
+      const std::vector<unsigned int>& ChangedChannels() const {return fChanged;}
+
+      /// Whether the snapshot was rebuilt from scratch (after Clear())
+      bool AllChanged() const {return fAllChanged;}
+
       const IOVTimeStamp&  Start() const {return fStart;}
       const IOVTimeStamp&  End()   const {return fEnd;}
       void SetIoV(const IOVTimeStamp& start, const IOVTimeStamp& end);
@@ -51,54 +61,177 @@ namespace lariov {
 
       const std::vector<T>& Data() const {return fData;}
 
+      /// Whether lookups use the direct channel index (dense channels)
+      /// rather than a binary search
+      bool IsIndexed() const {return fIndexed;}
+
+      /// Whether `rows` channels spanning `span` channel numbers are dense
+      /// enough for a direct channel index
+      static bool IsDense(size_t span, size_t rows)
+        { return span <= kSNAPSHOT_DENSE_FACTOR * rows + kSNAPSHOT_DENSE_SLACK; }
+
 
 
       /// Only included with class if T has base class ChData
+      /// Row of a channel, or nullptr if there is none (never throws)
       template< class U = T,
                 typename std::enable_if<std::is_base_of<ChData, U>::value, int>::type = 0>
-      bool HasChannel(unsigned int ch) const {
+      const T* FindRow(unsigned int ch) const {
 
-	typename std::vector<T>::const_iterator it = std::lower_bound(fData.begin(), fData.end(), ch);
-	if ( it == fData.end() || it->Channel() != ch) {
-	  return false;
+	if (fIndexed) {
+	  size_t slot = ch - fIndexBase; // wraps around below fIndexBase
+	  if (slot < fIndex.size() && fIndex[slot] != 0) return &fData[fIndex[slot] - 1];
+	  return nullptr;
 	}
-	else return true;
+
+	typename std::vector<T>::const_iterator it = std::lower_bound(fData.begin(), fData.end(), ch);
+	if ( it == fData.end() || it->Channel() != ch) return nullptr;
+	return &*it;
+      }
+
+      template< class U = T,
+                typename std::enable_if<std::is_base_of<ChData, U>::value, int>::type = 0>
+      bool HasChannel(unsigned int ch) const {
+	return FindRow(ch) != nullptr;
       }
 
       template< class U = T,
                 typename std::enable_if<std::is_base_of<ChData, U>::value, int>::type = 0>
       const T& GetRow(unsigned int ch) const {
 
-        typename std::vector<T>::const_iterator it = std::lower_bound(fData.begin(), fData.end(), ch);
+	const T* row = FindRow(ch);
+	if ( row == nullptr ) ThrowChannelNotFound(ch);
+	return *row;
+      }
+
+      /// (Re)build the direct channel index if the channels are dense.
+      /// Rows added in channel order keep the index up to date; call this
+      /// after rows were inserted out of order or removed.
+      /// Finalize() also calls it.
+      template< class U = T,
+      		typename std::enable_if<std::is_base_of<ChData, U>::value, int>::type = 0>
+      void BuildIndex() {
+	fIndex.clear();
+	fIndexed = false;
+	if (!fData.empty()) {
+	  fIndexBase = fData.front().Channel();
+	  size_t span = size_t(fData.back().Channel() - fIndexBase) + 1;
+	  if (!IsDense(span, fData.size())) return;
+	  fIndex.assign(span, 0);
+	  for (size_t row = 0; row < fData.size(); ++row) fIndex[fData[row].Channel() - fIndexBase] = row + 1;
+	}
+	fIndexed = true;
+      }
+
+      /// Bulk fill: Reserve(), AppendRow() for each row in any order, then
+      /// Finalize().  Lookups are only valid after Finalize().
+      void Reserve(size_t n) { fData.reserve(fData.size() + n); }
 
-	if ( it == fData.end() || it->Channel() != ch ) {
-          std::string msg("Channel not found: ");
-	  msg += std::to_string(ch);
-	  throw IOVDataError(msg);
+      /// Append a row without looking for its channel; if a channel is
+      /// appended more than once, or is already present, the last row wins
+      template< class U = T,
+      		typename std::enable_if<std::is_base_of<ChData, U>::value, int>::type = 0>
+      void AppendRow(const T& data) {
+	if (fSorted && !fData.empty() && data.Channel() <= fData.back().Channel()) {
+	  fSorted = false;
+	  fSortedRows = fData.size();
+	  fIndexed = false;
 	}
+	fData.push_back(data);
+	if (fIndexed) IndexAppended();
+	fChanged.push_back(data.Channel());
+      }
 
-	return *it;
+      /// Sort the appended rows (once), resolve duplicate channels and
+      /// build the index
+      template< class U = T,
+      		typename std::enable_if<std::is_base_of<ChData, U>::value, int>::type = 0>
+      void Finalize() {
+	if (!fSorted) {
+	  // sort the appended rows, then merge them after the rows they replace
+	  auto by_channel = [](const T& a, const T& b) {return a.Channel() < b.Channel();};
+	  std::stable_sort(fData.begin() + fSortedRows, fData.end(), by_channel);
+	  std::inplace_merge(fData.begin(), fData.begin() + fSortedRows, fData.end(), by_channel);
+	  // of rows with the same channel, keep the last appended
+	  size_t n = 0;
+	  for (size_t i = 0; i < fData.size(); ++i) {
+	    if (i + 1 < fData.size() && fData[i + 1].Channel() == fData[i].Channel()) continue;
+	    if (n != i) fData[n] = std::move(fData[i]);
+	    ++n;
+	  }
+	  fData.erase(fData.begin() + n, fData.end());
+	  fSorted = true;
+	}
+	if (!fIndexed) BuildIndex();
       }
 
       template< class U = T,
       		typename std::enable_if<std::is_base_of<ChData, U>::value, int>::type = 0>
       void AddOrReplaceRow(const T& data) {
         typename std::vector<T>::iterator it = std::lower_bound(fData.begin(), fData.end(), data.Channel());
-        if (it == fData.end() || data.Channel() != it->Channel() ) {
-	  bool sort = ( !(fData.empty()) && data < fData.back());
+        if (it == fData.end()) {
 	  fData.push_back(data);
-	  if (sort) std::sort(fData.begin(), fData.end());
+	  if (fIndexed) IndexAppended();
+        }
+        else if (data.Channel() != it->Channel() ) {
+	  fData.insert(it, data);
+	  fIndexed = false; // rows moved
         }
         else {
 	  *it = data;
 	}
+	fChanged.push_back(data.Channel());
+      }
+
+      template< class U = T,
+      		typename std::enable_if<std::is_base_of<ChData, U>::value, int>::type = 0>
+      void RemoveRow(unsigned int ch) {
+        typename std::vector<T>::iterator it = std::lower_bound(fData.begin(), fData.end(), ch);
+        if (it != fData.end() && it->Channel() == ch) {
+	  fData.erase(it);
+	  fChanged.push_back(ch);
+	  fIndexed = false; // rows moved
+	}
       }
 
     private:
 
+      /// Add the last row to the index (or drop the index if it gets sparse)
+      void IndexAppended() {
+	unsigned int ch = fData.back().Channel();
+	if (fIndex.empty()) fIndexBase = ch;
+	size_t span = size_t(ch - fIndexBase) + 1;
+	if (!IsDense(span, fData.size())) {
+	  fIndex.clear();
+	  fIndexed = false;
+	  return;
+	}
+	fIndex.resize(span, 0);
+	fIndex[span - 1] = fData.size();
+      }
+
+      [[noreturn]] static void ThrowChannelNotFound(unsigned int ch) {
+	std::string msg("Channel not found: ");
+	msg += std::to_string(ch);
+	throw IOVDataError(msg);
+      }
+
       IOVTimeStamp  fStart;
       IOVTimeStamp  fEnd;
       std::vector<T> fData;
+      std::vector<unsigned int> fChanged;
+      bool fAllChanged;
+
+      /// Direct channel index: row + 1 of channel fIndexBase + i (0 = none).
+      /// Used if fIndexed, otherwise lookups search fData.
+      std::vector<unsigned int> fIndex;
+      unsigned int fIndexBase;
+      bool fIndexed;
+
+      /// False while appended rows wait for Finalize(); the first
+      /// fSortedRows rows are sorted
+      bool fSorted;
+      size_t fSortedRows;
   };
 
   //=============================================
@@ -107,6 +240,11 @@ namespace lariov {
   template <class T>
   void Snapshot<T>::Clear() {
     fData.clear();
+    fChanged.clear();
+    fAllChanged = true;
+    fIndex.clear();
+    fIndexed = true;
+    fSorted = true;
     fStart  = fEnd = IOVTimeStamp::MaxTimeStamp();
     fStart.SetStamp(fStart.Stamp()-1, fStart.SubStamp());
   }
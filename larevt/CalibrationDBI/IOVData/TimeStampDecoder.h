@@ -13,8 +13,35 @@ namespace lariov {
       TimeStampDecoder() {}
       virtual ~TimeStampDecoder();
 
-      static IOVTimeStamp DecodeTimeStamp(DBTimeStamp_t ts);
+      /**
+         Convert a raw time stamp: 19 digits are nanoseconds since the epoch,
+         truncated to database precision (microseconds); fewer than
+         kMAX_SUBSTAMP_LENGTH digits (but not zero) are taken as seconds.
+         Anything else throws IOVDataError.  Arithmetic only.
+      */
+      static constexpr IOVTimeStamp DecodeTimeStamp(DBTimeStamp_t ts);
+
+    private:
+
+      [[noreturn]] static void ThrowUnknownTimeStamp(DBTimeStamp_t ts);
   };
+
+  //Do NOT change the following code without very good reason!
+  //MicroBooNE and other experiments depend on it!
+  constexpr IOVTimeStamp TimeStampDecoder::DecodeTimeStamp(DBTimeStamp_t ts) {
+
+    //microboone stores timestamp as ns from epoch, so there should be 19 digits.
+    //make timestamp conform to database precision.
+    if (ts >= 1000000000000000000ULL && ts <= 9999999999999999999ULL) {
+      return IOVTimeStamp(ts / 1000000000, (ts % 1000000000) / 1000);
+    }
+    else if (ts < 100000 && ts != 0) { // fewer than kMAX_SUBSTAMP_LENGTH digits
+      return IOVTimeStamp(ts, 0);
+    }
+    else {
+      ThrowUnknownTimeStamp(ts);
+    }
+  }
 }
 
 #endif
@@ -9,6 +9,9 @@
 #ifndef DETPEDESTALPROVIDER_H
 #define DETPEDESTALPROVIDER_H
 
+// C/C++ standard libraries
+#include <cstddef>
+
 // LArSoft libraries
 #include "larcorealg/CoreUtils/UncopiableAndUnmovableClass.h"
 #include "larcoreobj/SimpleTypesAndConstants/RawTypes.h" // raw::ChannelID_t
@@ -34,6 +37,16 @@ namespace lariov {
       virtual float PedMeanErr(raw::ChannelID_t ch) const = 0;
       virtual float PedRmsErr(raw::ChannelID_t ch) const = 0;
 
+      /// Subtract the pedestal means of channels first_ch ... first_ch + n_channels - 1
+      /// from their ADC samples: n_ticks samples per channel, channel after channel
+      virtual void SubtractPedestals(raw::ChannelID_t first_ch, std::size_t n_channels,
+                                     std::size_t n_ticks, short const* adc, float* out) const {
+        for (std::size_t c = 0; c < n_channels; ++c) {
+          float ped = PedMean(first_ch + c);
+          for (std::size_t t = 0; t < n_ticks; ++t) out[c * n_ticks + t] = adc[c * n_ticks + t] - ped;
+        }
+      }
+
     /* TODO DELME
       /// Update local state of implementation
       virtual bool Update(DBTimeStamp_t ts) = 0;
@@ -0,0 +1,274 @@
+//=================================================================================
+//
+// Name: DBBundle.cxx
+//
+// Purpose: Implementation for class DBBundle.
+//
+//=================================================================================
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <tuple>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "DBBundle.h"
+#include "larevt/CalibrationDBI/IOVData/IOVDataConstants.h"
+#include "cetlib_except/exception.h"
+
+namespace {
+
+  const char kBUNDLE_MAGIC[8] = {'L', 'A', 'R', 'D', 'B', 'B', 'N', 'D'};
+  const std::uint32_t kBUNDLE_VERSION = 1;
+  const std::uint32_t kBUNDLE_ENDIAN = 0x01020304;
+
+  struct BundleHeader
+  {
+    char fMagic[8];                // kBUNDLE_MAGIC.
+    std::uint32_t fVersion;        // kBUNDLE_VERSION.
+    std::uint32_t fEndian;         // kBUNDLE_ENDIAN, as written.
+    std::uint64_t fSize;           // Total size.
+    std::uint64_t fNEntries;       // Number of datasets.
+    std::uint64_t fIndexOffset;
+    std::uint64_t fStringsOffset;
+    std::uint64_t fStringsSize;
+  };
+
+  struct BundleEntry
+  {
+    std::uint64_t fOffset;         // Snapshot.
+    std::uint64_t fSize;
+    std::uint64_t fBeginStamp;     // IOV begin.
+    std::uint64_t fEndStamp;       // IOV end.
+    std::uint32_t fBeginSubStamp;
+    std::uint32_t fEndSubStamp;
+    std::uint32_t fFolder;         // Offset of folder name in string table.
+    std::uint32_t fTag;            // Offset of tag in string table.
+  };
+
+  std::uint64_t align8(std::uint64_t n) {return (n + 7) & ~std::uint64_t(7);}
+
+  void writePadded(std::ostream& out, const void* data, size_t n)
+  {
+    static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    out.write(static_cast<const char*>(data), n);
+    out.write(zeros, align8(n) - n);
+  }
+
+  // Bundles opened by this process.
+
+  std::mutex gOpenMutex;
+  std::map<std::string, std::weak_ptr<const lariov::DBBundle> > gOpen;
+}
+
+// Add one dataset.
+
+void lariov::DBBundle::Writer::add(const std::string& folder, const std::string& tag,
+				   const DBDataset& data)
+{
+  std::ostringstream snapshot;
+  data.writeSnapshot(snapshot, folder, tag);
+  Item item {folder, tag, data.beginTime(), data.endTime(), snapshot.str()};
+  for(Item& old : fItems) {
+    if(old.fFolder == folder && old.fTag == tag && old.fBegin == item.fBegin) {
+      old = std::move(item);
+      return;
+    }
+  }
+  fItems.push_back(std::move(item));
+}
+
+// Write the bundle.
+
+void lariov::DBBundle::Writer::write(std::ostream& out) const
+{
+  // Sort by folder, tag and begin time.
+
+  std::vector<const Item*> items;
+  for(const Item& item : fItems)
+    items.push_back(&item);
+  std::sort(items.begin(), items.end(), [](const Item* a, const Item* b) {
+      return std::tie(a->fFolder, a->fTag) < std::tie(b->fFolder, b->fTag) ||
+	(std::tie(a->fFolder, a->fTag) == std::tie(b->fFolder, b->fTag) && a->fBegin < b->fBegin);});
+
+  // String table (each name once).
+
+  std::string strings;
+  std::map<std::string, std::uint32_t> string_offsets;
+  auto addString = [&](const std::string& s) {
+    auto it = string_offsets.find(s);
+    if(it != string_offsets.end())
+      return it->second;
+    std::uint32_t offset = strings.size();
+    strings += s;
+    strings += '\0';
+    string_offsets[s] = offset;
+    return offset;
+  };
+
+  // Layout.
+
+  std::vector<BundleEntry> index(items.size());
+  std::uint64_t pos = align8(sizeof(BundleHeader));
+  for(size_t i=0; i<items.size(); ++i) {
+    BundleEntry& entry = index[i];
+    std::memset(&entry, 0, sizeof(entry));
+    entry.fOffset = pos;
+    entry.fSize = items[i]->fSnapshot.size();
+    entry.fBeginStamp = items[i]->fBegin.Stamp();
+    entry.fBeginSubStamp = items[i]->fBegin.SubStamp();
+    entry.fEndStamp = items[i]->fEnd.Stamp();
+    entry.fEndSubStamp = items[i]->fEnd.SubStamp();
+    entry.fFolder = addString(items[i]->fFolder);
+    entry.fTag = addString(items[i]->fTag);
+    pos += align8(entry.fSize);
+  }
+
+  BundleHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.fMagic, kBUNDLE_MAGIC, sizeof(header.fMagic));
+  header.fVersion = kBUNDLE_VERSION;
+  header.fEndian = kBUNDLE_ENDIAN;
+  header.fNEntries = items.size();
+  header.fIndexOffset = pos;
+  header.fStringsOffset = pos + align8(index.size() * sizeof(BundleEntry));
+  header.fStringsSize = strings.size();
+  header.fSize = header.fStringsOffset + align8(strings.size());
+
+  // Write.
+
+  writePadded(out, &header, sizeof(header));
+  for(const Item* item : items)
+    writePadded(out, item->fSnapshot.data(), item->fSnapshot.size());
+  writePadded(out, index.data(), index.size() * sizeof(BundleEntry));
+  writePadded(out, strings.data(), strings.size());
+}
+
+// Open a bundle, sharing the mapping with other users in this process.
+
+std::shared_ptr<const lariov::DBBundle> lariov::DBBundle::open(const std::string& path)
+{
+  std::lock_guard<std::mutex> lock(gOpenMutex);
+  std::shared_ptr<const DBBundle> bundle = gOpen[path].lock();
+  if(!bundle) {
+    bundle = std::make_shared<const DBBundle>(path);
+    gOpen[path] = bundle;
+  }
+  return bundle;
+}
+
+// Constructor.  Maps the file and reads the index.
+
+lariov::DBBundle::DBBundle(const std::string& path) :
+  fPath(path),
+  fSize(0)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0)
+    throw cet::exception("DBBundle") << "Can not open conditions bundle " << path;
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size < off_t(sizeof(BundleHeader))) {
+    close(fd);
+    throw cet::exception("DBBundle") << "Not a conditions bundle: " << path;
+  }
+  size_t size = st.st_size;
+  void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(addr == MAP_FAILED)
+    throw cet::exception("DBBundle") << "Can not map conditions bundle " << path;
+  fMapping = std::shared_ptr<const void>(addr, [size](const void* p) {
+      munmap(const_cast<void*>(p), size);});
+  const char* data = static_cast<const char*>(addr);
+
+  // Check header and sections.
+
+  BundleHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  auto inside = [size](std::uint64_t offset, std::uint64_t n) {
+    return offset % 8 == 0 && offset <= size && n <= size - offset;};
+  if(std::memcmp(header.fMagic, kBUNDLE_MAGIC, sizeof(header.fMagic)) != 0 ||
+     header.fVersion != kBUNDLE_VERSION || header.fEndian != kBUNDLE_ENDIAN ||
+     header.fSize != size || header.fNEntries > size / sizeof(BundleEntry) ||
+     !inside(header.fIndexOffset, header.fNEntries * sizeof(BundleEntry)) ||
+     !inside(header.fStringsOffset, header.fStringsSize))
+    throw cet::exception("DBBundle") << "Not a valid conditions bundle: " << path;
+  const char* strings = data + header.fStringsOffset;
+  auto getString = [&](std::uint32_t offset, std::string& s) {
+    if(offset >= header.fStringsSize)
+      return false;
+    const void* nul = std::memchr(strings + offset, '\0', header.fStringsSize - offset);
+    if(nul == nullptr)
+      return false;
+    s.assign(strings + offset, static_cast<const char*>(nul));
+    return true;
+  };
+
+  // Read index.  Snapshots themselves are checked when they are attached.
+
+  fSize = header.fNEntries;
+  for(size_t i=0; i<fSize; ++i) {
+    BundleEntry entry;
+    std::memcpy(&entry, data + header.fIndexOffset + i * sizeof(BundleEntry), sizeof(entry));
+    std::string folder;
+    std::string tag;
+    if(!inside(entry.fOffset, entry.fSize) || !getString(entry.fFolder, folder) ||
+       !getString(entry.fTag, tag) ||
+       entry.fBeginSubStamp > kMAX_SUBSTAMP_VALUE || entry.fEndSubStamp > kMAX_SUBSTAMP_VALUE)
+      throw cet::exception("DBBundle") << "Corrupt index entry " << i << " in conditions bundle " << path;
+    std::vector<Entry>& entries = fEntries[std::make_pair(folder, tag)];
+    entries.push_back(Entry {IOVTimeStamp(entry.fBeginStamp, entry.fBeginSubStamp),
+			     IOVTimeStamp(entry.fEndStamp, entry.fEndSubStamp),
+			     size_t(entry.fOffset), size_t(entry.fSize)});
+    if(entries.size() > 1 && !(entries[entries.size()-2].fBegin < entries.back().fBegin))
+      throw cet::exception("DBBundle") << "Unsorted index in conditions bundle " << path;
+  }
+}
+
+// Check for a folder and tag.
+
+bool lariov::DBBundle::contains(const std::string& folder, const std::string& tag) const
+{
+  return fEntries.count(std::make_pair(folder, tag)) != 0;
+}
+
+// Find the dataset containing the specified time.
+
+std::shared_ptr<lariov::DBDataset> lariov::DBBundle::find(const std::string& folder,
+							   const std::string& tag,
+							   const IOVTimeStamp& ts) const
+{
+  auto it = fEntries.find(std::make_pair(folder, tag));
+  if(it == fEntries.end())
+    return nullptr;
+  const std::vector<Entry>& entries = it->second;
+  auto entry = std::upper_bound(entries.begin(), entries.end(), ts,
+				[](const IOVTimeStamp& t, const Entry& e) {return t < e.fBegin;});
+  if(entry == entries.begin() || !(ts < (entry - 1)->fEnd))
+    return nullptr;
+  --entry;
+
+  const char* data = static_cast<const char*>(fMapping.get()) + entry->fOffset;
+  auto dataset = std::make_shared<DBDataset>();
+  if(!dataset->attachSnapshot(fMapping, data, entry->fSize))
+    throw cet::exception("DBBundle") << "Corrupt dataset of folder " << folder << " at "
+				     << entry->fBegin.DBStamp() << " in conditions bundle " << fPath;
+  return dataset;
+}
+
+// IOV begin times of a folder and tag.
+
+std::vector<lariov::IOVTimeStamp> lariov::DBBundle::beginTimes(const std::string& folder,
+							       const std::string& tag) const
+{
+  std::vector<IOVTimeStamp> result;
+  auto it = fEntries.find(std::make_pair(folder, tag));
+  if(it != fEntries.end()) {
+    for(const Entry& entry : it->second)
+      result.push_back(entry.fBegin);
+  }
+  return result;
+}
@@ -0,0 +1,128 @@
+#ifndef DBBUNDLE_H
+#define DBBUNDLE_H
+//=================================================================================
+//
+// Name: DBBundle.h
+//
+// Purpose: Header for class DBBundle.
+//          A conditions bundle is a single file holding every IOV of several
+//          folders and tags over a time range, so that jobs can read their
+//          conditions without a web server or per-folder sqlite files.
+//
+//          The file is an index over DBDataset snapshots (see
+//          DBDataset::writeSnapshot).  It is mapped read-only, and datasets are
+//          used in place (DBDataset::attachSnapshot), so opening a bundle and
+//          switching IOVs cost no parsing or copying.
+//
+//          Bundles are written with class DBBundle::Writer (see the
+//          make_db_bundle tool), and opened with function open, which shares
+//          one mapping between all folders of a process that use the same file.
+//
+// File layout (host-endian, all sections 8-byte aligned):
+//
+// Header     - Magic, version, endian marker, file size, number of datasets,
+//              index and string table location.
+// Snapshots  - One DBDataset snapshot per IOV.
+// Index      - One entry per IOV (snapshot location, IOV, folder, tag), sorted
+//              by folder, tag and IOV begin time.
+// Strings    - NUL-terminated folder and tag names.
+//
+//=================================================================================
+
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "larevt/CalibrationDBI/IOVData/IOVTimeStamp.h"
+#include "larevt/CalibrationDBI/Providers/DBDataset.h"
+
+namespace lariov
+{
+  class DBBundle
+  {
+  public:
+
+    // Writer.  Collects datasets, then writes the bundle.
+
+    class Writer
+    {
+    public:
+
+      // Add the dataset of one IOV (replaces a dataset of the same folder,
+      // tag and begin time).
+
+      void add(const std::string& folder, const std::string& tag, const DBDataset& data);
+
+      // Number of datasets added.
+
+      size_t size() const {return fItems.size();}
+
+      // Write the bundle.
+
+      void write(std::ostream& out) const;
+
+    private:
+
+      struct Item
+      {
+	std::string fFolder;
+	std::string fTag;
+	IOVTimeStamp fBegin;
+	IOVTimeStamp fEnd;
+	std::string fSnapshot;
+      };
+      std::vector<Item> fItems;
+    };
+
+    // Open a bundle, or share one that this process has already opened.
+    // Throws cet::exception if the file can not be mapped or is not a valid bundle.
+
+    static std::shared_ptr<const DBBundle> open(const std::string& path);
+
+    // Constructor (use open to share mappings).
+
+    explicit DBBundle(const std::string& path);
+
+    // Accessors.
+
+    const std::string& path() const {return fPath;}
+    size_t size() const {return fSize;}          // Number of datasets.
+
+    // Check whether the bundle has IOVs for a folder and tag.
+
+    bool contains(const std::string& folder, const std::string& tag) const;
+
+    // Dataset of the IOV of a folder and tag that contains the specified time.
+    // Returns a null pointer if there is none.  The dataset uses the mapped file.
+
+    std::shared_ptr<DBDataset> find(const std::string& folder, const std::string& tag,
+				    const IOVTimeStamp& ts) const;
+
+    // IOV begin times of a folder and tag, sorted.
+
+    std::vector<IOVTimeStamp> beginTimes(const std::string& folder, const std::string& tag) const;
+
+  private:
+
+    // Location and IOV of one dataset.
+
+    struct Entry
+    {
+      IOVTimeStamp fBegin;
+      IOVTimeStamp fEnd;
+      size_t fOffset;
+      size_t fSize;
+    };
+
+    // Data members.
+
+    std::string fPath;
+    std::shared_ptr<const void> fMapping;   // Mapped file.
+    size_t fSize;                           // Number of datasets.
+    std::map<std::pair<std::string, std::string>, std::vector<Entry> > fEntries;  // By folder and tag.
+  };
+}
+
+#endif
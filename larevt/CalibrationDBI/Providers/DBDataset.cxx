@@ -8,12 +8,351 @@
 //
 //=================================================================================
 
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstdlib>
 #include <cstring>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <istream>
+#include <ostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "WebDBIConstants.h"
 #include "DBDataset.h"
+#include "larevt/CalibrationDBI/IOVData/IOVDataConstants.h"
 #include "wda.h"
 #include "cetlib_except/exception.h"
 #include "messagefacility/MessageLogger/MessageLogger.h"
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/task_arena.h"
+
+namespace {
+
+  // Snapshot file layout.
+  //
+  // All offsets are relative to the start of the snapshot, and all sections
+  // start on 8-byte boundaries, so that arrays can be used in place.
+  //
+  // SnapshotHeader - Includes a checksum of the whole snapshot (computed with
+  //                  the checksum field set to zero).
+  // Schema         - Length-prefixed (uint32) strings: folder, tag, column
+  //                  names, column types.
+  // Channels       - nrows x uint32.
+  // Column table   - ncols x SnapshotColumn.
+  // Column data    - For each column, values (nrows x int64 or double, bitmap of
+  //                  (nrows+63)/64 x uint64, or nrows+1 x uint64 text offsets),
+  //                  followed by the text arena for text columns.
+
+  const char kSNAPSHOT_MAGIC[8] = {'L', 'A', 'R', 'D', 'B', 'S', 'N', 'P'};
+  const std::uint32_t kSNAPSHOT_VERSION = 2;
+  const std::uint32_t kSNAPSHOT_ENDIAN = 0x01020304;
+
+  struct SnapshotHeader
+  {
+    char fMagic[8];                // kSNAPSHOT_MAGIC.
+    std::uint32_t fVersion;        // kSNAPSHOT_VERSION.
+    std::uint32_t fEndian;         // kSNAPSHOT_ENDIAN, as written.
+    std::uint64_t fSize;           // Total size.
+    std::uint64_t fBeginStamp;     // IOV begin.
+    std::uint64_t fEndStamp;       // IOV end.
+    std::uint32_t fBeginSubStamp;
+    std::uint32_t fEndSubStamp;
+    std::uint64_t fNRows;          // Number of rows (channels).
+    std::uint64_t fNCols;          // Number of columns.
+    std::uint64_t fSchemaOffset;
+    std::uint64_t fSchemaSize;
+    std::uint64_t fChannelsOffset;
+    std::uint64_t fColumnsOffset;
+    std::uint64_t fChecksum;       // See snapshotChecksum.
+  };
+
+  struct SnapshotColumn
+  {
+    std::uint32_t fKind;           // DBDataset::ColumnKind.
+    std::uint32_t fReserved;
+    std::uint64_t fValuesOffset;
+    std::uint64_t fValuesSize;
+    std::uint64_t fCharsOffset;
+    std::uint64_t fCharsSize;
+  };
+
+  static_assert(sizeof(long) == 8, "Snapshot format requires 64-bit long.");
+  static_assert(sizeof(lariov::DBChannelID_t) == 4, "Snapshot format requires 32-bit channels.");
+
+  // Round up to 8-byte boundary.
+
+  std::uint64_t align8(std::uint64_t n) {return (n + 7) & ~std::uint64_t(7);}
+
+  // Append length-prefixed string to schema.
+
+  void putString(std::string& schema, const std::string& s)
+  {
+    std::uint32_t n = s.size();
+    schema.append(reinterpret_cast<const char*>(&n), sizeof(n));
+    schema += s;
+  }
+
+  // Get length-prefixed string from schema.
+
+  bool getString(const char* schema, size_t size, size_t& pos, std::string& s)
+  {
+    std::uint32_t n = 0;
+    if(size - pos < sizeof(n))
+      return false;
+    std::memcpy(&n, schema + pos, sizeof(n));
+    pos += sizeof(n);
+    if(size - pos < n)
+      return false;
+    s.assign(schema + pos, n);
+    pos += n;
+    return true;
+  }
+
+  // Write bytes, followed by padding to an 8-byte boundary.
+
+  void writePadded(std::ostream& out, const void* data, size_t n)
+  {
+    static const char zeros[8] = {0};
+    out.write(static_cast<const char*>(data), n);
+    out.write(zeros, align8(n) - n);
+  }
+
+  // 64-bit FNV-1a checksum, taken over 8-byte words rather than bytes (bytes
+  // past the end of the data count as zero padding).  Any change of a single
+  // word changes the checksum.
+
+  const std::uint64_t kCHECKSUM_SEED = 0xcbf29ce484222325ull;
+
+  std::uint64_t snapshotChecksum(std::uint64_t sum, const void* data, size_t n)
+  {
+    const char* p = static_cast<const char*>(data);
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+      std::uint64_t word;
+      std::memcpy(&word, p + i, 8);
+      sum = (sum ^ word) * 0x100000001b3ull;
+    }
+    if(i < n) {
+      std::uint64_t word = 0;
+      std::memcpy(&word, p + i, n - i);
+      sum = (sum ^ word) * 0x100000001b3ull;
+    }
+    return sum;
+  }
+
+  // Get column storage kind from database column type.
+  // Return false if type is not recognized.
+
+  bool kindFromType(const std::string& type, lariov::DBDataset::ColumnKind& kind)
+  {
+    if(type == "integer" || type == "bigint" || type == "NULL")
+      kind = lariov::DBDataset::kLong;
+    else if(type == "real")
+      kind = lariov::DBDataset::kDouble;
+    else if(type == "boolean")
+      kind = lariov::DBDataset::kBool;
+    else if(type == "text")
+      kind = lariov::DBDataset::kString;
+    else
+      return false;
+    return true;
+  }
+
+  // Number parsers.
+  // Fields are not copied.  The results are those of strtol (base 10) and
+  // strtod: leading white space and one sign are accepted, trailing characters
+  // are ignored, unparseable fields give zero, and out of range values give
+  // LONG_MIN or LONG_MAX (long), or +-HUGE_VAL or zero (double).
+
+  const char* skipSpace(const char* first, const char* last)
+  {
+    while(first != last && (*first == ' ' || (*first >= '\t' && *first <= '\r')))
+      ++first;
+    return first;
+  }
+
+  // Skip a plus sign (from_chars only accepts minus signs).
+  // Return nullptr if the plus sign is followed by another sign.
+
+  const char* skipPlus(const char* first, const char* last)
+  {
+    if(first != last && *first == '+') {
+      ++first;
+      if(first != last && (*first == '+' || *first == '-'))
+	return nullptr;
+    }
+    return first;
+  }
+
+  long parseLong(const char* first, const char* last)
+  {
+    first = skipSpace(first, last);
+    bool negative = first != last && *first == '-';
+    first = skipPlus(first, last);
+    if(first == nullptr)
+      return 0;
+    long value = 0;
+    std::errc ec = std::from_chars(first, last, value).ec;
+    if(ec == std::errc::result_out_of_range)
+      value = negative ? LONG_MIN : LONG_MAX;
+    else if(ec != std::errc())
+      value = 0;
+    return value;
+  }
+
+  double parseDouble(const char* first, const char* last)
+  {
+    first = skipSpace(first, last);
+    const char* start = first;
+    first = skipPlus(first, last);
+    if(first == nullptr)
+      return 0.;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    double value = 0.;
+    std::errc ec = std::from_chars(first, last, value).ec;
+    if(ec == std::errc())
+      return value;
+    else if(ec != std::errc::result_out_of_range)
+      return 0.;
+#endif
+
+    // Out of range (or no floating point from_chars).  Use strtod on a
+    // terminated copy, for its overflow and underflow results.
+
+    std::string copy(start, last);
+    return strtod(copy.c_str(), 0);
+  }
+
+  // Parse string representation of boolean.
+
+  bool parseBool(std::string_view s)
+  {
+    if(s == "true" || s == "True" || s == "TRUE" || s == "1")
+      return true;
+    else if(s == "false" || s == "False" || s == "FALSE" || s == "0")
+      return false;
+    mf::LogError("DBDataset") << "Unknown string representation of boolean " << s << "\n";
+    throw cet::exception("DBDataset") << "Unknown string representation of boolean " << s
+				      << "\n";
+  }
+
+  // Get one field of a libwda tuple, without copying.
+  // Missing fields are returned as empty.
+
+  std::string_view tupleField(Tuple tup, size_t col)
+  {
+    const DataRec* rec = static_cast<const DataRec*>(tup);
+    if(col >= size_t(rec->ncolumns) || rec->columns[col] == nullptr)
+      return std::string_view();
+    return std::string_view(rec->columns[col]);
+  }
+
+  // Split one line of a text response into fields.
+  // Fields are separated by commas.  A field may be enclosed in double quotes,
+  // in which case it may contain commas, and a doubled quote stands for one quote.
+  // Fields are views into the line, except unescaped quoted fields, which are
+  // stored in scratch.
+
+  void splitLine(std::string_view line, std::vector<std::string_view>& fields,
+		 std::deque<std::string>& scratch)
+  {
+    fields.clear();
+    scratch.clear();
+    size_t pos = 0;
+    while(true) {
+      if(pos < line.size() && line[pos] == '"') {
+
+	// Quoted field.
+
+	size_t begin = ++pos;
+	bool escaped = false;
+	while(pos < line.size()) {
+	  if(line[pos] == '"') {
+	    if(pos+1 < line.size() && line[pos+1] == '"') {
+	      escaped = true;
+	      pos += 2;
+	      continue;
+	    }
+	    break;
+	  }
+	  ++pos;
+	}
+	std::string_view field = line.substr(begin, pos - begin);
+	if(escaped) {
+	  scratch.emplace_back();
+	  std::string& s = scratch.back();
+	  for(size_t i=0; i<field.size(); ++i) {
+	    s += field[i];
+	    if(field[i] == '"')
+	      ++i;
+	  }
+	  field = s;
+	}
+	fields.push_back(field);
+	pos = line.find(',', pos);
+      }
+      else {
+
+	// Plain field.
+
+	size_t end = line.find(',', pos);
+	fields.push_back(line.substr(pos, end == std::string_view::npos ? end : end - pos));
+	pos = end;
+      }
+      if(pos == std::string_view::npos)
+	break;
+      ++pos;
+    }
+  }
+
+  // Get next line of a text response (without line terminator).
+  // Return false at end of body.
+
+  bool nextLine(std::string_view body, size_t& pos, std::string_view& line)
+  {
+    if(pos >= body.size())
+      return false;
+    size_t end = body.find('\n', pos);
+    if(end == std::string_view::npos)
+      end = body.size();
+    line = body.substr(pos, end - pos);
+    if(!line.empty() && line.back() == '\r')
+      line.remove_suffix(1);
+    pos = end + 1;
+    return true;
+  }
+
+  // Minimum number of rows in one chunk of a parallel fill.
+  // Chunk sizes are multiples of 64, so that chunks never share a bitmap word.
+
+  const size_t kMIN_CHUNK_ROWS = 1024;
+
+  // Rows of one chunk of a fill, with local storage for text columns.
+
+  struct Chunk
+  {
+    size_t fBegin;                                   // First row.
+    size_t fEnd;                                     // Last row + 1.
+    std::vector<std::string> fChars;                 // Text arenas (by column).
+    std::vector<std::vector<std::uint64_t> > fEnds;  // Text end offsets (by column).
+    std::exception_ptr fError;                       // First error in this chunk.
+  };
+
+  // Convert IOV time field.  A dash means no end time.
+
+  lariov::IOVTimeStamp parseTime(std::string_view s)
+  {
+    if(s == "-")
+      return lariov::IOVTimeStamp::MaxTimeStamp();
+    return lariov::IOVTimeStamp::GetFromString(std::string(s));
+  }
+}
 
 // Default constructor.
 
@@ -24,8 +363,9 @@ lariov::DBDataset::DBDataset() :
 
 
 // Libwda initializing constructor.
+// Fields are read in place from the libwda tuples.
 
-lariov::DBDataset::DBDataset(void* dataset, bool release) :
+lariov::DBDataset::DBDataset(void* dataset, bool release, size_t parallel_rows) :
   fBeginTime(0, 0),
   fEndTime(0, 0)
 {
@@ -33,35 +373,21 @@ lariov::DBDataset::DBDataset(void* dataset, bool release) :
 
   size_t nrows = getNtuples(dataset) - kNUMBER_HEADER_ROWS;
   //mf::LogInfo("DBDataset") << "DBDataset: Number of rows = " << nrows << "\n";
-  fChannels.reserve(nrows);
 
   // Process header rows.
 
-  int err = 0;
-  char buf[kBUFFER_SIZE];
   Tuple tup;
 
   // Extract IOV begin time.
 
   tup = getTuple(dataset, 0);
-  getStringValue(tup, 0, buf, kBUFFER_SIZE, &err);
-  fBeginTime = IOVTimeStamp::GetFromString(std::string(buf));
-  //mf::LogInfo log("DBDataset");
-  //log << "DBDataset: Begin time stamp input = " << buf << "\n";
-  //log << "DBDataset: Begin time stamp = " << fBeginTime.DBStamp() << "\n";
+  fBeginTime = parseTime(tupleField(tup, 0));
   releaseTuple(tup);
 
   // Extract IOV end time.
 
   tup = getTuple(dataset, 1);
-  getStringValue(tup, 0, buf, kBUFFER_SIZE, &err);
-  if ( 0 == strcmp(buf,"-") )
-    fEndTime = IOVTimeStamp::MaxTimeStamp();
-  else
-    fEndTime = IOVTimeStamp::GetFromString(std::string(buf));
-  //mf::LogInfo log("DBDataset");
-  //log << "DBDataset: End time stamp input = " << buf << "\n";
-  //log << "DBDataset: End time stamp = " << fEndTime.DBStamp() << "\n";
+  fEndTime = parseTime(tupleField(tup, 0));
   releaseTuple(tup);
 
   // Extract column names.
@@ -70,103 +396,342 @@ lariov::DBDataset::DBDataset(void* dataset, bool release) :
   size_t ncols = getNfields(tup);
   //mf::LogInfo("DBDataset") << "DBDataset: Number of columns = " << ncols << "\n";
   fColNames.reserve(ncols);
-  for (size_t col=0; col<ncols; ++col) {
-    getStringValue(tup, col, buf, kBUFFER_SIZE, &err);
-    //mf::LogInfo("DBDataset") << "DBDataset: Column name = " << buf << "\n";
-    fColNames.push_back(std::string(buf));
-  }
+  for (size_t col=0; col<ncols; ++col)
+    fColNames.emplace_back(tupleField(tup, col));
   releaseTuple(tup);
 
   // Extract column types.
 
   tup = getTuple(dataset, 3);
   fColTypes.reserve(ncols);
-  for (size_t col=0; col < ncols; ++col) {
-    getStringValue(tup, col, buf, kBUFFER_SIZE, &err);
-    //mf::LogInfo("DBDataset") << "DBDataset: Column type = " << buf << "\n";
-    fColTypes.push_back(std::string(buf));
-  }
+  for (size_t col=0; col < ncols; ++col)
+    fColTypes.emplace_back(tupleField(tup, col));
   releaseTuple(tup);
 
-  // Extract data.  Loop over rows.
+  // Get data tuples.
+  // Libwda is only called from this thread.  Parallel tasks only read the tuples.
 
-  fData.reserve(nrows * ncols);
-  for(size_t row = 0; row < nrows; ++row) {
-    //mf::LogInfo("DBDataset") << "\nRow " << row << "\n";
-    tup = getTuple(dataset, row + kNUMBER_HEADER_ROWS);
+  std::vector<Tuple> tuples(nrows);
+  for(size_t row = 0; row < nrows; ++row)
+    tuples[row] = getTuple(dataset, row + kNUMBER_HEADER_ROWS);
 
-    // Loop over columns.
+  // Extract data.
 
-    for(size_t col = 0; col < ncols; ++col) {
-      getStringValue(tup, col, buf, kBUFFER_SIZE, &err);
+  try {
+    fillRows(nrows, [&tuples, ncols](size_t row, std::vector<std::string_view>& fields,
+				     std::deque<std::string>&) {
+		      fields.resize(ncols);
+		      for(size_t col = 0; col < ncols; ++col)
+			fields[col] = tupleField(tuples[row], col);
+		    }, parallel_rows);
+  }
+  catch(...) {
+    for(Tuple t : tuples)
+      releaseTuple(t);
+    if(release)
+      releaseDataset(dataset);
+    throw;
+  }
+  for(Tuple t : tuples)
+    releaseTuple(t);
 
-      // Convert string value to DBDataset::value_type (std::variant).
+  // Maybe release dataset memory.
 
-      if(fColTypes[col] == "integer" || fColTypes[col] == "bigint") {
-	long value = strtol(buf, 0, 10);
-	fData.push_back(value_type(value));
-	//mf::LogInfo("DBDataset") << "DBDataset: row=" << row << ", column=" << col << ", value=" << fData.back()
-	//	<< "\n";
-	if(col == 0) {
-	  fChannels.push_back(value);
-	  //mf::LogInfo("DBDataset") << "DBDataset: channel=" << fChannels.back() << "\n";
-	}
-      }
-      else if(fColTypes[col] == "real") {
-	double value = strtod(buf, 0);
-	fData.push_back(value_type(value));
-	//mf::LogInfo("DBDataset") << "DBDataset: row=" << row << ", column=" << col << ", value=" << fData.back()
-	//	<< "\n";
-	if(col == 0) {
-	  mf::LogError("DBDataset") << "First column has wrong type real." << "\n";
-	  throw cet::exception("DBDataset") << "First column has wrong type real.";
-	}
-      }
-      else if(fColTypes[col] == "text") {
-	fData.emplace_back(std::make_unique<std::string>(buf));
-	//mf::LogInfo("DBDataset") << "DBDataset: row=" << row << ", column=" << col << ", value=" << fData.back()
-	//	<< "\n";
-	if(col == 0) {
-	  mf::LogError("DBDataset") << "First column has wrong type text." << "\n";
-	  throw cet::exception("DBDataset") << "First column has wrong type text.";
-	}
-      }
-      else if(fColTypes[col] == "boolean") {
-	long value = 0;
-	std::string s = std::string(buf);
-	if(s == "true" || s == "True" || s == "TRUE" || s == "1")
-	  value = 1;
-	else if(s == "false" || s == "False" || s == "FALSE" || s == "0")
-	  value = 0;
-	else {
-	  mf::LogError("DBDataset") << "Unknown string representation of boolean " << s << "\n";
-	  throw cet::exception("DBDataset") << "Unknown string representation of boolean " << s
-					    << "\n";
-	}
-	fData.push_back(value_type(value));
-	//mf::LogInfo("DBDataset") << "DBDataset: row=" << row << ", column=" << col << ", value=" << fData.back()
-	//	<< "\n";
-	if(col == 0) {
-	  mf::LogError("DBDataset") << "First column has wrong type boolean." << "\n";
-	  throw cet::exception("DBDataset") << "First column has wrong type boolean.";
+  if(release)
+    releaseDataset(dataset);
+}
+
+// Parse the text (csv) body of a database server response.
+// The first four lines are IOV begin time, IOV end time, column names,
+// and column types.  Remaining lines are data rows.
+
+void lariov::DBDataset::parse(std::string_view body, size_t parallel_rows)
+{
+  std::string_view line;
+  size_t pos = 0;
+
+  // Header lines.
+
+  std::string_view header[kNUMBER_HEADER_ROWS];
+  for(unsigned int i=0; i<kNUMBER_HEADER_ROWS; ++i) {
+    if(!nextLine(body, pos, header[i])) {
+      mf::LogError("DBDataset") << "Incomplete response header." << "\n";
+      throw cet::exception("DBDataset") << "Incomplete response header.";
+    }
+  }
+  parseHeader(header);
+
+  // Find data lines.
+
+  std::vector<std::string_view> lines;
+  while(nextLine(body, pos, line)) {
+    if(!line.empty())
+      lines.push_back(line);
+  }
+
+  // Extract data.
+
+  fillRows(lines.size(), [&lines](size_t row, std::vector<std::string_view>& fields,
+				  std::deque<std::string>& scratch) {
+	     splitLine(lines[row], fields, scratch);
+	   }, parallel_rows);
+}
+
+// Set IOV and column schema from the kNUMBER_HEADER_ROWS header lines of a
+// text response: begin time, end time, column names, column types.
+
+void lariov::DBDataset::parseHeader(const std::string_view* lines)
+{
+  std::vector<std::string_view> fields;
+  std::deque<std::string> scratch;
+  fBeginTime = parseTime(lines[0]);
+  fEndTime = parseTime(lines[1]);
+  splitLine(lines[2], fields, scratch);
+  fColNames.assign(fields.begin(), fields.end());
+  splitLine(lines[3], fields, scratch);
+  fColTypes.assign(fields.begin(), fields.end());
+  if(fColNames.size() != fColTypes.size()) {
+    mf::LogError("DBDataset") << "Column names and types do not match." << "\n";
+    throw cet::exception("DBDataset") << "Column names and types do not match.";
+  }
+}
+
+// Append one row of text fields.
+// Conversions are the same as in fillRows.
+
+void lariov::DBDataset::appendFields(const std::vector<std::string_view>& fields)
+{
+  if(fChannels.empty())
+    checkFirstColumn(1);
+  for(size_t col = 0; col < fColumns.size(); ++col) {
+    Column& column = fColumns[col];
+    std::string_view field = col < fields.size() ? fields[col] : std::string_view();
+    const char* first = field.data();
+    const char* last = first + field.size();
+    switch(column.fKind) {
+    case kLong:
+      column.fLong.push_back(parseLong(first, last));
+      break;
+    case kDouble:
+      column.fDouble.push_back(parseDouble(first, last));
+      break;
+    case kBool:
+      appendBool(column, parseBool(field));
+      break;
+    case kString:
+      column.fChars.append(first, field.size());
+      column.fOffsets.push_back(column.fChars.size());
+      break;
+    }
+    ++column.fSize;
+  }
+  fChannels.push_back(fColumns.empty() ? 0 : fColumns[0].fLong.back());
+}
+
+// Incremental text parser.
+
+lariov::DBDataset::TextParser::TextParser(DBDataset& dataset) :
+  fDataset(dataset)
+{}
+
+// Convert the complete lines of the next piece of the body.  Lines are
+// converted in place, except a line split between pieces, which is collected
+// in fPartial.
+
+void lariov::DBDataset::TextParser::feed(std::string_view data)
+{
+  size_t pos = 0;
+  if(!fPartial.empty()) {
+    size_t end = data.find('\n');
+    if(end == std::string_view::npos) {
+      fPartial.append(data.data(), data.size());
+      return;
+    }
+    fPartial.append(data.data(), end);
+    line(fPartial);
+    fPartial.clear();
+    pos = end + 1;
+  }
+  for(size_t end; (end = data.find('\n', pos)) != std::string_view::npos; pos = end + 1)
+    line(data.substr(pos, end - pos));
+  fPartial.assign(data.data() + pos, data.size() - pos);
+}
+
+// End of body.
+
+void lariov::DBDataset::TextParser::finish()
+{
+  if(!fPartial.empty()) {
+    line(fPartial);
+    fPartial.clear();
+  }
+  if(fHeader.size() < kNUMBER_HEADER_ROWS) {
+    mf::LogError("DBDataset") << "Incomplete response header." << "\n";
+    throw cet::exception("DBDataset") << "Incomplete response header.";
+  }
+}
+
+// Convert one line: a header line (the schema is set after the last one),
+// or a data row (empty lines are skipped).
+
+void lariov::DBDataset::TextParser::line(std::string_view line)
+{
+  if(!line.empty() && line.back() == '\r')
+    line.remove_suffix(1);
+  if(fHeader.size() < kNUMBER_HEADER_ROWS) {
+    fHeader.emplace_back(line);
+    if(fHeader.size() == kNUMBER_HEADER_ROWS) {
+      std::string_view header[kNUMBER_HEADER_ROWS];
+      std::copy(fHeader.begin(), fHeader.end(), header);
+      fDataset.parseHeader(header);
+      fDataset.makeColumns(0);
+    }
+  }
+  else if(!line.empty()) {
+    splitLine(line, fFields, fScratch);
+    fDataset.appendFields(fFields);
+  }
+}
+
+// Fill columns from rows of text fields.
+//
+// Function getFields(row, fields, scratch) returns the fields of one row (scratch
+// is storage for fields that can not be views).  Missing fields are treated as
+// empty.
+//
+// All column arrays are allocated up front.  Rows are converted in chunks, which
+// write directly into their own slices of the numeric and boolean arrays, and
+// into chunk-local arenas for text columns, which are concatenated at the end.
+// If there are at least parallel_rows rows (and parallel_rows > 0), chunks are
+// processed in parallel using tbb.  Otherwise the whole range is one chunk,
+// processed in this thread.  In either case, the exception thrown is the one for
+// the first bad row.
+
+template<class GetFields>
+void lariov::DBDataset::fillRows(size_t nrows, const GetFields& getFields, size_t parallel_rows)
+{
+  size_t ncols = fColNames.size();
+  makeColumns(0);
+  checkFirstColumn(nrows);
+
+  // Allocate columns.
+
+  fChannels.resize(nrows);
+  for(Column& column : fColumns) {
+    column.fSize = nrows;
+    if(column.fKind == kLong)
+      column.fLong.resize(nrows);
+    else if(column.fKind == kDouble)
+      column.fDouble.resize(nrows);
+    else if(column.fKind == kBool)
+      column.fBits.assign((nrows + 63) / 64, 0);
+  }
+
+  // Divide rows into chunks.
+
+  size_t chunk_rows = nrows;
+  if(parallel_rows > 0 && nrows >= parallel_rows) {
+    size_t nthreads = tbb::this_task_arena::max_concurrency();
+    chunk_rows = std::max(kMIN_CHUNK_ROWS, nrows / (4 * nthreads) + 1);
+    chunk_rows = (chunk_rows + 63) / 64 * 64;
+  }
+  std::vector<Chunk> chunks;
+  for(size_t begin = 0; begin < nrows || chunks.empty(); begin += chunk_rows) {
+    chunks.emplace_back();
+    Chunk& chunk = chunks.back();
+    chunk.fBegin = begin;
+    chunk.fEnd = std::min(nrows, begin + chunk_rows);
+    chunk.fChars.resize(ncols);
+    chunk.fEnds.resize(ncols);
+  }
+
+  // Convert one chunk.
+
+  auto fillChunk = [this, ncols, &getFields](Chunk& chunk) {
+    std::vector<std::string_view> fields;
+    std::deque<std::string> scratch;
+    try {
+      for(size_t row = chunk.fBegin; row < chunk.fEnd; ++row) {
+	getFields(row, fields, scratch);
+	for(size_t col = 0; col < ncols; ++col) {
+	  Column& column = fColumns[col];
+	  std::string_view field = col < fields.size() ? fields[col] : std::string_view();
+	  const char* first = field.data();
+	  const char* last = first + field.size();
+	  switch(column.fKind) {
+	  case kLong:
+	    column.fLong[row] = parseLong(first, last);
+	    break;
+	  case kDouble:
+	    column.fDouble[row] = parseDouble(first, last);
+	    break;
+	  case kBool:
+	    if(parseBool(field))
+	      column.fBits[row >> 6] |= (std::uint64_t(1) << (row & 63));
+	    break;
+	  case kString:
+	    chunk.fChars[col].append(first, field.size());
+	    chunk.fEnds[col].push_back(chunk.fChars[col].size());
+	    break;
+	  }
 	}
+	if(ncols > 0)
+	  fChannels[row] = fColumns[0].fLong[row];
       }
-      else {
-	mf::LogError("DBDataset") << "Unknown datatype = " << fColTypes[col] << "\n";
-	throw cet::exception("DBDataset") << "Unknown datatype = " << fColTypes[col]
-					  << ": " << buf << "\n";
-      }
     }
-    releaseTuple(tup);
+    catch(...) {
+      chunk.fError = std::current_exception();
+    }
+  };
+
+  if(chunks.size() == 1)
+    fillChunk(chunks.front());
+  else {
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size(), 1),
+		      [&chunks, &fillChunk](const tbb::blocked_range<size_t>& range) {
+			for(size_t i = range.begin(); i != range.end(); ++i)
+			  fillChunk(chunks[i]);
+		      });
   }
 
-  // Maybe release dataset memory.
+  // Report the first error.
 
-  if(release)
-    releaseDataset(dataset);
+  for(const Chunk& chunk : chunks) {
+    if(chunk.fError)
+      std::rethrow_exception(chunk.fError);
+  }
+
+  // Concatenate text arenas.
+
+  for(size_t col = 0; col < ncols; ++col) {
+    Column& column = fColumns[col];
+    if(column.fKind != kString)
+      continue;
+    size_t nchars = 0;
+    for(const Chunk& chunk : chunks)
+      nchars += chunk.fChars[col].size();
+    column.fChars.reserve(nchars);
+    column.fOffsets.reserve(nrows + 1);
+    for(const Chunk& chunk : chunks) {
+      std::uint64_t base = column.fChars.size();
+      column.fChars += chunk.fChars[col];
+      for(std::uint64_t end : chunk.fEnds[col])
+	column.fOffsets.push_back(base + end);
+    }
+  }
+}
+
+// Check that the first column contains channels.
+
+void lariov::DBDataset::checkFirstColumn(size_t nrows) const
+{
+  if(nrows > 0 && !fColumns.empty() && fColumns[0].fKind != kLong) {
+    mf::LogError("DBDataset") << "First column has wrong type " << fColTypes[0] << "." << "\n";
+    throw cet::exception("DBDataset") << "First column has wrong type " << fColTypes[0] << ".";
+  }
 }
 
-// SQLite initializing move constructor.
+// Row-major values initializing move constructor.
 
 lariov::DBDataset::DBDataset(const IOVTimeStamp& begin_time,         // IOV begin time.
 			     const IOVTimeStamp& end_time,           // IOV end time.
@@ -177,10 +742,246 @@ lariov::DBDataset::DBDataset(const IOVTimeStamp& begin_time,         // IOV begi
   fBeginTime(begin_time),
   fEndTime(end_time),
   fColNames(std::move(col_names)),
-  fColTypes(std::move(col_types)),
-  fChannels(std::move(channels)),
-  fData(std::move(data))
-{}
+  fColTypes(std::move(col_types))
+{
+  size_t nrows = channels.size();
+  size_t ncols = fColNames.size();
+  if(data.size() != nrows * ncols) {
+    mf::LogError("DBDataset") << "Wrong number of values " << data.size() << "\n";
+    throw cet::exception("DBDataset") << "Wrong number of values " << data.size();
+  }
+  makeColumns(nrows);
+  for(size_t i=0; i<data.size(); ++i) {
+    size_t col = i % ncols;
+    const value_type& value = data[i];
+    if(std::holds_alternative<long>(value))
+      appendLong(col, std::get<long>(value));
+    else if(std::holds_alternative<double>(value))
+      appendDouble(col, std::get<double>(value));
+    else if(std::get<std::unique_ptr<std::string> >(value))
+      appendString(col, *std::get<std::unique_ptr<std::string> >(value));
+    else
+      appendNull(col);
+  }
+  fChannels = std::move(channels);
+}
+
+// Incremental filling constructor.
+
+lariov::DBDataset::DBDataset(const IOVTimeStamp& begin_time,         // IOV begin time.
+			     const IOVTimeStamp& end_time,           // IOV end time.
+			     std::vector<std::string>&& col_names,   // Column names.
+			     std::vector<std::string>&& col_types,   // Column types.
+			     size_t nrows_hint) :                    // Expected number of rows.
+  fBeginTime(begin_time),
+  fEndTime(end_time),
+  fColNames(std::move(col_names)),
+  fColTypes(std::move(col_types))
+{
+  makeColumns(nrows_hint);
+}
+
+// Initialize empty columns from column types.
+
+void lariov::DBDataset::makeColumns(size_t nrows_hint)
+{
+  fMapping.reset();
+  fChannels.clear();
+  fChannels.reserve(nrows_hint);
+  fColumns.clear();
+  fColumns.resize(fColTypes.size());
+  for(size_t col=0; col<fColTypes.size(); ++col) {
+    Column& column = fColumns[col];
+    if(!kindFromType(fColTypes[col], column.fKind)) {
+      mf::LogError("DBDataset") << "Unknown datatype = " << fColTypes[col] << "\n";
+      throw cet::exception("DBDataset") << "Unknown datatype = " << fColTypes[col] << "\n";
+    }
+    column.fSize = 0;
+    if(column.fKind == kLong)
+      column.fLong.reserve(nrows_hint);
+    else if(column.fKind == kDouble)
+      column.fDouble.reserve(nrows_hint);
+    else if(column.fKind == kBool)
+      column.fBits.reserve((nrows_hint + 63) / 64);
+    else {
+      column.fOffsets.reserve(nrows_hint + 1);
+      column.fOffsets.push_back(0);
+    }
+  }
+}
+
+// Append values.
+
+void lariov::DBDataset::appendLong(size_t col, long value)
+{
+  Column& column = fColumns[col];
+  if(column.fKind == kLong)
+    column.fLong.push_back(value);
+  else if(column.fKind == kDouble)
+    column.fDouble.push_back(value);
+  else if(column.fKind == kBool)
+    appendBool(column, value != 0);
+  else
+    typeError(col, "long");
+  ++column.fSize;
+  column.fOnlyNulls = false;
+  if(col == 0)
+    fChannels.push_back(value);
+}
+
+void lariov::DBDataset::appendDouble(size_t col, double value)
+{
+  Column& column = fColumns[col];
+  if(col == 0 || column.fKind == kString)
+    typeError(col, "double");
+  else if(column.fKind == kDouble)
+    column.fDouble.push_back(value);
+  else if(column.fKind == kLong) {
+    promote(col, kDouble);
+    column.fDouble.push_back(value);
+  }
+  else
+    appendBool(column, value != 0.);
+  ++column.fSize;
+  column.fOnlyNulls = false;
+}
+
+void lariov::DBDataset::appendString(size_t col, std::string_view value)
+{
+  Column& column = fColumns[col];
+  if(col != 0 && column.fKind == kLong && column.fOnlyNulls)
+    promote(col, kString);
+  if(col == 0 || column.fKind != kString)
+    typeError(col, "text");
+  column.fOnlyNulls = false;
+  column.fChars.append(value.data(), value.size());
+  column.fOffsets.push_back(column.fChars.size());
+  ++column.fSize;
+}
+
+void lariov::DBDataset::appendNull(size_t col)
+{
+  Column& column = fColumns[col];
+  if(col == 0)
+    typeError(col, "null");
+  else if(column.fKind == kString)
+    column.fOffsets.push_back(column.fChars.size());
+  else if(column.fKind == kDouble)
+    column.fDouble.push_back(0.);
+  else if(column.fKind == kLong)
+    column.fLong.push_back(0);
+  else
+    appendBool(column, false);
+  ++column.fSize;
+}
+
+// Change the storage of a kLong column that is being filled (sqlite data,
+// where column types come from the first value): to kDouble when a real value
+// arrives, or to kString when a text value arrives and all values so far were
+// null.  Values already stored are converted.
+
+void lariov::DBDataset::promote(size_t col, ColumnKind kind)
+{
+  Column& column = fColumns[col];
+  if(kind == kDouble) {
+    column.fDouble.assign(column.fLong.begin(), column.fLong.end());
+    fColTypes[col] = "real";
+  }
+  else {
+    column.fOffsets.assign(column.fSize + 1, 0);
+    fColTypes[col] = "text";
+  }
+  column.fLong.clear();
+  column.fLong.shrink_to_fit();
+  column.fKind = kind;
+}
+
+// Append boolean value to bitmap (caller updates size).
+
+void lariov::DBDataset::appendBool(Column& column, bool value)
+{
+  size_t bit = column.fSize & 63;
+  if(bit == 0)
+    column.fBits.push_back(0);
+  if(value)
+    column.fBits.back() |= (std::uint64_t(1) << bit);
+}
+
+// Order rows by increasing channel number.
+
+void lariov::DBDataset::sortRows()
+{
+  if(std::is_sorted(fChannels.begin(), fChannels.end()))
+    return;
+
+  size_t nrows = fChannels.size();
+  std::vector<size_t> order(nrows);
+  for(size_t i=0; i<nrows; ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(),
+		   [this](size_t i, size_t j) {return fChannels[i] < fChannels[j];});
+
+  // Permute channels and each column.
+
+  std::vector<DBChannelID_t> channels(nrows);
+  for(size_t i=0; i<nrows; ++i)
+    channels[i] = fChannels[order[i]];
+  fChannels = std::move(channels);
+
+  // Sorted columns are always owned, even if the input was mapped.
+
+  for(Column& column : fColumns) {
+    Column sorted;
+    sorted.fKind = column.fKind;
+    if(column.fKind == kLong) {
+      const long* values = column.longs();
+      sorted.fLong.resize(nrows);
+      for(size_t i=0; i<nrows; ++i)
+	sorted.fLong[i] = values[order[i]];
+      sorted.fSize = nrows;
+    }
+    else if(column.fKind == kDouble) {
+      const double* values = column.doubles();
+      sorted.fDouble.resize(nrows);
+      for(size_t i=0; i<nrows; ++i)
+	sorted.fDouble[i] = values[order[i]];
+      sorted.fSize = nrows;
+    }
+    else if(column.fKind == kBool) {
+      sorted.fBits.reserve((nrows + 63) / 64);
+      for(size_t i=0; i<nrows; ++i) {
+	appendBool(sorted, column.bit(order[i]));
+	++sorted.fSize;
+      }
+    }
+    else {
+      const std::uint64_t* offsets = column.offsets();
+      const char* chars = column.chars();
+      sorted.fChars.reserve(offsets[nrows]);
+      sorted.fOffsets.reserve(nrows + 1);
+      sorted.fOffsets.push_back(0);
+      for(size_t i=0; i<nrows; ++i) {
+	size_t begin = offsets[order[i]];
+	size_t end = offsets[order[i]+1];
+	sorted.fChars.append(chars + begin, end - begin);
+	sorted.fOffsets.push_back(sorted.fChars.size());
+      }
+      sorted.fSize = nrows;
+    }
+    column = std::move(sorted);
+  }
+  fMapping.reset();
+}
+
+// Throw exception for wrong type access.
+
+void lariov::DBDataset::typeError(size_t col, const char* type) const
+{
+  mf::LogError("DBDataset") << "Column " << fColNames[col] << " of type " << fColTypes[col]
+			    << " can not be accessed as " << type << "\n";
+  throw cet::exception("DBDataset") << "Column " << fColNames[col] << " of type " << fColTypes[col]
+				    << " can not be accessed as " << type;
+}
 
 // Get row number by channel number.
 // Return -1 if not found.
@@ -240,3 +1041,321 @@ int lariov::DBDataset::getColNumber(const std::string& name) const
 
   return result;
 }
+
+// Check whether another dataset has the same columns (names and storage kinds).
+
+bool lariov::DBDataset::sameColumns(const DBDataset& other) const
+{
+  if(fColNames != other.fColNames)
+    return false;
+  for(size_t col=0; col<fColumns.size(); ++col) {
+    if(fColumns[col].fKind != other.fColumns[col].fKind)
+      return false;
+  }
+  return true;
+}
+
+// Compare the values of one row with one row of another dataset with the
+// same columns.  The channel (column zero) is not compared.  Values are
+// compared as stored (nan never compares equal).
+
+bool lariov::DBDataset::sameRow(size_t row, const DBDataset& other, size_t other_row) const
+{
+  for(size_t col=1; col<fColumns.size(); ++col) {
+    switch(fColumns[col].fKind) {
+    case kLong:
+    case kBool:
+      if(getLongData(row, col) != other.getLongData(other_row, col))
+	return false;
+      break;
+    case kDouble:
+      if(!(getDoubleData(row, col) == other.getDoubleData(other_row, col)))
+	return false;
+      break;
+    case kString:
+      if(getStringData(row, col) != other.getStringData(other_row, col))
+	return false;
+      break;
+    }
+  }
+  return true;
+}
+
+// Access one value as a variant.
+
+lariov::DBDataset::value_type lariov::DBDataset::getData(size_t row, size_t col) const
+{
+  switch(fColumns[col].fKind) {
+  case kDouble:
+    return value_type(getDoubleData(row, col));
+  case kString:
+    return value_type(std::make_unique<std::string>(getStringData(row, col)));
+  default:
+    return value_type(getLongData(row, col));
+  }
+}
+
+// Row-major copy of all values (deprecated).
+
+std::vector<lariov::DBDataset::value_type> lariov::DBDataset::data() const
+{
+  std::vector<value_type> result;
+  result.reserve(nrows() * ncols());
+  for(size_t row=0; row<nrows(); ++row) {
+    for(size_t col=0; col<ncols(); ++col)
+      result.push_back(getData(row, col));
+  }
+  return result;
+}
+
+// Approximate memory usage in bytes.
+// Mapped snapshot data are not counted (they are shared, reclaimable pages).
+
+size_t lariov::DBDataset::memoryUsage() const
+{
+  size_t result = sizeof(DBDataset);
+  for(const std::string& name : fColNames)
+    result += sizeof(std::string) + name.capacity();
+  for(const std::string& type : fColTypes)
+    result += sizeof(std::string) + type.capacity();
+  result += fChannels.capacity() * sizeof(DBChannelID_t);
+  for(const Column& column : fColumns) {
+    result += sizeof(Column);
+    result += column.fLong.capacity() * sizeof(long);
+    result += column.fDouble.capacity() * sizeof(double);
+    result += column.fBits.capacity() * sizeof(std::uint64_t);
+    result += column.fOffsets.capacity() * sizeof(std::uint64_t);
+    result += column.fChars.capacity();
+  }
+  return result;
+}
+
+// Write snapshot.
+
+void lariov::DBDataset::writeSnapshot(std::ostream& out, const std::string& folder,
+				      const std::string& tag) const
+{
+  size_t nr = nrows();
+  size_t nc = ncols();
+
+  // Schema.
+
+  std::string schema;
+  putString(schema, folder);
+  putString(schema, tag);
+  for(const std::string& name : fColNames)
+    putString(schema, name);
+  for(const std::string& type : fColTypes)
+    putString(schema, type);
+
+  // Layout.
+
+  SnapshotHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.fMagic, kSNAPSHOT_MAGIC, sizeof(header.fMagic));
+  header.fVersion = kSNAPSHOT_VERSION;
+  header.fEndian = kSNAPSHOT_ENDIAN;
+  header.fBeginStamp = fBeginTime.Stamp();
+  header.fBeginSubStamp = fBeginTime.SubStamp();
+  header.fEndStamp = fEndTime.Stamp();
+  header.fEndSubStamp = fEndTime.SubStamp();
+  header.fNRows = nr;
+  header.fNCols = nc;
+  header.fSchemaOffset = align8(sizeof(SnapshotHeader));
+  header.fSchemaSize = schema.size();
+  header.fChannelsOffset = header.fSchemaOffset + align8(schema.size());
+  header.fColumnsOffset = header.fChannelsOffset + align8(nr * sizeof(DBChannelID_t));
+  std::uint64_t pos = header.fColumnsOffset + align8(nc * sizeof(SnapshotColumn));
+
+  std::vector<SnapshotColumn> table(nc);
+  std::vector<const void*> values(nc);
+  for(size_t col=0; col<nc; ++col) {
+    const Column& column = fColumns[col];
+    SnapshotColumn& entry = table[col];
+    std::memset(&entry, 0, sizeof(entry));
+    entry.fKind = column.fKind;
+    if(column.fKind == kLong) {
+      values[col] = column.longs();
+      entry.fValuesSize = nr * sizeof(long);
+    }
+    else if(column.fKind == kDouble) {
+      values[col] = column.doubles();
+      entry.fValuesSize = nr * sizeof(double);
+    }
+    else if(column.fKind == kBool) {
+      values[col] = column.bits();
+      entry.fValuesSize = (nr + 63) / 64 * sizeof(std::uint64_t);
+    }
+    else {
+      values[col] = column.offsets();
+      entry.fValuesSize = (nr + 1) * sizeof(std::uint64_t);
+      entry.fCharsSize = column.offsets()[nr];
+    }
+    entry.fValuesOffset = pos;
+    pos += align8(entry.fValuesSize);
+    entry.fCharsOffset = pos;
+    pos += align8(entry.fCharsSize);
+  }
+  header.fSize = pos;
+
+  // Sections following the header.
+
+  auto sections = [&](auto&& section) {
+    section(schema.data(), schema.size());
+    section(fChannels.data(), nr * sizeof(DBChannelID_t));
+    section(table.data(), nc * sizeof(SnapshotColumn));
+    for(size_t col=0; col<nc; ++col) {
+      section(values[col], table[col].fValuesSize);
+      if(fColumns[col].fKind == kString)
+	section(fColumns[col].chars(), table[col].fCharsSize);
+    }
+  };
+
+  // Checksum.
+
+  std::uint64_t sum = snapshotChecksum(kCHECKSUM_SEED, &header, sizeof(header));
+  sections([&sum](const void* data, size_t n) {sum = snapshotChecksum(sum, data, n);});
+  header.fChecksum = sum;
+
+  // Write.
+
+  writePadded(out, &header, sizeof(header));
+  sections([&out](const void* data, size_t n) {writePadded(out, data, n);});
+}
+
+// Map snapshot file.
+
+bool lariov::DBDataset::mapSnapshot(const std::string& path, std::string* folder, std::string* tag)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0)
+    return false;
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size < off_t(sizeof(SnapshotHeader))) {
+    close(fd);
+    return false;
+  }
+  size_t size = st.st_size;
+  void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(addr == MAP_FAILED)
+    return false;
+  std::shared_ptr<const void> mapping(addr, [size](const void* p) {
+      munmap(const_cast<void*>(p), size);});
+  return attachSnapshot(mapping, static_cast<const char*>(addr), size, folder, tag);
+}
+
+// Use snapshot in memory.
+// Everything is validated before this dataset is changed.
+
+bool lariov::DBDataset::attachSnapshot(std::shared_ptr<const void> backing, const char* data,
+				       size_t size, std::string* folder, std::string* tag)
+{
+  // Check header.
+
+  SnapshotHeader header;
+  if(data == nullptr || reinterpret_cast<std::uintptr_t>(data) % 8 != 0 ||
+     size < sizeof(header))
+    return false;
+  std::memcpy(&header, data, sizeof(header));
+  if(std::memcmp(header.fMagic, kSNAPSHOT_MAGIC, sizeof(header.fMagic)) != 0 ||
+     header.fVersion != kSNAPSHOT_VERSION || header.fEndian != kSNAPSHOT_ENDIAN ||
+     header.fSize != size || header.fNRows > (1u << 28) || header.fNCols > (1u << 16) ||
+     header.fBeginSubStamp > kMAX_SUBSTAMP_VALUE || header.fEndSubStamp > kMAX_SUBSTAMP_VALUE)
+    return false;
+  std::uint64_t sum = header.fChecksum;
+  header.fChecksum = 0;
+  if(snapshotChecksum(snapshotChecksum(kCHECKSUM_SEED, &header, sizeof(header)),
+		      data + sizeof(header), size - sizeof(header)) != sum)
+    return false;
+  size_t nr = header.fNRows;
+  size_t nc = header.fNCols;
+
+  // Check that a section is inside the snapshot and aligned.
+
+  auto inside = [size](std::uint64_t offset, std::uint64_t n) {
+    return offset % 8 == 0 && offset <= size && n <= size - offset;};
+
+  // Schema.
+
+  if(!inside(header.fSchemaOffset, header.fSchemaSize))
+    return false;
+  const char* schema = data + header.fSchemaOffset;
+  size_t pos = 0;
+  std::string snap_folder;
+  std::string snap_tag;
+  std::vector<std::string> col_names(nc);
+  std::vector<std::string> col_types(nc);
+  if(!getString(schema, header.fSchemaSize, pos, snap_folder) ||
+     !getString(schema, header.fSchemaSize, pos, snap_tag))
+    return false;
+  for(size_t col=0; col<nc; ++col) {
+    if(!getString(schema, header.fSchemaSize, pos, col_names[col]))
+      return false;
+  }
+  for(size_t col=0; col<nc; ++col) {
+    if(!getString(schema, header.fSchemaSize, pos, col_types[col]))
+      return false;
+  }
+  if(pos != header.fSchemaSize)
+    return false;
+
+  // Channels and column table.
+
+  if(!inside(header.fChannelsOffset, nr * sizeof(DBChannelID_t)) ||
+     !inside(header.fColumnsOffset, nc * sizeof(SnapshotColumn)))
+    return false;
+  const DBChannelID_t* channels = reinterpret_cast<const DBChannelID_t*>(data + header.fChannelsOffset);
+  const SnapshotColumn* table = reinterpret_cast<const SnapshotColumn*>(data + header.fColumnsOffset);
+
+  // Columns.
+
+  std::vector<Column> columns(nc);
+  for(size_t col=0; col<nc; ++col) {
+    const SnapshotColumn& entry = table[col];
+    Column& column = columns[col];
+    if(!kindFromType(col_types[col], column.fKind) || entry.fKind != std::uint32_t(column.fKind))
+      return false;
+    std::uint64_t values_size = 0;
+    if(column.fKind == kLong || column.fKind == kDouble)
+      values_size = nr * 8;
+    else if(column.fKind == kBool)
+      values_size = (nr + 63) / 64 * 8;
+    else
+      values_size = (nr + 1) * 8;
+    if(entry.fValuesSize != values_size || !inside(entry.fValuesOffset, entry.fValuesSize))
+      return false;
+    column.fSize = nr;
+    column.fMapValues = data + entry.fValuesOffset;
+
+    // Text offsets must be increasing and inside the arena.
+
+    if(column.fKind == kString) {
+      if(!inside(entry.fCharsOffset, entry.fCharsSize))
+	return false;
+      column.fMapChars = data + entry.fCharsOffset;
+      const std::uint64_t* offsets = column.offsets();
+      if(offsets[0] != 0 || offsets[nr] != entry.fCharsSize)
+	return false;
+      for(size_t row=0; row<nr; ++row) {
+	if(offsets[row] > offsets[row+1])
+	  return false;
+      }
+    }
+  }
+
+  // Everything is valid.  Update this dataset.
+
+  fBeginTime = IOVTimeStamp(header.fBeginStamp, header.fBeginSubStamp);
+  fEndTime = IOVTimeStamp(header.fEndStamp, header.fEndSubStamp);
+  fColNames = std::move(col_names);
+  fColTypes = std::move(col_types);
+  fChannels.assign(channels, channels + nr);
+  fColumns = std::move(columns);
+  fMapping = std::move(backing);
+  if(folder)
+    *folder = std::move(snap_folder);
+  if(tag)
+    *tag = std::move(snap_tag);
+  return true;
+}
@@ -8,7 +8,12 @@
 //          This class represents data extracted from the opaque wda struct Dataset,
 //          which struct represents the result of a calibration database query on a 
 //          particular database table in an IOV database.  Data is extracted and 
-//          copied from the Dataset struct using the wda api.
+//          copied from the Dataset struct using the wda api.  Fields are converted
+//          in place (no intermediate strings), using std::from_chars.
+//
+//          Datasets can also be filled directly from the text (csv) body of a
+//          server response (function parse), or from the body as it arrives
+//          (nested class TextParser).
 //
 //          Database data are essentially a rectangular array of values, indexed by
 //          (row, column).  Accessors are provided to access data as string, long, 
@@ -16,8 +21,14 @@
 //
 //          Rows are labeled by channel number.  Columns are labeled by name and type.
 //
-//          Binary values, which are stored as strings by wda, are stored as
-//          std::variant<long, double, unique_ptr<std::string> > > in this class.
+//          Data are stored by column.  Each column is a contiguous typed array,
+//          chosen according to the column type.
+//
+//          integer, bigint - long.
+//          real            - double.
+//          boolean         - Bitmap (one bit per row).
+//          text            - String arena (all values concatenated) plus an array
+//                            of nrows+1 offsets into the arena.
 //
 //          Columns are labeled by column name and type.
 //
@@ -28,27 +39,29 @@
 // fColNames  - Names of columns.
 // fColTypes  - Data types of columns.
 // fChannels  - Channel numbers (indexed by row number).
-// fData      - Calibration data.
+// fColumns   - Calibration data (indexed by column number).
 //
 // Normally, the first element of each row is an integer channel number.
 // Furthermore, it can be assumed that rows are ordered by increasing channel number.
-// 
-// Calibration data is contained in data member fData, which is a rectangular array 
-// of strings of dimension # channels x # cols.  For efficiency, calibration data are
-// stored using a single std::vector, which array is allocated once at
-// construction or update time.  Elements are accessed columnwise as follows.
-//
-// value = fData[ncols*row + column]
 //
-// Or use the provided accessors.
+// Numeric values of any column type can be read as long (booleans read as 0 or 1),
+// and numeric columns can be read as double.  Text columns can only be read as text.
 //
 // Nested class DBRow provides access to data from a single database row.
 //
+// Datasets can be saved as snapshot files, which are loaded with mmap and used
+// in place (functions writeSnapshot and mapSnapshot).  Snapshots are used by the
+// DBFolder on-disk cache.
+//
 // Created: 26-Oct-2020 - H. Greenlee
 //
 //=================================================================================
 
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <variant>
 #include <memory>
@@ -66,6 +79,10 @@ namespace lariov
 
     typedef std::variant<long, double, std::unique_ptr<std::string> > value_type;
 
+    // Column storage kind.
+
+    enum ColumnKind {kLong, kDouble, kBool, kString};
+
     // Nested class representing data from one row.
 
     class DBRow
@@ -74,23 +91,95 @@ namespace lariov
 
       // Constructors.
 
-      DBRow() : fData(nullptr) {}
-      DBRow(const value_type* s) : fData(s) {}
+      DBRow() : fDataset(nullptr), fRow(0) {}
+      DBRow(const DBDataset* dataset, size_t row) : fDataset(dataset), fRow(row) {}
+
+      // Accessors.
+
+      bool isValid() const {return fDataset != nullptr;}
+      size_t row() const {return fRow;}
+      std::string_view getStringData(size_t col) const {return fDataset->getStringData(fRow, col);}
+      long getLongData(size_t col) const {return fDataset->getLongData(fRow, col);}
+      double getDoubleData(size_t col) const {return fDataset->getDoubleData(fRow, col);}
+
+      // Deprecated variant accessor (returns a copy, not a reference).
+
+      [[deprecated("use getLongData, getDoubleData or getStringData")]]
+      value_type getData(size_t col) const {return fDataset->getData(fRow, col);}
+
+    private:
+
+      // Data members.
+
+      const DBDataset* fDataset;   // Borrowed referenced from enclosing class.
+      size_t fRow;                 // Row number.
+    };
+
+    // Read-only view of one whole column, aligned with channels().
+    // Valid for the lifetime of the dataset.
+
+    template<class T> class ColumnView
+    {
+    public:
+
+      // Constructors.
+
+      ColumnView() : fData(nullptr), fSize(0) {}
+      ColumnView(const T* data, size_t size) : fData(data), fSize(size) {}
 
       // Accessors.
 
-      bool isValid() const {return fData != nullptr;}
-      const value_type& getData(size_t col) const {return fData[col];}
-      const std::string& getStringData(size_t col) const {
-	return *std::get<std::unique_ptr<std::string> >(fData[col]);}
-      long getLongData(size_t col) const {return std::get<long>(fData[col]);}
-      double getDoubleData(size_t col) const {return std::get<double>(fData[col]);}
+      const T* data() const {return fData;}
+      size_t size() const {return fSize;}
+      bool empty() const {return fSize == 0;}
+      const T* begin() const {return fData;}
+      const T* end() const {return fData + fSize;}
+      const T& operator[](size_t row) const {return fData[row];}
 
     private:
 
-      // Data member.
+      // Data members.
 
-      const value_type* fData;   // Borrowed referenced from enclosing class.
+      const T* fData;    // Borrowed reference to column array.
+      size_t fSize;      // Number of rows.
+    };
+
+    // Incremental filling from the text (csv) body of a database server
+    // response, fed in pieces of any size as they arrive (for example from a
+    // transfer write callback).  Rows are converted as soon as they are
+    // complete, and only an incomplete last line is buffered.  The result is
+    // the same as parse of the whole body (converted in this thread).
+    // Throws if the body is malformed.
+
+    class TextParser
+    {
+    public:
+
+      // Constructor.  The dataset is filled by feed and finish.
+
+      explicit TextParser(DBDataset& dataset);
+
+      // Convert the complete lines of the next piece of the body.
+
+      void feed(std::string_view data);
+
+      // End of body.  Converts the last line, if unterminated.
+
+      void finish();
+
+    private:
+
+      // Convert one line.
+
+      void line(std::string_view line);
+
+      // Data members.
+
+      DBDataset& fDataset;                   // Dataset being filled.
+      std::string fPartial;                  // Incomplete line.
+      std::vector<std::string> fHeader;      // Header lines seen so far.
+      std::vector<std::string_view> fFields; // Fields of one line.
+      std::deque<std::string> fScratch;      // Unescaped quoted fields.
     };
 
   // Back to main class.
@@ -102,11 +191,19 @@ namespace lariov
     DBDataset();                                   // Default constructor.
 
     // Initializing constructor based on libwda struct.
+    // Rows are converted in parallel if there are at least parallel_rows
+    // rows (0 = never).
+
+    DBDataset(void* dataset, bool release=false, size_t parallel_rows=0);
+
+    // Fill from the text (csv) body of a database server response.
+    // Throws if the body is malformed.  Argument parallel_rows is the same
+    // as for the libwda constructor.
 
-    DBDataset(void* dataset, bool release=false);
+    void parse(std::string_view body, size_t parallel_rows=0);
 
-    // Initializing move constructor.
-    // This constructor is used to initialize sqlite data.
+    // Initializing move constructor from row-major values.
+    // Values are copied into columns according to the column types.
 
     DBDataset(const IOVTimeStamp& begin_time,         // IOV begin time.
 	      const IOVTimeStamp& end_time,           // IOV end time.
@@ -115,6 +212,31 @@ namespace lariov
 	      std::vector<DBChannelID_t>&& channels,  // Channels.
 	      std::vector<value_type>&& data);        // Calibration data (length nchan*ncol).
 
+    // Constructor for incremental filling (used for sqlite data).
+    // Fill row by row using the append functions, one call per column,
+    // then call sortRows if rows were not appended in channel order.
+
+    DBDataset(const IOVTimeStamp& begin_time,         // IOV begin time.
+	      const IOVTimeStamp& end_time,           // IOV end time.
+	      std::vector<std::string>&& col_names,   // Column names.
+	      std::vector<std::string>&& col_types,   // Column types.
+	      size_t nrows_hint = 0);                 // Expected number of rows.
+
+    // Append one value to a column.
+    // Numeric values are converted to the column type, except that an integer
+    // column that gets a real value becomes a real column (nothing is
+    // truncated), and an integer column that so far only got nulls becomes a
+    // text column when it gets a text value.  Null values are stored as zero
+    // or as an empty string.  Values appended to column zero are channels.
+
+    void appendLong(size_t col, long value);
+    void appendDouble(size_t col, double value);
+    void appendString(size_t col, std::string_view value);
+    void appendNull(size_t col);
+
+    // Order rows by increasing channel number.
+
+    void sortRows();
 
     // Simple accessors.
 
@@ -125,19 +247,141 @@ namespace lariov
     const std::vector<std::string>& colNames() const {return fColNames;}
     const std::vector<std::string>& colTypes() const {return fColTypes;}
     const std::vector<DBChannelID_t>& channels() const {return fChannels;}
-    const std::vector<value_type>& data() const {return fData;}
+    ColumnKind colKind(size_t col) const {return fColumns[col].fKind;}
 
     // Determine row and column numbers.
 
     int getRowNumber(DBChannelID_t ch) const;
     int getColNumber(const std::string& name) const;
 
+    // Compare with another dataset: same column names and storage, and same
+    // values in one row (channel excluded; requires same columns).
+
+    bool sameColumns(const DBDataset& other) const;
+    bool sameRow(size_t row, const DBDataset& other, size_t other_row) const;
+
     // Access one row.
 
-    DBRow getRow(size_t row) const {return DBRow(&fData[ncols()*row]);}
+    DBRow getRow(size_t row) const {return DBRow(this, row);}
+
+    // Access one value.
+
+    long getLongData(size_t row, size_t col) const;
+    double getDoubleData(size_t row, size_t col) const;
+    std::string_view getStringData(size_t row, size_t col) const;
+
+    // Access one value as a variant (copied; booleans read as long).
+
+    value_type getData(size_t row, size_t col) const;
+
+    // Deprecated row-major copy of all values (length nrows*ncols).
+
+    [[deprecated("use getRow, getColumn or the typed accessors")]]
+    std::vector<value_type> data() const;
+
+    // Access one whole column.
+    // Only T=long (integer, bigint) and T=double (real) columns are supported.
+    // Throws if the column is stored with a different type.
+
+    template<class T> ColumnView<T> getColumn(size_t col) const;
+
+    // Approximate memory usage in bytes (used for cache accounting).
+
+    size_t memoryUsage() const;
+
+    // Snapshot files.
+    //
+    // A snapshot holds one dataset (IOV, column schema, channels, typed columns
+    // and text arenas), plus the folder name and tag it belongs to, in a
+    // versioned binary layout that is used in place after mmap (no parsing).
+    // The layout is host-endian, which is checked when loading.  A checksum of
+    // the whole snapshot is verified when loading (one pass over the data).
+    //
+    // writeSnapshot  - Write snapshot to a stream.
+    // mapSnapshot    - Map a snapshot file and use its column data in place.
+    // attachSnapshot - Use a snapshot that is already in memory (8-byte aligned).
+    //                  The backing pointer keeps that memory alive as long as
+    //                  this dataset (or a copy) uses it.
+    //
+    // The load functions return false, leaving this dataset unchanged, if the
+    // data are not a valid snapshot (truncated, corrupted, or written by a
+    // different snapshot version).  Mapped datasets must not be appended to.
+
+    void writeSnapshot(std::ostream& out, const std::string& folder = "",
+		       const std::string& tag = "") const;
+    bool mapSnapshot(const std::string& path, std::string* folder = nullptr,
+		     std::string* tag = nullptr);
+    bool attachSnapshot(std::shared_ptr<const void> backing, const char* data, size_t size,
+			std::string* folder = nullptr, std::string* tag = nullptr);
+    bool isMapped() const {return bool(fMapping);}
 
   private:
 
+    // Storage for one column.
+    // Only the arrays that match the column kind are used.
+    // For datasets loaded from a snapshot, the arrays are empty and the data
+    // are read from mapped memory instead.
+
+    struct Column
+    {
+      ColumnKind fKind = kLong;            // Storage kind.
+      size_t fSize = 0;                    // Number of values.
+      std::vector<long> fLong;             // kLong values.
+      std::vector<double> fDouble;         // kDouble values.
+      std::vector<std::uint64_t> fBits;    // kBool values (bitmap).
+      std::vector<std::uint64_t> fOffsets; // kString offsets (length nrows+1).
+      std::string fChars;                  // kString arena.
+      const void* fMapValues = nullptr;    // Mapped values, bitmap or offsets.
+      const char* fMapChars = nullptr;     // Mapped kString arena.
+      bool fOnlyNulls = true;              // Only null values appended so far.
+
+      // Data pointers (mapped or owned).
+
+      const long* longs() const {
+	return fMapValues ? static_cast<const long*>(fMapValues) : fLong.data();}
+      const double* doubles() const {
+	return fMapValues ? static_cast<const double*>(fMapValues) : fDouble.data();}
+      const std::uint64_t* bits() const {
+	return fMapValues ? static_cast<const std::uint64_t*>(fMapValues) : fBits.data();}
+      const std::uint64_t* offsets() const {
+	return fMapValues ? static_cast<const std::uint64_t*>(fMapValues) : fOffsets.data();}
+      const char* chars() const {return fMapValues ? fMapChars : fChars.data();}
+      bool bit(size_t row) const {return (bits()[row >> 6] >> (row & 63)) & 1;}
+    };
+
+    // Initialize empty columns from column types.
+
+    void makeColumns(size_t nrows_hint);
+
+    // Check that the first column contains channels.
+
+    void checkFirstColumn(size_t nrows) const;
+
+    // Fill columns from rows of text fields (optionally in parallel).
+
+    template<class GetFields>
+    void fillRows(size_t nrows, const GetFields& getFields, size_t parallel_rows);
+
+    // Set IOV and column schema from the header lines of a text response.
+
+    void parseHeader(const std::string_view* lines);
+
+    // Append one row of text fields (missing fields are empty).
+
+    void appendFields(const std::vector<std::string_view>& fields);
+
+    // Change storage kind of a column being filled.
+
+    void promote(size_t col, ColumnKind kind);
+
+    // Append boolean value.
+
+    void appendBool(Column& column, bool value);
+
+    // Throw exception for wrong type access.
+
+    [[noreturn]] void typeError(size_t col, const char* type) const;
+
     // Data members.
 
     IOVTimeStamp fBeginTime;               // IOV begin time.
@@ -145,8 +389,56 @@ namespace lariov
     std::vector<std::string> fColNames;    // Column names.
     std::vector<std::string> fColTypes;    // Column types.
     std::vector<DBChannelID_t> fChannels;  // Channels.
-    std::vector<value_type> fData;         // Calibration data (length nchan*ncols).
+    std::vector<Column> fColumns;          // Calibration data (length ncols).
+    std::shared_ptr<const void> fMapping;  // Mapped snapshot (if any).
   };
+
+  // Inline accessors.
+
+  inline long DBDataset::getLongData(size_t row, size_t col) const
+  {
+    const Column& column = fColumns[col];
+    if(column.fKind == kLong)
+      return column.longs()[row];
+    else if(column.fKind == kBool)
+      return column.bit(row);
+    typeError(col, "long");
+  }
+
+  inline double DBDataset::getDoubleData(size_t row, size_t col) const
+  {
+    const Column& column = fColumns[col];
+    if(column.fKind == kDouble)
+      return column.doubles()[row];
+    else if(column.fKind != kString)
+      return getLongData(row, col);
+    typeError(col, "double");
+  }
+
+  inline std::string_view DBDataset::getStringData(size_t row, size_t col) const
+  {
+    const Column& column = fColumns[col];
+    if(column.fKind != kString)
+      typeError(col, "text");
+    const std::uint64_t* offsets = column.offsets();
+    return std::string_view(column.chars() + offsets[row], offsets[row+1] - offsets[row]);
+  }
+
+  template<> inline DBDataset::ColumnView<long> DBDataset::getColumn<long>(size_t col) const
+  {
+    const Column& column = fColumns[col];
+    if(column.fKind != kLong)
+      typeError(col, "long column");
+    return ColumnView<long>(column.longs(), column.fSize);
+  }
+
+  template<> inline DBDataset::ColumnView<double> DBDataset::getColumn<double>(size_t col) const
+  {
+    const Column& column = fColumns[col];
+    if(column.fKind != kDouble)
+      typeError(col, "double column");
+    return ColumnView<double>(column.doubles(), column.fSize);
+  }
 }
 
 #endif
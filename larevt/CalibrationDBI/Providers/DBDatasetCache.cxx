@@ -0,0 +1,136 @@
+//=================================================================================
+//
+// Name: DBDatasetCache.cxx
+//
+// Purpose: Implementation for class DBDatasetCache.
+//
+//=================================================================================
+
+#include "DBDatasetCache.h"
+
+// Constructor.
+
+lariov::DBDatasetCache::DBDatasetCache(size_t max_datasets, size_t max_bytes) :
+  fMaxDatasets(max_datasets),
+  fMaxBytes(max_bytes),
+  fBytes(0),
+  fPinnedBytes(0)
+{}
+
+// Find the entry whose IOV contains the specified time.
+
+const lariov::DBDatasetCache::Entry* lariov::DBDatasetCache::lookup(const IOVTimeStamp& ts) const
+{
+  // Find the last dataset that begins at or before the requested time.
+
+  auto it = fEntries.upper_bound(ts);
+  if(it == fEntries.begin())
+    return nullptr;
+  --it;
+
+  // Check end time.
+
+  if(!(ts < it->second.fDataset->endTime()))
+    return nullptr;
+  return &it->second;
+}
+
+// Find the dataset whose IOV contains the specified time.
+
+lariov::DBDatasetCache::dataset_ptr lariov::DBDatasetCache::find(const IOVTimeStamp& ts)
+{
+  const Entry* entry = lookup(ts);
+  if(entry == nullptr)
+    return dataset_ptr();
+
+  // Mark as most recently used.
+
+  if(!entry->fPinned)
+    fLRU.splice(fLRU.begin(), fLRU, entry->fLRU);
+  return entry->fDataset;
+}
+
+// Check whether a dataset covering the specified time is cached.
+
+bool lariov::DBDatasetCache::contains(const IOVTimeStamp& ts) const
+{
+  return lookup(ts) != nullptr;
+}
+
+// Pinned datasets, in order of IOV begin time.
+
+std::vector<lariov::DBDatasetCache::dataset_ptr> lariov::DBDatasetCache::pinnedDatasets() const
+{
+  std::vector<dataset_ptr> result;
+  for(const auto& entry : fEntries) {
+    if(entry.second.fPinned)
+      result.push_back(entry.second.fDataset);
+  }
+  return result;
+}
+
+// Add a dataset.
+
+void lariov::DBDatasetCache::insert(const dataset_ptr& data, bool pin)
+{
+  if(!data)
+    return;
+
+  // Replace any existing dataset with the same begin time.
+
+  const IOVTimeStamp& begin = data->beginTime();
+  auto it = fEntries.find(begin);
+  if(it != fEntries.end()) {
+    fBytes -= it->second.fBytes;
+    if(it->second.fPinned) {
+      fPinnedBytes -= it->second.fBytes;
+      pin = true;
+    }
+    else
+      fLRU.erase(it->second.fLRU);
+    fEntries.erase(it);
+  }
+
+  Entry entry;
+  entry.fDataset = data;
+  entry.fBytes = data->memoryUsage();
+  entry.fPinned = pin;
+  if(pin) {
+    entry.fLRU = fLRU.end();
+    fPinnedBytes += entry.fBytes;
+  }
+  else {
+    fLRU.push_front(begin);
+    entry.fLRU = fLRU.begin();
+  }
+  fBytes += entry.fBytes;
+  fEntries.emplace(begin, entry);
+
+  evict();
+}
+
+// Remove all datasets.
+
+void lariov::DBDatasetCache::clear()
+{
+  fEntries.clear();
+  fLRU.clear();
+  fBytes = 0;
+  fPinnedBytes = 0;
+}
+
+// Evict least recently used datasets until limits are satisfied.
+// Always keep at least the most recently used dataset.  Pinned datasets are
+// not counted.
+
+void lariov::DBDatasetCache::evict()
+{
+  while(fLRU.size() > 1 &&
+	((fMaxDatasets > 0 && fLRU.size() > fMaxDatasets) ||
+	 (fMaxBytes > 0 && fBytes - fPinnedBytes > fMaxBytes))) {
+    auto it = fEntries.find(fLRU.back());
+    fBytes -= it->second.fBytes;
+    fEntries.erase(it);
+    fLRU.pop_back();
+  }
+}
@@ -0,0 +1,127 @@
+#ifndef DBDATASETCACHE_H
+#define DBDATASETCACHE_H
+//=================================================================================
+//
+// Name: DBDatasetCache.h
+//
+// Purpose: Header for class DBDatasetCache.
+//          This class holds a collection of DBDatasets belonging to a single
+//          database folder, keyed by IOV begin time.  It is used by DBFolder to
+//          avoid refetching datasets when jobs move back and forth across IOV
+//          boundaries.
+//
+//          Datasets are looked up by time stamp.  A lookup returns the dataset
+//          whose IOV interval [begin, end) contains the requested time.
+//
+//          The cache is limited both by the number of datasets and by an
+//          approximate memory budget.  When either limit is exceeded, the least
+//          recently used dataset is evicted.  The most recently used dataset is
+//          never evicted, even if it alone exceeds the memory budget.
+//
+//          Pinned datasets (e.g. preloaded ones) are never evicted, and do not
+//          count against the limits.
+//
+// Data members:
+//
+// fMaxDatasets - Maximum number of cached datasets (0 = unlimited).
+// fMaxBytes    - Maximum approximate memory used by cached datasets (0 = unlimited).
+// fBytes       - Current approximate memory used by cached datasets.
+// fPinnedBytes - Part of fBytes used by pinned datasets.
+// fEntries     - Cached datasets, keyed by IOV begin time.
+// fLRU         - IOV begin times of unpinned datasets, ordered from most to
+//                least recently used.
+//
+//=================================================================================
+
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+#include "larevt/CalibrationDBI/IOVData/IOVTimeStamp.h"
+#include "larevt/CalibrationDBI/Providers/DBDataset.h"
+
+namespace lariov
+{
+  class DBDatasetCache
+  {
+  public:
+
+    // Typedef
+
+    typedef std::shared_ptr<const DBDataset> dataset_ptr;
+
+    // Constructor.
+
+    DBDatasetCache(size_t max_datasets = 1, size_t max_bytes = 0);
+
+    // Configuration.
+
+    void setMaxDatasets(size_t n) {fMaxDatasets = n; evict();}
+    void setMaxBytes(size_t n) {fMaxBytes = n; evict();}
+    size_t maxDatasets() const {return fMaxDatasets;}
+    size_t maxBytes() const {return fMaxBytes;}
+
+    // Simple accessors.
+
+    size_t size() const {return fEntries.size();}
+    size_t bytes() const {return fBytes;}
+    size_t pinned() const {return fEntries.size() - fLRU.size();}
+    size_t pinnedBytes() const {return fPinnedBytes;}
+
+    // Find the dataset whose IOV contains the specified time.
+    // Return a null pointer if there is no such dataset.
+    // A successful lookup marks the dataset as most recently used.
+
+    dataset_ptr find(const IOVTimeStamp& ts);
+
+    // Check whether a dataset covering the specified time is cached
+    // (does not affect LRU order).
+
+    bool contains(const IOVTimeStamp& ts) const;
+
+    // Pinned datasets, in order of IOV begin time (does not affect LRU order).
+
+    std::vector<dataset_ptr> pinnedDatasets() const;
+
+    // Add a dataset (replaces any dataset with the same IOV begin time).
+    // The new dataset becomes the most recently used one, unless it is
+    // pinned.  A dataset that replaces a pinned one stays pinned.
+
+    void insert(const dataset_ptr& data, bool pin = false);
+
+    // Remove all datasets.
+
+    void clear();
+
+  private:
+
+    // Evict least recently used datasets until limits are satisfied.
+
+    void evict();
+
+    // Cache entry.
+
+    struct Entry
+    {
+      dataset_ptr fDataset;                     // Cached dataset.
+      size_t fBytes;                            // Approximate memory usage.
+      bool fPinned;                             // Never evicted.
+      std::list<IOVTimeStamp>::iterator fLRU;   // Position in LRU list (unpinned only).
+    };
+
+    // Find the entry whose IOV contains the specified time.
+
+    const Entry* lookup(const IOVTimeStamp& ts) const;
+
+    // Data members.
+
+    size_t fMaxDatasets;                        // Maximum number of datasets.
+    size_t fMaxBytes;                           // Memory budget.
+    size_t fBytes;                              // Current memory usage.
+    size_t fPinnedBytes;                        // Memory used by pinned datasets.
+    std::map<IOVTimeStamp, Entry> fEntries;     // Keyed by IOV begin time.
+    std::list<IOVTimeStamp> fLRU;               // Most recently used first.
+  };
+}
+
+#endif
@@ -0,0 +1,209 @@
+//=================================================================================
+//
+// Name: DBDiskCache.cxx
+//
+// Purpose: Implementation for class DBDiskCache.
+//
+//=================================================================================
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "DBDiskCache.h"
+#include "messagefacility/MessageLogger/MessageLogger.h"
+
+namespace {
+
+  // File name suffix.
+
+  const std::string kSUFFIX = ".dbcache";
+
+  // Serial number of temporary files, so that threads of one job storing the
+  // same dataset (e.g. prefetch and preload workers) never share one.
+
+  std::atomic<unsigned long> tmpSerial(0);
+
+  // Make directory and any missing parents.
+
+  bool makeDirectories(const std::string& dir)
+  {
+    size_t pos = 0;
+    while(pos != std::string::npos) {
+      pos = dir.find('/', pos+1);
+      std::string sub = dir.substr(0, pos);
+      if(sub.empty())
+	continue;
+      if(mkdir(sub.c_str(), 0775) != 0 && errno != EEXIST)
+	return false;
+    }
+    return true;
+  }
+}
+
+// Constructor.
+
+lariov::DBDiskCache::DBDiskCache(const std::string& dir, const std::string& folder,
+				 const std::string& tag) :
+  fFolder(folder),
+  fTag(tag),
+  fIndexLoaded(false)
+{
+  fDir = dir;
+  if(!fDir.empty() && fDir[fDir.length()-1] == '/')
+    fDir = fDir.substr(0, fDir.length()-1);
+  fDir += "/" + fFolder + "/" + (fTag.empty() ? std::string("_notag") : fTag);
+}
+
+// Load the index.  The IOV is encoded in the file name.
+
+void lariov::DBDiskCache::loadIndex() const
+{
+  if(fIndexLoaded)
+    return;
+  fIndexLoaded = true;
+
+  DIR* dir = opendir(fDir.c_str());
+  if(dir == nullptr)
+    return;
+  while(dirent* entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if(name.size() <= kSUFFIX.size() || name[0] == '.' ||
+       name.compare(name.size() - kSUFFIX.size(), kSUFFIX.size(), kSUFFIX) != 0)
+      continue;
+    size_t sep = name.find('_');
+    if(sep == std::string::npos)
+      continue;
+    try {
+      IOVTimeStamp begin = IOVTimeStamp::GetFromString(name.substr(0, sep));
+      IOVTimeStamp end = IOVTimeStamp::GetFromString(name.substr(sep+1, name.size() - kSUFFIX.size() - sep - 1));
+      fIndex.insert_or_assign(begin, std::make_pair(end, name));
+    }
+    catch(...) {
+
+      // Ignore files with unparseable names.
+
+      continue;
+    }
+  }
+  closedir(dir);
+}
+
+// Find and load the dataset whose IOV contains the specified time.
+
+std::shared_ptr<lariov::DBDataset> lariov::DBDiskCache::find(const IOVTimeStamp& ts) const
+{
+  std::shared_ptr<DBDataset> result;
+
+  // Look up the last IOV that begins at or before the requested time.
+
+  IOVTimeStamp begin = ts;
+  std::string match;
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    loadIndex();
+    auto i = fIndex.upper_bound(ts);
+    if(i == fIndex.begin())
+      return result;
+    --i;
+    if(!(ts < i->second.first))
+      return result;
+    begin = i->first;
+    match = i->second.second;
+  }
+
+  std::string path = fDir + "/" + match;
+  result = load(path);
+
+  // Check that file contents agree with the requested time.
+
+  if(result && !(ts >= result->beginTime() && ts < result->endTime())) {
+    mf::LogWarning("DBDiskCache") << "Ignoring inconsistent cache file " << path << "\n";
+    result.reset();
+  }
+
+  // Forget and remove invalid (or vanished) files, so that they can be
+  // replaced by freshly fetched data.
+
+  if(!result) {
+    std::remove(path.c_str());
+    std::lock_guard<std::mutex> lock(fMutex);
+    auto i = fIndex.find(begin);
+    if(i != fIndex.end() && i->second.second == match)
+      fIndex.erase(i);
+  }
+  return result;
+}
+
+// Load one cache file.
+// The file is mapped, not read, so that concurrent jobs share page cache.
+
+std::shared_ptr<lariov::DBDataset> lariov::DBDiskCache::load(const std::string& path) const
+{
+  std::shared_ptr<DBDataset> result = std::make_shared<DBDataset>();
+  std::string folder;
+  std::string tag;
+  if(!result->mapSnapshot(path, &folder, &tag) || folder != fFolder || tag != fTag) {
+    mf::LogWarning("DBDiskCache") << "Ignoring invalid cache file " << path << "\n";
+    result.reset();
+  }
+  return result;
+}
+
+// Store dataset.
+
+bool lariov::DBDiskCache::store(const DBDataset& data) const
+{
+  // Don't store open ended IOVs.
+
+  if(data.endTime() == IOVTimeStamp::MaxTimeStamp())
+    return false;
+
+  std::string name = data.beginTime().DBStamp() + "_" + data.endTime().DBStamp() + kSUFFIX;
+  std::string path = fDir + "/" + name;
+
+  // Don't overwrite existing files (another job may have stored the same dataset).
+
+  // Files found on disk are indexed as well.
+
+  struct stat st;
+  if(stat(path.c_str(), &st) == 0) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    loadIndex();
+    fIndex.insert_or_assign(data.beginTime(), std::make_pair(data.endTime(), name));
+    return false;
+  }
+
+  if(!makeDirectories(fDir)) {
+    mf::LogWarning("DBDiskCache") << "Unable to create cache directory " << fDir << "\n";
+    return false;
+  }
+
+  // Write temporary file, then rename.
+
+  std::string tmppath = fDir + "/." + name + ".tmp." + std::to_string(getpid()) + "." +
+    std::to_string(tmpSerial++);
+  {
+    std::ofstream out(tmppath, std::ios::binary | std::ios::trunc);
+    data.writeSnapshot(out, fFolder, fTag);
+    out.close();
+    if(!out) {
+      mf::LogWarning("DBDiskCache") << "Unable to write cache file " << tmppath << "\n";
+      std::remove(tmppath.c_str());
+      return false;
+    }
+  }
+  if(std::rename(tmppath.c_str(), path.c_str()) != 0) {
+    mf::LogWarning("DBDiskCache") << "Unable to rename cache file " << tmppath << "\n";
+    std::remove(tmppath.c_str());
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(fMutex);
+  loadIndex();
+  fIndex.insert_or_assign(data.beginTime(), std::make_pair(data.endTime(), name));
+  return true;
+}
@@ -0,0 +1,98 @@
+#ifndef DBDISKCACHE_H
+#define DBDISKCACHE_H
+//=================================================================================
+//
+// Name: DBDiskCache.h
+//
+// Purpose: Header for class DBDiskCache.
+//          This class implements a persistent, node-local cache of parsed
+//          DBDatasets for one database folder and tag.  It lets jobs running on
+//          the same worker node reuse datasets fetched by earlier jobs instead of
+//          asking the conditions database server again.
+//
+//          Datasets are stored one per file in directory
+//
+//            <cache dir>/<folder>/<tag>/<begin>_<end>.dbcache
+//
+//          where <begin> and <end> are the database time stamps of the IOV.
+//          Each file is a DBDataset snapshot (see DBDataset.h), which records
+//          the folder and tag.  Files are memory mapped when loaded.
+//
+//          Files are written to a temporary name and then renamed, so readers
+//          never see partially written files.  Files that fail any validity check
+//          are ignored (the caller then falls back to the server).
+//
+//          Datasets with an open ended IOV are never stored, because the IOV
+//          may be closed by a later database update.
+//
+//          The IOVs of the cache files are indexed in memory.  The index is loaded
+//          from the directory at the first lookup and then updated by store, so
+//          lookups do not scan the directory.  Files written by other jobs after
+//          the index is loaded are not seen.
+//
+//          All errors are non-fatal.  A cache that can not be read or written
+//          simply behaves as if it were empty.
+//
+// Data members:
+//
+// fDir    - Directory containing cache files for this folder and tag.
+// fFolder - Folder name.
+// fTag    - Tag.
+// fIndex  - Cache file names (and IOV end times), indexed by IOV begin time.
+//
+//=================================================================================
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include "larevt/CalibrationDBI/IOVData/IOVTimeStamp.h"
+#include "larevt/CalibrationDBI/Providers/DBDataset.h"
+
+namespace lariov
+{
+  class DBDiskCache
+  {
+  public:
+
+    // Constructor.
+
+    DBDiskCache(const std::string& dir, const std::string& folder, const std::string& tag);
+
+    // Simple accessors.
+
+    const std::string& directory() const {return fDir;}
+
+    // Find and load the dataset whose IOV contains the specified time.
+    // Return a null pointer if there is no valid cached dataset.
+
+    std::shared_ptr<DBDataset> find(const IOVTimeStamp& ts) const;
+
+    // Store dataset.  Return true if dataset was stored.
+
+    bool store(const DBDataset& data) const;
+
+  private:
+
+    // Load one cache file.
+
+    std::shared_ptr<DBDataset> load(const std::string& path) const;
+
+    // Load the index from the cache directory, if not done yet.
+    // Caller must hold fMutex.
+
+    void loadIndex() const;
+
+    // Data members.
+
+    std::string fDir;      // Cache directory for this folder and tag.
+    std::string fFolder;   // Folder name.
+    std::string fTag;      // Tag.
+    mutable std::mutex fMutex;   // Protects the index.
+    mutable bool fIndexLoaded;
+    mutable std::map<IOVTimeStamp, std::pair<IOVTimeStamp, std::string> > fIndex;
+  };
+}
+
+#endif
@@ -1,12 +1,23 @@
 #include "DBFolder.h"
+#include "DBFolderCoordinator.h"
+#include "DBFolderStats.h"
 #include "WebDBIConstants.h"
 #include "larevt/CalibrationDBI/IOVData/TimeStampDecoder.h"
 #include "WebError.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <unordered_set>
 #include <stdlib.h>
 #include <cstring>
 #include "wda.h"
+#include "curl/curl.h"
 #include "sqlite3.h"
 #include "cetlib_except/exception.h"
 #include "cetlib/search_path.h"
@@ -14,10 +25,26 @@
 
 namespace lariov {
 
+  // Hedged request threads of one folder, shared by the folder and the
+  // (detached) threads, which may outlive it.
+
+  struct DBFolder::HedgeControl
+  {
+    std::mutex fMutex;                     // Protects fFolder.
+    const DBFolder* fFolder = nullptr;     // Null once the folder is destroyed.
+    std::atomic<bool> fCancel{false};      // Abort compressed transfers.
+    std::atomic<unsigned int> fRunning{0}; // Requests in flight.
+  };
+
   // Constructor.
 
   DBFolder::DBFolder(const std::string& name, const std::string& url, const std::string& url2,
-		     const std::string& tag, bool usesqlite, bool testmode)
+		     const std::string& tag, bool usesqlite, bool testmode) :
+    fSQLiteDB(nullptr),
+    fIOVStmt(nullptr),
+    fDataStmt(nullptr),
+    fCountStmt(nullptr),
+    fPrefetchTime(IOVTimeStamp::MaxTimeStamp())
   {
     fFolderName = name;
     fURL = url;
@@ -25,14 +52,33 @@ namespace lariov {
     fTag = tag;
     fUseSQLite = usesqlite;
     fTestMode = testmode;
-    if (fURL[fURL.length()-1] == '/') {
+    if (!fURL.empty() && fURL[fURL.length()-1] == '/') {
       fURL = fURL.substr(0, fURL.length()-1);
     }
 
+    fCache = std::make_shared<DBDataset>();
     fCachedRowNumber = -1;
     fCachedChannel = 0;
 
     fMaximumTimeout = 4*60; //4 minutes
+    fParallelParseRows = 0;
+    fCompressed = false;
+    fDeltaUpdates = false;
+    fUseTimeline = false;
+    fTimelineLoaded = false;
+
+    fStats = DBFolderStats::create(fFolderName, fTag);
+    fPrefetch = false;
+    fCoordinated = false;
+    fHedge = false;
+    fHedgePercentile = 0.95;
+    fHedgeMinDelay = 0.;
+    fBreakerFailures = 3;
+    fBreakerCooldown = 60.;
+    fBreakerCount[0] = fBreakerCount[1] = 0;
+    fHedgeControl = std::make_shared<HedgeControl>();
+    fHedgeControl->fFolder = this;
+    fUsed = false;
 
     // If UsqSQLite is true, hunt for sqlite database file.
     // It is an error if this file can't be found.
@@ -42,6 +88,7 @@ namespace lariov {
       std::string dbname = fFolderName + ".db";
       cet::search_path sp("FW_SEARCH_PATH");
       fSQLitePath = sp.find_file(dbname);   // Throws exception if not found.
+      OpenSQLite();
       //mf::LogInfo("DBFolder") << "DBFolder: SQLite database path = " << fSQLitePath << "\n";
     }
     //else
@@ -63,7 +110,62 @@ namespace lariov {
 
   // Destructor.
 
-  DBFolder::~DBFolder() {}
+  DBFolder::~DBFolder() {
+
+    // Make sure that the prefetch thread is done with the database before closing it.
+
+    SetCoordinatedFetch(false);
+    if(fPrefetchResult.valid())
+      fPrefetchResult.wait();
+
+    // Cancel hedged requests that are still running, and detach them from this
+    // folder.  They end on their own (see StartHedgeRequest).
+
+    fHedgeControl->fCancel = true;
+    {
+      std::lock_guard<std::mutex> lock(fHedgeControl->fMutex);
+      fHedgeControl->fFolder = nullptr;
+    }
+    CloseSQLite();
+  }
+
+  // Enable the persistent on-disk dataset cache (empty directory disables it).
+
+  void DBFolder::SetDiskCacheDir(const std::string& dir) {
+    if(dir.empty())
+      fDiskCache.reset();
+    else
+      fDiskCache = std::make_unique<DBDiskCache>(dir, fFolderName, fTag);
+  }
+
+  // Use a conditions bundle (empty path disables it).
+
+  void DBFolder::SetBundle(const std::string& path) {
+    if(path.empty()) {
+      fBundle.reset();
+      return;
+    }
+    fBundle = DBBundle::open(path);
+    if(!fBundle->contains(fFolderName, fTag)) {
+      if(fSQLitePath == "" && fURL == "")
+	throw cet::exception("DBFolder") << "Conditions bundle " << path << " has no data for folder "
+					 << fFolderName << ", tag " << fTag;
+      mf::LogWarning("DBFolder") << "Conditions bundle " << path << " has no data for folder "
+				 << fFolderName << ", tag " << fTag << "\n";
+    }
+  }
+
+  // Enable the node-wide shared memory dataset cache (zero capacity disables it).
+  // Datasets from different sources (server or sqlite file) are kept apart.
+
+  void DBFolder::SetSharedCache(size_t capacity, size_t max_bytes, unsigned int open_lifetime) {
+    if(capacity == 0)
+      fSharedCache.reset();
+    else
+      fSharedCache = std::make_unique<DBSharedCache>(fFolderName, fTag,
+						     fSQLitePath != "" ? fSQLitePath : fURL,
+						     capacity, max_bytes, open_lifetime);
+  }
 
   // Data accessors.
 
@@ -199,7 +301,7 @@ namespace lariov {
 
   int DBFolder::GetChannelList( std::vector<DBChannelID_t>& channels ) const {
 
-    channels = fCache.channels();
+    channels = fCache->channels();
     return 0;
   }
 
@@ -207,6 +309,8 @@ namespace lariov {
 
   void DBFolder::GetRow(DBChannelID_t channel) {
 
+    fStats->addLookup();
+
     // Check if we need to update the cached row.
 
     if (fCachedChannel != channel ||
@@ -215,7 +319,7 @@ namespace lariov {
 
       // Update cached row number (binary serach).
 
-      int row = fCache.getRowNumber(channel);
+      int row = fCache->getRowNumber(channel);
 
       //  Throw an exception if we didn't find a matching role.
 
@@ -228,7 +332,7 @@ namespace lariov {
 
       fCachedRowNumber = row;
       fCachedChannel = channel;
-      fCachedRow = fCache.getRow(row);
+      fCachedRow = fCache->getRow(row);
     }
   }
 
@@ -236,7 +340,7 @@ namespace lariov {
 
   size_t DBFolder::GetColumn(const std::string& name) const
   {
-    int col = fCache.getColNumber(name);
+    int col = fCache->getColNumber(name);
 
     // See if we found a matching column.
 
@@ -258,44 +362,38 @@ namespace lariov {
 
     //check if cache is updated
     if (IsValid(ts)) return false;
+    fUsed = true;
 
-    //release cached data.
-    fCache = DBDataset();
+    //release cached row.
     fCachedRow = DBDataset::DBRow();
     fCachedRowNumber = -1;
     fCachedChannel = 0;
 
-    //get full url string
-    std::stringstream fullurl;
-    fullurl << fURL << "/data?f=" << fFolderName
-            << "&t=" << ts.DBStamp();
-    if (fTag.length() > 0) fullurl << "&tag=" << fTag;
-
-    //mf::LogInfo log("DBFolder")
-    //log << "In DBFolder::UpdateData" << "\n";
-    //log << "t=" << raw_time/1000000000 << "\n";
-    //log << "Full url = " << fullurl.str() << "\n";
+    //collect any prefetched dataset.
+    //wait for it if we are moving forward into the prefetched interval.
+    CollectPrefetch(ts >= fPrefetchTime);
+
+    //check if a recently used dataset covers this time.
+    DBDatasetCache::dataset_ptr cached = fDatasetCache.find(ts);
+    if (cached) {
+      if (fDeltaUpdates) fPrevious = fCache;
+      fCache = cached;
+      fStats->addIOVSwitch(true);
+      StartPrefetch();
+      return true;
+    }
 
     //get new dataset
-    if(fSQLitePath != "" && !fTestMode) {
-      GetSQLiteData(raw_time/1000000000, fCache);
-    }
-    else {
-      if(fTestMode) {
-	mf::LogInfo log("DBFolder");
-	log << "Accessing primary calibration data from http conditions database server." << "\n";
-	log << "Folder = " << fFolderName << "\n";
-      }
-      int err = 0;
-      Dataset data = getDataWithTimeout(fullurl.str().c_str(), NULL, fMaximumTimeout, &err);
-      int status = getHTTPstatus(data);
-      if (status != 200) {
-	std::string msg = "HTTP error from " + fullurl.str()+": status: " + std::to_string(status) + ": " + std::string(getHTTPmessage(data));
-	throw WebError(msg);
-      }
-      fCache = DBDataset(data, true);
+    std::shared_ptr<DBDataset> dataset;
+    if(fTestMode) {
+      mf::LogInfo log("DBFolder");
+      log << "Accessing primary calibration data from http conditions database server." << "\n";
+      log << "Folder = " << fFolderName << "\n";
+      dataset = GetHTTPData(fURL, ts);
     }
-    //DumpDataset(fCache);
+    else
+      dataset = FetchDataset(ts);
+    //DumpDataset(*dataset);
 
 
     // If test mode is selected, get comparison data.
@@ -304,384 +402,1222 @@ namespace lariov {
       if(fSQLitePath != "") {
 	DBDataset compare1;
 	mf::LogInfo("DBFolder") << "Accessing comparison data from sqlite database " << fSQLitePath << "\n";
-	GetSQLiteData(raw_time/1000000000, compare1);
-	CompareDataset(fCache, compare1);
+	GetSQLiteData(ts.Stamp(), compare1);
+	CompareDataset(*dataset, compare1);
       }
       if(fURL2 != "") {
 	mf::LogInfo("DBFolder") <<"Accessing comparison data from second database url." << "\n";
-	std::stringstream fullurl2;
-	fullurl2 << fURL2 << "/data?f=" << fFolderName
-		 << "&t=" << ts.DBStamp();
-	if (fTag.length() > 0) fullurl2 << "&tag=" << fTag;
-	mf::LogInfo("DBFolder") << "Full url = " << fullurl2.str() << "\n";
-	int err = 0;
-	Dataset data = getDataWithTimeout(fullurl2.str().c_str(), NULL, fMaximumTimeout, &err);
-	int status = getHTTPstatus(data);
-	if (status != 200) {
-	  std::string msg = "HTTP error from " + fullurl2.str()+": status: " + std::to_string(status) + ": " + std::string(getHTTPmessage(data));
-	  throw WebError(msg);
-	}
-	DBDataset compare2(data, true);
-	CompareDataset(fCache, compare2);
+	std::shared_ptr<DBDataset> compare2 = GetHTTPData(fURL2, ts);
+	CompareDataset(*dataset, *compare2);
       }
     }
+
+    //make new dataset current and remember it.
+    if (fDeltaUpdates) fPrevious = fCache;
+    fCache = dataset;
+    fDatasetCache.insert(fCache);
+    fStats->addIOVSwitch(false);
+    StartPrefetch();
     return true;
   }
 
-  // Query data from sqlite database.
-  // The return value of type Dataset (aka void*), is partially opaque type HttpResponse*
-  // (defined in wda.c and copied above).
+  // Keep the previous dataset at IOV changes (or stop keeping it).
 
-  void DBFolder::GetSQLiteData(int t, DBDataset& data) const
-  {
-    if(fSQLitePath == "")
-      return;
+  void DBFolder::SetDeltaUpdates(bool delta) {
+    fDeltaUpdates = delta;
+    if (!delta) fPrevious.reset();
+  }
 
-    // DBDataset data to be filled.
+  // Compare the current dataset with the previous one, channel by channel.
+  // Both datasets are ordered by channel.
+
+  bool DBFolder::GetChangedRows(std::vector<size_t>& rows, std::vector<DBChannelID_t>& removed) const {
+
+    rows.clear();
+    removed.clear();
+    if (!fPrevious || !fCache->sameColumns(*fPrevious)) return false;
+
+    const std::vector<DBChannelID_t>& channels = fCache->channels();
+    const std::vector<DBChannelID_t>& previous = fPrevious->channels();
+    size_t row = 0;
+    size_t prev = 0;
+    while (row < channels.size() || prev < previous.size()) {
+      if (prev == previous.size() || (row < channels.size() && channels[row] < previous[prev]))
+	rows.push_back(row++);
+      else if (row == channels.size() || previous[prev] < channels[row])
+	removed.push_back(previous[prev++]);
+      else {
+	if (fCache.get() != fPrevious.get() && !fCache->sameRow(row, *fPrevious, prev))
+	  rows.push_back(row);
+	++row;
+	++prev;
+      }
+    }
+    return true;
+  }
 
-    IOVTimeStamp begin_ts(0, 0);                // IOV begin time.
-    IOVTimeStamp end_ts(0, 0);                  // IOV end time.
-    std::vector<std::string> column_names;      // Column names.
-    std::vector<std::string> column_types;      // Column types.
-    std::vector<DBChannelID_t> channels;        // Channels.
-    std::vector<DBDataset::value_type> values;  // Calibration data (length nchan*ncols).
+  // Get the dataset valid at the specified time from the conditions bundle,
+  // the on-disk cache, the sqlite database, or the conditions database server.
+  // This function does not modify the folder, so it may be called from
+  // the prefetch thread.
 
-    //mf::LogInfo log("DBFolder")
-    //log << "DBFolder::GetSQLiteData" << "\n";
-    //log << "t=" << t << "\n";
-    //log << "sqlite path = " << fSQLitePath << "\n";
+  std::shared_ptr<DBDataset> DBFolder::FetchDataset(const IOVTimeStamp& ts) const {
 
-    // Open sqlite database.
+    // Datasets in the bundle are used in place.  Times not covered by the
+    // bundle are an error if there is no other source.
 
-    //mf::LogInfo("DBFolder") << "Opening sqlite database " << fSQLitePath << "\n";
-    sqlite3* db;
-    int rc = sqlite3_open(fSQLitePath.c_str(), &db);
-    if(rc != SQLITE_OK) {
-      mf::LogError("DBFolder") << "Failed to open sqlite database " << fSQLitePath << "\n";
-      throw cet::exception("DBFolder") << "Failed to open sqlite database " << fSQLitePath;
+    std::shared_ptr<DBDataset> dataset;
+    if(fBundle) {
+      dataset = fBundle->find(fFolderName, fTag, ts);
+      if(dataset) {
+	fStats->addBundleHit();
+	return dataset;
+      }
+      if(fSQLitePath == "" && fURL == "") {
+	fStats->addFetchError();
+	throw cet::exception("DBFolder") << "Conditions bundle " << fBundle->path() << " has no data for folder "
+					 << fFolderName << ", tag " << fTag << " at " << ts.DBStamp();
+      }
     }
 
-    // Query begin time of IOV.
+    // Datasets published by other jobs on this node are used in place.
 
-    std::string table_iovs = fFolderName + "_iovs";
-    std::string table_tag_iovs = fFolderName + "_tag_iovs";
-    std::ostringstream sql;
-    sql << "SELECT " << table_iovs << ".iov_id," << table_iovs << ".begin_time"
-	<< " FROM " << table_tag_iovs << "," << table_iovs
-	<< " WHERE " << table_tag_iovs << ".tag='" << fTag << "'"
-	<< " AND " << table_tag_iovs << ".iov_id=" << table_iovs << ".iov_id"
-	<< " AND " << table_iovs << ".begin_time <= " << t
-	<< " ORDER BY " << table_iovs << ".begin_time desc";
-    //mf::LogInfo("DBFolder") << "sql = " << sql.str() << "\n";
+    if(fSharedCache) {
+      dataset = fSharedCache->find(ts);
+      if(dataset) {
+	fStats->addSharedHit();
+	return dataset;
+      }
+    }
+
+    if(fSQLitePath != "") {
+      dataset = std::make_shared<DBDataset>();
+      auto start = DBFolderStats::clock_type::now();
+      try {
+	GetSQLiteData(ts.Stamp(), *dataset);
+      }
+      catch(...) {
+	fStats->addFetchError();
+	throw;
+      }
+      fStats->addFetch(DBFolderStats::since(start), 0., 0, dataset->memoryUsage());
+    }
+    else {
 
-    // Prepare query.
+      //check the on-disk cache before asking the server.
+      if(fDiskCache) {
+	dataset = fDiskCache->find(ts);
+	if(dataset)
+	  fStats->addDiskHit();
+      }
 
-    sqlite3_stmt* stmt;
-    rc = sqlite3_prepare_v2(db, sql.str().c_str(), -1, &stmt, 0);
-    if(rc != SQLITE_OK) {
-      mf::LogError log("DBFolder");
-      log << "sqlite3_prepare_v2 failed." << fSQLitePath << "\n";
-      log << "Failed sql = " << sql.str() << "\n";
-      throw cet::exception("DBFolder") << "sqlite3_prepare_v2 error.";
+      // Ask for the begin time of a closed IOV, so that all times in the IOV
+      // make the same request.  The open ended IOV may have been closed since
+      // the timeline was loaded, so that one is asked for the requested time.
+
+      if(!dataset) {
+	IOVTimeStamp begin = ts;
+	IOVTimeStamp end = IOVTimeStamp::MaxTimeStamp();
+	const DBTimeline* timeline = Timeline();
+	if(timeline && timeline->find(ts, begin, end) && end == IOVTimeStamp::MaxTimeStamp())
+	  begin = ts;
+	dataset = GetHedgedHTTPData(begin);
+	if(fDiskCache)
+	  fDiskCache->store(*dataset);
+      }
     }
 
-    // Execute query.
-    // Just retrieve first row.
-    // It is an error if we don't get at least one row.
+    // Publish, and use the shared copy, so that this job does not hold a
+    // private one.
 
-    rc = sqlite3_step(stmt);
-    //int iov_id = 0;
-    int begin_time = 0;
-    if(rc == SQLITE_ROW) {
-      //iov_id = sqlite3_column_int(stmt, 0);
-      begin_time = sqlite3_column_int(stmt, 1);
-      //mf::LogInfo log("DBFolder")
-      //log << "iov_id = " << iov_id << "\n";
-      //log << "begin_time = " << begin_time << "\n";
+    if(fSharedCache) {
+      std::shared_ptr<DBDataset> shared = fSharedCache->store(*dataset);
+      if(shared)
+	dataset = shared;
     }
-    else {
-      mf::LogError("DBFolder") << "sqlite3_step returned error result = " << rc << "\n";
-      throw cet::exception("DBFolder") << "sqlite3_step error.";
+    return dataset;
+  }
+
+  namespace {
+
+    // Receiver of the (decoded) body of a libcurl transfer.
+
+    struct BodySink
+    {
+      CURL* fCurl;
+      const std::function<void(std::string_view)>* fConsume;  // Gets bodies of successful responses.
+      long fStatus = 0;                  // HTTP status (0 = not known yet).
+      std::string fError;                // Body of an unsuccessful response.
+      std::exception_ptr fException;     // Thrown by fConsume.
+    };
+
+    // Pass the body of a successful response on, as it arrives.  An exception
+    // from the consumer aborts the transfer.
+
+    size_t ReceiveBody(char* ptr, size_t size, size_t nmemb, void* userdata)
+    {
+      BodySink& sink = *static_cast<BodySink*>(userdata);
+      size_t n = size * nmemb;
+      if(sink.fStatus == 0)
+	curl_easy_getinfo(sink.fCurl, CURLINFO_RESPONSE_CODE, &sink.fStatus);
+      if(sink.fStatus != 200) {
+	sink.fError.append(ptr, n);
+	return n;
+      }
+      try {
+	(*sink.fConsume)(std::string_view(ptr, n));
+      }
+      catch(...) {
+	sink.fException = std::current_exception();
+	return 0;
+      }
+      return n;
     }
 
-    // Delete query.
+    // Abort a libcurl transfer when the cancel flag is set.
 
-    sqlite3_finalize(stmt);
+    int CheckCancel(void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+    {
+      return static_cast<const std::atomic<bool>*>(clientp)->load();
+    }
 
-    // Query end time of IOV.
+    // Fetch the body of one http request with libcurl, accepting any content
+    // encoding supported by libcurl (gzip, deflate).  The response is decoded
+    // as it arrives, and passed to consume piece by piece.  Returns the number
+    // of bytes received.  Throws WebError, or the exception thrown by consume.
+    // The transfer is aborted (with WebError) if *cancel becomes true.
+
+    curl_off_t FetchBody(const std::string& fullurl, int timeout,
+			 const std::function<void(std::string_view)>& consume,
+			 const std::atomic<bool>* cancel = nullptr)
+    {
+      static std::once_flag init;
+      std::call_once(init, [] {curl_global_init(CURL_GLOBAL_ALL);});
+
+      std::unique_ptr<CURL, void(*)(CURL*)> curl(curl_easy_init(), curl_easy_cleanup);
+      if(!curl)
+	throw WebError("HTTP error from " + fullurl + ": can not initialize libcurl");
+      char errbuf[CURL_ERROR_SIZE] = "";
+      curl_easy_setopt(curl.get(), CURLOPT_URL, fullurl.c_str());
+      curl_easy_setopt(curl.get(), CURLOPT_ACCEPT_ENCODING, "");
+      curl_easy_setopt(curl.get(), CURLOPT_FOLLOWLOCATION, 1L);
+      curl_easy_setopt(curl.get(), CURLOPT_NOSIGNAL, 1L);
+      curl_easy_setopt(curl.get(), CURLOPT_TIMEOUT, long(timeout));
+      curl_easy_setopt(curl.get(), CURLOPT_ERRORBUFFER, errbuf);
+      BodySink sink;
+      sink.fCurl = curl.get();
+      sink.fConsume = &consume;
+      curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, ReceiveBody);
+      curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &sink);
+      if(cancel) {
+	curl_easy_setopt(curl.get(), CURLOPT_NOPROGRESS, 0L);
+	curl_easy_setopt(curl.get(), CURLOPT_XFERINFOFUNCTION, CheckCancel);
+	curl_easy_setopt(curl.get(), CURLOPT_XFERINFODATA, const_cast<std::atomic<bool>*>(cancel));
+      }
+      CURLcode res = curl_easy_perform(curl.get());
+      if(sink.fException)
+	std::rethrow_exception(sink.fException);
+      if(res != CURLE_OK)
+	throw WebError("HTTP error from " + fullurl + ": "
+		       + (errbuf[0] ? std::string(errbuf) : std::string(curl_easy_strerror(res))));
+      long status = 0;
+      curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &status);
+      if(status != 200)
+	throw WebError("HTTP error from " + fullurl + ": status: " + std::to_string(status)
+		       + ": " + sink.fError.substr(0, sink.fError.find('\n')));
+
+      curl_off_t bytes = 0;
+      curl_easy_getinfo(curl.get(), CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+      return bytes;
+    }
 
-    sql.str("");
-    sql << "SELECT " << table_iovs << ".begin_time"
-	<< " FROM " << table_tag_iovs << "," << table_iovs
-	<< " WHERE " << table_tag_iovs << ".tag='" << fTag << "'"
-	<< " AND " << table_tag_iovs << ".iov_id=" << table_iovs << ".iov_id"
-	<< " AND " << table_iovs << ".begin_time > " << t
-	<< " ORDER BY " << table_iovs << ".begin_time";
-    //mf::LogInfo("DBFolder") << "sql = " << sql.str() << "\n";
+    // Fetch one http request with libcurl, accepting compressed responses.
+    // The text body is converted while it arrives (DBDataset::TextParser).
+    // The fetch time excludes the conversion time.
+
+    std::shared_ptr<DBDataset> FetchCompressedHTTP(const std::string& fullurl, int timeout,
+						   DBFolderStats& stats, const std::atomic<bool>* cancel)
+    {
+      auto dataset = std::make_shared<DBDataset>();
+      DBDataset::TextParser parser(*dataset);
+      double parse_time = 0.;
+      auto start = DBFolderStats::clock_type::now();
+      curl_off_t bytes = FetchBody(fullurl, timeout, [&parser, &parse_time](std::string_view data) {
+	  auto parse_start = DBFolderStats::clock_type::now();
+	  parser.feed(data);
+	  parse_time += DBFolderStats::since(parse_start);
+	}, cancel);
+      auto parse_start = DBFolderStats::clock_type::now();
+      parser.finish();
+      parse_time += DBFolderStats::since(parse_start);
+      stats.addFetch(DBFolderStats::since(start) - parse_time, parse_time, bytes, dataset->memoryUsage());
+      return dataset;
+    }
 
-    // Prepare query.
+    // Fetch and convert one http request with libwda.
 
-    rc = sqlite3_prepare_v2(db, sql.str().c_str(), -1, &stmt, 0);
-    if(rc != SQLITE_OK) {
-      mf::LogError log("DBFolder");
-      log << "sqlite3_prepare_v2 failed." << fSQLitePath << "\n";
-      log << "Failed sql = " << sql.str() << "\n";
-      throw cet::exception("DBFolder") << "sqlite3_prepare_v2 error.";
+    std::shared_ptr<DBDataset> FetchWDAHTTP(const std::string& fullurl, int timeout, size_t parallel_rows,
+					    DBFolderStats& stats)
+    {
+      int err = 0;
+      auto start = DBFolderStats::clock_type::now();
+      Dataset data = getDataWithTimeout(fullurl.c_str(), NULL, timeout, &err);
+      double fetch_time = DBFolderStats::since(start);
+      int status = getHTTPstatus(data);
+      if (status != 200) {
+	std::string msg = "HTTP error from " + fullurl+": status: " + std::to_string(status) + ": " + std::string(getHTTPmessage(data));
+	releaseDataset(data);
+	throw WebError(msg);
+      }
+      start = DBFolderStats::clock_type::now();
+      auto dataset = std::make_shared<DBDataset>(data, true, parallel_rows);
+      stats.addFetch(fetch_time, DBFolderStats::since(start), 0, dataset->memoryUsage());
+      return dataset;
+    }
+
+    // Fetch and convert one http request.  Throws WebError.
+    // Compressed transfers are aborted if *cancel becomes true.
+
+    std::shared_ptr<DBDataset> FetchHTTP(const std::string& fullurl, int timeout, size_t parallel_rows,
+					 bool compressed, DBFolderStats& stats,
+					 const std::atomic<bool>* cancel = nullptr)
+    {
+      try {
+	if(compressed)
+	  return FetchCompressedHTTP(fullurl, timeout, stats, cancel);
+	else
+	  return FetchWDAHTTP(fullurl, timeout, parallel_rows, stats);
+      }
+      catch(...) {
+	stats.addFetchError();
+	throw;
+      }
     }
+  }
+
+  // Outcome of one hedged request race, shared with the request threads.
+
+  struct DBFolder::HedgeState
+  {
+    std::mutex fMutex;
+    std::condition_variable fDone;
+    bool fFinished[2] = {false, false};
+    std::shared_ptr<DBDataset> fResult[2];
+    std::exception_ptr fError[2];
+  };
+
+  // Send one request to endpoint i in a detached thread.
+  // The outcome is recorded for the circuit breaker (and latency statistics)
+  // before the waiting thread is notified, whether or not the request is
+  // still awaited by then.  The thread uses only shared data and copies of
+  // the folder configuration, so that the folder does not have to wait for
+  // it.  Requests that end after the folder is destroyed are not recorded.
+
+  void DBFolder::StartHedgeRequest(const std::shared_ptr<HedgeState>& state, int i,
+				   const std::string& fullurl) const {
+    std::shared_ptr<HedgeControl> control = fHedgeControl;
+    std::shared_ptr<DBFolderStats> stats = fStats;
+    int timeout = fMaximumTimeout;
+    size_t parallel_rows = fParallelParseRows;
+    bool compressed = fCompressed;
+    ++control->fRunning;
+    std::thread([control, stats, state, i, fullurl, timeout, parallel_rows, compressed] {
+	auto start = std::chrono::steady_clock::now();
+	std::shared_ptr<DBDataset> result;
+	std::exception_ptr error;
+	try {
+	  result = FetchHTTP(fullurl, timeout, parallel_rows, compressed, *stats, &control->fCancel);
+	}
+	catch(...) {
+	  error = std::current_exception();
+	}
+	{
+	  std::lock_guard<std::mutex> clock(control->fMutex);
+	  if(control->fFolder)
+	    control->fFolder->RecordHedgeOutcome(i, bool(result),
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	{
+	  std::lock_guard<std::mutex> slock(state->fMutex);
+	  state->fFinished[i] = true;
+	  state->fResult[i] = result;
+	  state->fError[i] = error;
+	  state->fDone.notify_all();
+	}
+	--control->fRunning;
+      }).detach();
+  }
 
-    // Execute query.
-    // Just retrieve first row.
-    // If we don't get any rows, then end time is infinite.
+  // Get the timeline, loading it the first time.
+  // Once loaded (or failed), the timeline does not change, so the returned
+  // pointer may be used without locking.
+
+  const DBTimeline* DBFolder::Timeline() const {
+
+    if(!fUseTimeline || fTestMode)
+      return nullptr;
+
+    std::lock_guard<std::mutex> lock(fTimelineMutex);
+    if(!fTimelineLoaded) {
+      fTimelineLoaded = true;
+      std::vector<DBTimeline::Entry> entries;
+      try {
+	if(fSQLitePath != "")
+	  LoadSQLiteTimeline(entries);
+	else if(fBundle && fURL == "") {
+	  for(const IOVTimeStamp& begin : fBundle->beginTimes(fFolderName, fTag))
+	    entries.emplace_back(begin);
+	}
+	else {
+	  try {
+	    LoadHTTPTimeline(fURL, entries);
+	  }
+	  catch(WebError&) {
+	    if(fURL2 == "")
+	      throw;
+	    entries.clear();
+	    LoadHTTPTimeline(fURL2, entries);
+	  }
+	}
+	if(entries.empty())
+	  throw cet::exception("DBFolder") << "No IOVs for tag " << fTag;
+	fTimeline.assign(std::move(entries));
+      }
+      catch(std::exception& e) {
 
-    rc = sqlite3_step(stmt);
-    int end_time = 0;
-    if(rc == SQLITE_ROW) {
-      end_time = sqlite3_column_int(stmt, 0);
-      //mf::LogInfo("DBFolder") << "end_time = " << end_time << "\n";
+	// Not fatal.  IOVs are resolved by the database.
+
+	mf::LogWarning("DBFolder") << "Could not load IOV timeline for folder " << fFolderName
+				   << ": " << e.what() << "\n";
+      }
     }
-    else if(rc != SQLITE_DONE) {
-      mf::LogError("DBFolder") << "sqlite3_step returned error result = " << rc << "\n";
-      throw cet::exception("DBFolder") << "sqlite3_step error.";
+    return fTimeline.empty() ? nullptr : &fTimeline;
+  }
+
+  // Interval containing the specified time.
+
+  bool DBFolder::GetIOV(const IOVTimeStamp& ts, IOVTimeStamp& begin, IOVTimeStamp& end) const {
+    const DBTimeline* timeline = Timeline();
+    return timeline && timeline->find(ts, begin, end);
+  }
+
+  // Next IOV boundary.
+
+  IOVTimeStamp DBFolder::NextIOVBoundary(const IOVTimeStamp& ts) const {
+    const DBTimeline* timeline = Timeline();
+    return timeline ? timeline->nextBoundary(ts) : IOVTimeStamp::MaxTimeStamp();
+  }
+
+  // Load the IOVs of the tag from the sqlite database.
+
+  void DBFolder::LoadSQLiteTimeline(std::vector<DBTimeline::Entry>& entries) const {
+
+    std::lock_guard<std::mutex> lock(fSQLiteMutex);
+    std::string table_iovs = fFolderName + "_iovs";
+    std::string table_tag_iovs = fFolderName + "_tag_iovs";
+    std::string sql = "SELECT " + table_iovs + ".iov_id," + table_iovs + ".begin_time"
+      " FROM " + table_tag_iovs + "," + table_iovs +
+      " WHERE " + table_tag_iovs + ".tag=?1"
+      " AND " + table_tag_iovs + ".iov_id=" + table_iovs + ".iov_id";
+    std::unique_ptr<sqlite3_stmt, int(*)(sqlite3_stmt*)> stmt(PrepareSQLite(sql), sqlite3_finalize);
+    if(sqlite3_bind_text(stmt.get(), 1, fTag.c_str(), -1, SQLITE_TRANSIENT) != SQLITE_OK)
+      throw cet::exception("DBFolder") << "sqlite3_bind error.";
+    int rc = SQLITE_ROW;
+    while((rc = sqlite3_step(stmt.get())) == SQLITE_ROW)
+      entries.emplace_back(IOVTimeStamp(sqlite3_column_int64(stmt.get(), 1), 0),
+			   sqlite3_column_int64(stmt.get(), 0));
+    if(rc != SQLITE_DONE)
+      throw cet::exception("DBFolder") << "sqlite3_step error " << rc << ".";
+  }
+
+  // Load the IOVs of the tag from a conditions database server.
+  // The response of an iovs request has one IOV begin time per line.
+
+  void DBFolder::LoadHTTPTimeline(const std::string& url, std::vector<DBTimeline::Entry>& entries) const {
+
+    std::stringstream fullurl;
+    fullurl << url << "/iovs?f=" << fFolderName;
+    if (fTag.length() > 0) fullurl << "&tag=" << fTag;
+    std::string body;
+    FetchBody(fullurl.str(), fMaximumTimeout,
+	      [&body](std::string_view data) {body.append(data.data(), data.size());});
+    std::istringstream lines(body);
+    for(std::string line; std::getline(lines, line);) {
+      if(!line.empty() && line.back() == '\r')
+	line.pop_back();
+      if(!line.empty())
+	entries.emplace_back(IOVTimeStamp::GetFromString(line));
     }
+  }
 
-    // Delete query.
+  // Query data from conditions database server.
 
-    sqlite3_finalize(stmt);
+  std::shared_ptr<DBDataset> DBFolder::GetHTTPData(const std::string& url, const IOVTimeStamp& ts) const {
+    return FetchHTTP(DataURL(url, ts), fMaximumTimeout, fParallelParseRows, fCompressed, *fStats);
+  }
 
-    // Query count of channels.
-    // We do this so that we know how much memory to allocate.
+  // Full url of a data request.
 
-    std::string table_data = fFolderName + "_data";
-    sql.str("");
-    sql << "SELECT COUNT(DISTINCT channel)"
-	<< " FROM " << table_data << "," << table_iovs << "," << table_tag_iovs
-	<< " WHERE " << table_tag_iovs << ".tag='" << fTag << "'"
-	<< " AND " << table_iovs << ".iov_id=" << table_tag_iovs << ".iov_id"
-	<< " AND " << table_data << ".__iov_id=" << table_tag_iovs << ".iov_id"
-	<< " AND " << table_iovs << ".begin_time <= " << t;
-    //mf::LogInfo("DBFolder") << "sql = " << sql.str() << "\n";
+  std::string DBFolder::DataURL(const std::string& url, const IOVTimeStamp& ts) const {
+
+    //get full url string
+    std::stringstream fullurl;
+    fullurl << url << "/data?f=" << fFolderName
+            << "&t=" << ts.DBStamp();
+    if (fTag.length() > 0) fullurl << "&tag=" << fTag;
 
-    // Prepare query.
+    //mf::LogInfo log("DBFolder")
+    //log << "In DBFolder::GetHTTPData" << "\n";
+    //log << "Full url = " << fullurl.str() << "\n";
 
-    rc = sqlite3_prepare_v2(db, sql.str().c_str(), -1, &stmt, 0);
-    if(rc != SQLITE_OK) {
-      mf::LogError log("DBFolder");
-      log << "sqlite3_prepare_v2 failed." << fSQLitePath << "\n";
-      log << "Failed sql = " << sql.str() << "\n";
-      throw cet::exception("DBFolder") << "sqlite3_prepare_v2 error.";
+    return fullurl.str();
+  }
+
+  // Configure hedged requests.
+
+  void DBFolder::SetHedging(bool hedge, double percentile, double min_delay) {
+    std::lock_guard<std::mutex> lock(fHTTPMutex);
+    fHedge = hedge;
+    fHedgePercentile = std::min(std::max(percentile, 0.), 1.);
+    fHedgeMinDelay = std::max(min_delay, 0.);
+  }
+
+  // Configure circuit breaker.
+
+  void DBFolder::SetCircuitBreaker(unsigned int failures, double cooldown) {
+    std::lock_guard<std::mutex> lock(fHTTPMutex);
+    fBreakerFailures = failures;
+    fBreakerCooldown = std::max(cooldown, 0.);
+  }
+
+  // Update the circuit breaker of endpoint i, and the latency statistics of
+  // the primary, with the outcome of one request.
+
+  void DBFolder::RecordHedgeOutcome(int i, bool ok, double latency) const {
+    std::lock_guard<std::mutex> lock(fHTTPMutex);
+    if(ok) {
+      fBreakerCount[i] = 0;
+      fBreakerOpenUntil[i] = std::chrono::steady_clock::time_point();
+      if(i == 0) {
+	fLatencies.push_back(latency);
+	if(fLatencies.size() > kMAX_LATENCY_SAMPLES)
+	  fLatencies.pop_front();
+      }
+    }
+    else if(fBreakerFailures > 0 && ++fBreakerCount[i] >= fBreakerFailures) {
+      mf::LogWarning("DBFolder") << "Not using " << (i == 0 ? fURL : fURL2) << " for "
+				 << fBreakerCooldown << " s after " << fBreakerCount[i] << " failures.\n";
+      fBreakerOpenUntil[i] = std::chrono::steady_clock::now()
+	+ std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+	  std::chrono::duration<double>(fBreakerCooldown));
+    }
+  }
+
+  // Whether the circuit breaker of endpoint i is open.  Caller must hold fHTTPMutex.
+
+  bool DBFolder::BreakerOpen(int i, std::chrono::steady_clock::time_point now) const {
+    return now < fBreakerOpenUntil[i];
+  }
+
+  // Delay before the hedged request is sent.
+  // The configured percentile of recent primary latencies, but not less than the
+  // minimum delay.  Caller must hold fHTTPMutex.
+
+  double DBFolder::HedgeDelay() const {
+    if(fLatencies.size() < kMIN_LATENCY_SAMPLES)
+      return std::max(fHedgeMinDelay, kDEFAULT_HEDGE_DELAY);
+    std::vector<double> latencies(fLatencies.begin(), fLatencies.end());
+    size_t n = std::min(latencies.size() - 1, size_t(fHedgePercentile * latencies.size()));
+    std::nth_element(latencies.begin(), latencies.begin() + n, latencies.end());
+    return std::max(fHedgeMinDelay, latencies[n]);
+  }
+
+  // Query data from the primary server, with hedging and failover to the
+  // secondary server.
+  //
+  // The request is sent to the first endpoint whose circuit breaker is closed
+  // (normally the primary).  If it has not answered after the hedge delay, or
+  // if it fails, the same request is sent to the other endpoint, unless its
+  // circuit breaker is open, and the first successful answer is used.
+  // Requests that lose the race are abandoned, but still run to completion
+  // and count for latency statistics and circuit breakers.  No hedge is sent
+  // while kMAX_HEDGE_THREADS requests are in flight.  An endpoint that fails
+  // fBreakerFailures times in a row is skipped for fBreakerCooldown seconds.
+
+  std::shared_ptr<DBDataset> DBFolder::GetHedgedHTTPData(const IOVTimeStamp& ts) const {
+
+    if(!fHedge || fURL2 == "")
+      return GetHTTPData(fURL, ts);
+
+    const std::string fullurl[2] = {DataURL(fURL, ts), DataURL(fURL2, ts)};
+    int first = 0;
+    double delay = 0.;
+    {
+      std::lock_guard<std::mutex> lock(fHTTPMutex);
+      auto now = std::chrono::steady_clock::now();
+      bool open0 = BreakerOpen(0, now);
+      bool open1 = BreakerOpen(1, now);
+      if(open0 && (!open1 || fBreakerOpenUntil[1] < fBreakerOpenUntil[0]))
+	first = 1;
+      delay = HedgeDelay();
     }
+    int second = 1 - first;
 
-    // Execute query.
-    // Retrieve one row.
-    // It is an error if we don't get at least one row.
+    // Whether the second endpoint may be asked now.
 
-    rc = sqlite3_step(stmt);
-    unsigned int nrows = 0;
-    if(rc == SQLITE_ROW) {
-      nrows = sqlite3_column_int(stmt, 0);
-      //mf::LogInfo("DBFolder") << "Number of data rows = " << nrows << "\n";
+    auto second_allowed = [this, second] {
+      std::lock_guard<std::mutex> lock(fHTTPMutex);
+      return !BreakerOpen(second, std::chrono::steady_clock::now());
+    };
+
+    auto state = std::make_shared<HedgeState>();
+    bool hedge_allowed = fHedgeControl->fRunning < kMAX_HEDGE_THREADS;
+    StartHedgeRequest(state, first, fullurl[first]);
+
+    std::unique_lock<std::mutex> lock(state->fMutex);
+    bool started[2] = {false, false};
+    started[first] = true;
+    state->fDone.wait_for(lock, std::chrono::duration<double>(delay),
+			  [&state, first] {return state->fFinished[first];});
+
+    // Hedge if the first request is slow (and the other endpoint is healthy).
+
+    if(!state->fFinished[first] && hedge_allowed && second_allowed()) {
+      mf::LogInfo("DBFolder") << "No answer from " << (first == 0 ? fURL : fURL2) << " after "
+			      << delay << " s, sending request to " << (second == 0 ? fURL : fURL2) << "\n";
+      StartHedgeRequest(state, second, fullurl[second]);
+      started[second] = true;
     }
-    else {
-      mf::LogError("DBFolder") << "sqlite3_step returned error result = " << rc << "\n";
-      throw cet::exception("DBFolder") << "sqlite3_step error.";
+
+    // Wait for a successful answer, failing over if the first request fails,
+    // or for all started requests to fail.
+
+    for(;;) {
+      if(state->fResult[0] || state->fResult[1])
+	break;
+      if(state->fFinished[first] && !started[second]) {
+	if(!second_allowed())
+	  break;
+	StartHedgeRequest(state, second, fullurl[second]);
+	started[second] = true;
+      }
+      else if(state->fFinished[first] && state->fFinished[second])
+	break;
+      state->fDone.wait(lock);
     }
 
-    // Reserve collections that depend on number of rows (only).
+    for(int i : {first, second}) {
+      if(state->fResult[i])
+	return state->fResult[i];
+    }
+    std::rethrow_exception(state->fError[first]);
+  }
 
-    channels.reserve(nrows);
+  // Start fetching the dataset following the current one in a worker thread.
 
-    // Delete query.
+  void DBFolder::StartPrefetch() {
 
-    sqlite3_finalize(stmt);
+    if(!fPrefetch || fTestMode || fPrefetchResult.valid())
+      return;
 
-    // Stash begin time.
+    // Nothing to do if the current IOV is open ended, or if the next
+    // dataset is already in memory.
 
-    begin_ts = IOVTimeStamp(begin_time, 0);
+    IOVTimeStamp next = fCache->endTime();
+    if(next == IOVTimeStamp::MaxTimeStamp() || fDatasetCache.contains(next))
+      return;
 
-    // Stash end time.
+    fPrefetchTime = next;
+    fPrefetchResult = std::async(std::launch::async, [this, next] { return FetchDataset(next); });
+  }
 
-    if(end_time == 0)
-      end_ts = IOVTimeStamp::MaxTimeStamp();
+  // Register with, or unregister from, the fetch coordinator.
+
+  void DBFolder::SetCoordinatedFetch(bool coordinated) {
+    if(coordinated == fCoordinated)
+      return;
+    fCoordinated = coordinated;
+    if(coordinated)
+      DBFolderCoordinator::Instance().Register(this);
     else
-      end_ts = IOVTimeStamp(end_time, 0);
+      DBFolderCoordinator::Instance().Unregister(this);
+  }
 
-    // Main data query.
+  // Start fetching the dataset for the specified time in a worker thread.
+  // Folders that have never been accessed are left alone.
 
-    sql.str("");
-    sql << "SELECT " << table_data << ".*,MAX(begin_time)"
-	<< " FROM " << table_data << "," << table_iovs << "," << table_tag_iovs
-	<< " WHERE " << table_tag_iovs << ".tag='" << fTag << "'"
-	<< " AND " << table_iovs << ".iov_id=" << table_tag_iovs << ".iov_id"
-	<< " AND " << table_data << ".__iov_id=" << table_tag_iovs << ".iov_id"
-	<< " AND " << table_iovs << ".begin_time <= " << t
-	<< " GROUP BY channel"
-	<< " ORDER BY channel";
-    //mf::LogInfo("DBFolder") << "sql = " << sql.str() << "\n";
-
-    // Prepare query.
-
-    rc = sqlite3_prepare_v2(db, sql.str().c_str(), -1, &stmt, 0);
-    if(rc != SQLITE_OK) {
-      mf::LogError log("DBFolder");
-      log << "sqlite3_prepare_v2 failed." << fSQLitePath << "\n";
-      log << "Failed sql = " << sql.str() << "\n";
-      throw cet::exception("DBFolder") << "sqlite3_prepare_v2 error.";
+  void DBFolder::StartFetch(const IOVTimeStamp& ts) {
+
+    if(!fUsed || fTestMode || IsValid(ts) || fPrefetchResult.valid() || fDatasetCache.contains(ts))
+      return;
+
+    fPrefetchTime = ts;
+    fPrefetchResult = std::async(std::launch::async, [this, ts] { return FetchDataset(ts); });
+  }
+
+  // Preload all IOVs overlapping a time range.
+  //
+  // With a timeline, the IOV begin times are known up front, and the datasets
+  // are fetched concurrently (sqlite fetches are serialized by the connection).
+  // Otherwise the IOVs are walked one after the other, each starting at the end
+  // time of the previous one.
+
+  size_t DBFolder::Preload(DBTimeStamp_t raw_tmin, DBTimeStamp_t raw_tmax) {
+
+    if(fTestMode)
+      return 0;
+    IOVTimeStamp tmin = TimeStampDecoder::DecodeTimeStamp(raw_tmin);
+    IOVTimeStamp tmax = TimeStampDecoder::DecodeTimeStamp(raw_tmax);
+    auto start = DBFolderStats::clock_type::now();
+    size_t loaded = 0;
+
+    try {
+      const DBTimeline* timeline = Timeline();
+      if(timeline) {
+
+	// Begin times of the IOVs in range.  Datasets that are already
+	// cached are just pinned.
+
+	std::vector<IOVTimeStamp> times;
+	IOVTimeStamp begin = tmin;
+	IOVTimeStamp end = tmin;
+	if(timeline->find(tmin, begin, end))
+	  times.push_back(begin);
+	for(const IOVTimeStamp& boundary : timeline->boundaries()) {
+	  if(tmin < boundary && boundary <= tmax)
+	    times.push_back(boundary);
+	}
+	std::vector<IOVTimeStamp> missing;
+	for(const IOVTimeStamp& t : times) {
+	  DBDatasetCache::dataset_ptr cached = fDatasetCache.find(t);
+	  if(cached) {
+	    fDatasetCache.insert(cached, true);
+	    ++loaded;
+	  }
+	  else
+	    missing.push_back(t);
+	}
+
+	// Fetch the others with a few worker threads.
+
+	std::vector<std::shared_ptr<DBDataset> > results(missing.size());
+	std::vector<std::exception_ptr> errors(missing.size());
+	std::atomic<size_t> next(0);
+	size_t nthreads = std::min<size_t>(fSQLitePath != "" ? 1 : kPRELOAD_THREADS, missing.size());
+	{
+	  std::vector<std::future<void> > workers;
+	  for(size_t i=0; i<nthreads; ++i)
+	    workers.push_back(std::async(std::launch::async, [&] {
+		  for(size_t j; (j = next++) < missing.size();) {
+		    try {
+		      results[j] = FetchDataset(missing[j]);
+		    }
+		    catch(...) {
+		      errors[j] = std::current_exception();
+		    }
+		  }
+		}));
+	}
+	for(size_t j=0; j<missing.size(); ++j) {
+	  if(results[j]) {
+	    fDatasetCache.insert(results[j], true);
+	    ++loaded;
+	  }
+	}
+	for(const std::exception_ptr& error : errors) {
+	  if(error)
+	    std::rethrow_exception(error);
+	}
+      }
+      else {
+	IOVTimeStamp t = tmin;
+	for(;;) {
+	  DBDatasetCache::dataset_ptr dataset = fDatasetCache.find(t);
+	  if(!dataset)
+	    dataset = FetchDataset(t);
+	  fDatasetCache.insert(dataset, true);
+	  ++loaded;
+	  const IOVTimeStamp& end = dataset->endTime();
+	  if(end == IOVTimeStamp::MaxTimeStamp() || tmax < end || !(t < end))
+	    break;
+	  t = end;
+	}
+      }
     }
+    catch(std::exception& e) {
 
-    // Execute the query and retrieve one row.
-    // We do this to extract the number, names, and types of relevant columns.
+      // Not fatal.  The remaining datasets will be fetched when needed.
 
-    int ncols = sqlite3_column_count(stmt);
-    column_names.reserve(ncols);
-    column_types.reserve(ncols);
+      mf::LogWarning("DBFolder") << "Preload failed for folder " << fFolderName << ": " << e.what() << "\n";
+    }
 
-    rc = sqlite3_step(stmt);
-    if(rc == SQLITE_ROW) {
+    mf::LogInfo("DBFolder") << "Preloaded " << loaded << " datasets of folder " << fFolderName
+			    << " in " << DBFolderStats::since(start) << " s.\n";
+    return loaded;
+  }
 
-      // Loop over columns.
+  // Move a completed prefetch into the dataset cache.
 
-      for(int col = 0; col < ncols; ++col) {
-	std::string colname = sqlite3_column_name(stmt, col);
+  void DBFolder::CollectPrefetch(bool wait) {
 
-	// Ignore columns that begin with "_".
-	// Also ignore utility column MAX(begin_time).
+    if(!fPrefetchResult.valid())
+      return;
+    if(!wait && fPrefetchResult.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      return;
 
-	if(colname[0] != '_' && colname.substr(0,3) != "MAX") {
-	  column_names.push_back(colname);
-	  int dtype = sqlite3_column_type(stmt, col);
-	  if(dtype == SQLITE_INTEGER)
-	    column_types.push_back("integer");
-	  else if(dtype == SQLITE_FLOAT)
-	    column_types.push_back("real");
-	  else if(dtype == SQLITE_TEXT)
-	    column_types.push_back("text");
-	  else if(dtype == SQLITE_NULL)
-	    column_types.push_back("NULL");
-	  else {
-	    mf::LogError("DBFolder") << "Unknown type " << dtype << "\n";
-	    throw cet::exception("DBFolder") << "Unknown type " << dtype;
+    try {
+      fDatasetCache.insert(fPrefetchResult.get());
+    }
+    catch(std::exception& e) {
+
+      // Not fatal.  The data will be fetched again synchronously if needed.
+
+      mf::LogWarning("DBFolder") << "Prefetch failed for folder " << fFolderName << ": " << e.what() << "\n";
+    }
+  }
+
+  namespace {
+
+    // Indexes needed by the sqlite queries, as (table suffix, index suffix, columns).
+
+    const char* const kSQLITE_INDEXES[][3] = {
+      {"_tag_iovs", "_tag_iovs_tag_idx", "tag,iov_id"},
+      {"_iovs",     "_iovs_iov_idx",     "iov_id,begin_time"},
+      {"_data",     "_data_iov_idx",     "__iov_id,channel"}
+    };
+
+    // Dataset column type from the declared type of a sqlite column, following
+    // the sqlite affinity rules.  Returns "" for NUMERIC and undeclared columns,
+    // which may hold integers or reals; their type is taken from the first value.
+
+    std::string DeclaredColumnType(const char* decl)
+    {
+      if(decl == nullptr)
+	return "";
+      std::string type(decl);
+      std::transform(type.begin(), type.end(), type.begin(), ::tolower);
+      if(type.find("int") != std::string::npos)
+	return "integer";
+      if(type.find("char") != std::string::npos || type.find("clob") != std::string::npos ||
+	 type.find("text") != std::string::npos)
+	return "text";
+      if(type.find("real") != std::string::npos || type.find("floa") != std::string::npos ||
+	 type.find("doub") != std::string::npos)
+	return "real";
+      return "";
+    }
+
+    // Check whether table has an index whose leading columns are the specified
+    // (comma-separated) columns.
+
+    bool HasSQLiteIndex(sqlite3* db, const std::string& table, const std::string& columns)
+    {
+      std::vector<std::string> wanted;
+      std::istringstream ss(columns);
+      for(std::string col; std::getline(ss, col, ',');)
+	wanted.push_back(col);
+
+      std::vector<std::string> indexes;
+      std::string sql = "PRAGMA index_list(" + table + ")";
+      sqlite3_stmt* stmt = nullptr;
+      if(sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0) != SQLITE_OK)
+	return false;
+      while(sqlite3_step(stmt) == SQLITE_ROW)
+	indexes.push_back((const char*)sqlite3_column_text(stmt, 1));
+      sqlite3_finalize(stmt);
+
+      for(const std::string& index : indexes) {
+	std::vector<std::string> cols;
+	sql = "PRAGMA index_info(" + index + ")";
+	if(sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0) != SQLITE_OK)
+	  continue;
+	while(sqlite3_step(stmt) == SQLITE_ROW) {
+	  const unsigned char* name = sqlite3_column_text(stmt, 2);
+	  cols.push_back(name ? (const char*)name : "");
+	}
+	sqlite3_finalize(stmt);
+	if(cols.size() >= wanted.size() && std::equal(wanted.begin(), wanted.end(), cols.begin()))
+	  return true;
+      }
+      return false;
+    }
+
+    // Return the names of required indexes that are missing.
+    // If create is true, create them.
+
+    std::vector<std::string> CheckSQLiteIndexes(sqlite3* db, const std::string& folder, bool create)
+    {
+      std::vector<std::string> missing;
+      for(const auto& index : kSQLITE_INDEXES) {
+	std::string table = folder + index[0];
+	if(HasSQLiteIndex(db, table, index[2]))
+	  continue;
+	std::string name = folder + index[1];
+	if(create) {
+	  std::string sql = "CREATE INDEX IF NOT EXISTS " + name + " ON " + table + "(" + index[2] + ")";
+	  char* errmsg = nullptr;
+	  if(sqlite3_exec(db, sql.c_str(), 0, 0, &errmsg) != SQLITE_OK) {
+	    mf::LogError("DBFolder") << "Failed to create index " << name << ": " << (errmsg ? errmsg : "") << "\n";
+	    sqlite3_free(errmsg);
+	    missing.push_back(name);
 	  }
-	  //mf::LogInfo("DBFolder") << "Column " << col
-	  //	    << ", name=" << column_names.back()
-	  //	    << ", type=" << column_types.back() << "\n";
 	}
+	else
+	  missing.push_back(name);
       }
+      return missing;
     }
-    else {
-      mf::LogError("DBFolder") << "No data rows." << "\n";
-      throw cet::exception("DBFolder") << "No data rows.";
+  }
+
+  // Check for (and optionally create) the indexes needed by the sqlite queries
+  // of a folder in a local .db file.  Return true if all indexes are present.
+
+  bool DBFolder::EnsureSQLiteIndexes(const std::string& path, const std::string& folder, bool create)
+  {
+    sqlite3* db = nullptr;
+    int flags = create ? SQLITE_OPEN_READWRITE : SQLITE_OPEN_READONLY;
+    if(sqlite3_open_v2(path.c_str(), &db, flags, nullptr) != SQLITE_OK) {
+      sqlite3_close(db);
+      throw cet::exception("DBFolder") << "Failed to open sqlite database " << path;
+    }
+    std::vector<std::string> missing = CheckSQLiteIndexes(db, folder, create);
+    sqlite3_close(db);
+    return missing.empty();
+  }
+
+  // Open sqlite database and prepare queries.
+  // The connection and prepared statements are kept for the lifetime of the folder.
+
+  void DBFolder::OpenSQLite()
+  {
+    //mf::LogInfo("DBFolder") << "Opening sqlite database " << fSQLitePath << "\n";
+    int rc = sqlite3_open_v2(fSQLitePath.c_str(), &fSQLiteDB, SQLITE_OPEN_READONLY, nullptr);
+    if(rc != SQLITE_OK) {
+      mf::LogError("DBFolder") << "Failed to open sqlite database " << fSQLitePath << "\n";
+      sqlite3_close(fSQLiteDB);
+      fSQLiteDB = nullptr;
+      throw cet::exception("DBFolder") << "Failed to open sqlite database " << fSQLitePath;
     }
 
-    // Remember the number of relevant columns.
+    // Missing indexes make IOV changes slow, but are not an error.
+
+    std::vector<std::string> missing = CheckSQLiteIndexes(fSQLiteDB, fFolderName, false);
+    if(!missing.empty()) {
+      mf::LogWarning log("DBFolder");
+      log << "SQLite database " << fSQLitePath << " is missing indexes:";
+      for(const std::string& name : missing)
+	log << " " << name;
+      log << "\nUse DBFolder::EnsureSQLiteIndexes to create them." << "\n";
+    }
+
+    std::string table_iovs = fFolderName + "_iovs";
+    std::string table_tag_iovs = fFolderName + "_tag_iovs";
+    std::string table_data = fFolderName + "_data";
+    std::ostringstream sql;
+
+    // IOV resolution query (parameters: tag, time).
+    // Returns the IOVs of the tag that begin at or before the requested time,
+    // newest first.  Every row also carries the begin time of the next IOV,
+    // which is the end time of the newest one (NULL if it is open ended).
+
+    sql << "SELECT " << table_iovs << ".iov_id," << table_iovs << ".begin_time,"
+	<< " (SELECT MIN(i2.begin_time)"
+	<< " FROM " << table_tag_iovs << " t2," << table_iovs << " i2"
+	<< " WHERE t2.tag=?1 AND t2.iov_id=i2.iov_id AND i2.begin_time > ?2)"
+	<< " FROM " << table_tag_iovs << "," << table_iovs
+	<< " WHERE " << table_tag_iovs << ".tag=?1"
+	<< " AND " << table_tag_iovs << ".iov_id=" << table_iovs << ".iov_id"
+	<< " AND " << table_iovs << ".begin_time <= ?2"
+	<< " ORDER BY " << table_iovs << ".begin_time desc";
+    fIOVStmt = PrepareSQLite(sql.str());
+
+    // Data query for a single IOV (parameter: iov_id).
+
+    sql.str("");
+    sql << "SELECT * FROM " << table_data << " WHERE __iov_id=?1";
+    fDataStmt = PrepareSQLite(sql.str());
+
+    // Count of distinct channels in the IOVs of the tag that begin at or
+    // before a time (parameters: tag, time), to know when all channels have
+    // been found.  Executed once per IOV begin time.
 
-    size_t nrelcols = column_names.size();
-    values.reserve(nrows * nrelcols);
+    sql.str("");
+    sql << "SELECT COUNT(DISTINCT " << table_data << ".channel)"
+	<< " FROM " << table_tag_iovs << "," << table_iovs << "," << table_data
+	<< " WHERE " << table_tag_iovs << ".tag=?1"
+	<< " AND " << table_tag_iovs << ".iov_id=" << table_iovs << ".iov_id"
+	<< " AND " << table_iovs << ".begin_time <= ?2"
+	<< " AND " << table_data << ".__iov_id=" << table_tag_iovs << ".iov_id";
+    fCountStmt = PrepareSQLite(sql.str());
+
+    // Remember which result columns of the data query are relevant.
+    // Ignore columns that begin with "_".
+
+    int ncols = sqlite3_column_count(fDataStmt);
+    for(int col = 0; col < ncols; ++col) {
+      std::string colname = sqlite3_column_name(fDataStmt, col);
+      if(colname[0] != '_') {
+	fSQLiteColumns.push_back(col);
+	fSQLiteColumnNames.push_back(colname);
+	fSQLiteColumnTypes.push_back(DeclaredColumnType(sqlite3_column_decltype(fDataStmt, col)));
+      }
+    }
+  }
 
-    // Re-execute query.
-    // Retrieve all data rows and stash in result.
+  // Prepare one sqlite statement.
 
-    rc = sqlite3_reset(stmt);
+  sqlite3_stmt* DBFolder::PrepareSQLite(const std::string& sql) const
+  {
+    //mf::LogInfo("DBFolder") << "sql = " << sql << "\n";
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v2(fSQLiteDB, sql.c_str(), -1, &stmt, 0);
     if(rc != SQLITE_OK) {
-      mf::LogError("DBFolder") << "sqlite3_reset failed." << "\n";
-      throw cet::exception("DBFolder") << "sqlite3_failed.";
-    }
-    size_t irow = 0;
-    while(rc != SQLITE_DONE) {
-      rc = sqlite3_step(stmt);
-      if(rc == SQLITE_ROW) {
-	++irow;
-	//mf::LogInfo("DBFolder") << irow << " rows." << "\n";
-	if(irow > nrows) {
-	  mf::LogError("DBFolder") << "Too many data rows " << irow << "\n";
-	  throw cet::exception("DBFolder") << "Too many data rows " << irow;
-	}
+      mf::LogError log("DBFolder");
+      log << "sqlite3_prepare_v2 failed." << fSQLitePath << "\n";
+      log << "Failed sql = " << sql << "\n";
+      throw cet::exception("DBFolder") << "sqlite3_prepare_v2 error.";
+    }
+    return stmt;
+  }
 
-	// Loop over columns.
-	// Remember that ncols is the number of columns returned by the query,
-	// not the number of columns that get stored (some columns are ignored).
+  // Close sqlite database.
 
-	bool firstcol = true;
-	for(int col = 0; col < ncols; ++col) {
-	  std::string colname = sqlite3_column_name(stmt, col);
+  void DBFolder::CloseSQLite()
+  {
+    sqlite3_finalize(fIOVStmt);
+    sqlite3_finalize(fDataStmt);
+    sqlite3_finalize(fCountStmt);
+    sqlite3_close(fSQLiteDB);
+    fIOVStmt = nullptr;
+    fDataStmt = nullptr;
+    fCountStmt = nullptr;
+    fSQLiteDB = nullptr;
+    fSQLiteChannelCounts.clear();
+  }
 
-	  // Ignore columns that begin with "_".
-	  // Also ignore utility column MAX(begin_time).
+  namespace {
 
-	  if(colname[0] != '_' && colname.substr(0,3) != "MAX") {
-	    int dtype = sqlite3_column_type(stmt, col);
+    // Reset a prepared statement when going out of scope.
 
-	    if(dtype == SQLITE_INTEGER) {
-	      long value = sqlite3_column_int(stmt, col);
-	      //mf::LogInfo("DBFolder") << "Value = " << value << "\n";
-	      values.push_back(DBDataset::value_type(value));
-	      if(firstcol)
-		channels.push_back(value);
-	    }
-	    else if(dtype == SQLITE_FLOAT) {
-	      double value = sqlite3_column_double(stmt, col);
-	      //mf::LogInfo("DBFolder") << "Value = " << value << "\n";
-	      values.push_back(DBDataset::value_type(value));
-	      if(firstcol) {
-		mf::LogError("DBFolder") << "First column has wrong type float." << "\n";
-		throw cet::exception("DBFolder") << "First column has wrong type float.";
-	      }
-	    }
-	    else if(dtype == SQLITE_TEXT) {
-	      const char* s = (const char*)sqlite3_column_text(stmt, col);
-	      //mf::LogInfo("DBFolder") << "Value = " << s << "\n";
-	      values.emplace_back(std::make_unique<std::string>(s));
-	      if(firstcol) {
-		mf::LogError("DBFolder") << "First column has wrong type text." << "\n";
-		throw cet::exception("DBFolder") << "First column has wrong type text.";
-	      }
-	    }
-	    else if(dtype == SQLITE_NULL) {
-	      values.push_back(DBDataset::value_type());
-	      //mf::LogInfo("DBFolder") << "Value = NULL" << "\n";
-	      if(firstcol) {
-		mf::LogError("DBFolder") << "First column has wrong type null." << "\n";
-		throw cet::exception("DBFolder") << "First column has wrong type null.";
-	      }
-	    }
+    class SQLiteReset {
+    public:
+      SQLiteReset(sqlite3_stmt* stmt) : fStmt(stmt) {sqlite3_reset(fStmt);}
+      ~SQLiteReset() {sqlite3_reset(fStmt);}
+    private:
+      sqlite3_stmt* fStmt;
+    };
+
+    void SQLiteBindError()
+    {
+      mf::LogError("DBFolder") << "sqlite3_bind failed." << "\n";
+      throw cet::exception("DBFolder") << "sqlite3_bind error.";
+    }
+  }
+
+  // Query data from sqlite database.
+  //
+  // Data for a channel come from the newest IOV of the tag that begins at or
+  // before the requested time and contains that channel.  IOVs are visited
+  // newest first, and the first row seen for each channel is kept.  The walk
+  // stops as soon as every channel of the IOVs up to the requested one has
+  // been found (or the IOVs run out), which for the usual case of complete
+  // IOVs means after the first one.
+  //
+  // IOVs are taken from the timeline if there is one, otherwise from the
+  // IOV resolution query.
+
+  void DBFolder::GetSQLiteData(int t, DBDataset& data) const
+  {
+    if(fSQLitePath == "")
+      return;
+
+    // The timeline is loaded (once) before locking the connection.
+
+    const DBTimeline* timeline = Timeline();
+
+    // The connection is shared with the prefetch thread.
+
+    std::lock_guard<std::mutex> lock(fSQLiteMutex);
+
+    //mf::LogInfo log("DBFolder")
+    //log << "DBFolder::GetSQLiteData" << "\n";
+    //log << "t=" << t << "\n";
+    //log << "sqlite path = " << fSQLitePath << "\n";
+
+    // Resolve IOV.
+    // It is an error if we don't get at least one IOV.
+
+    IOVTimeStamp begin_ts(0, 0);
+    IOVTimeStamp end_ts = IOVTimeStamp::MaxTimeStamp();
+    size_t timeline_iovs = 0;    // Timeline IOVs not visited yet.
+    SQLiteReset iov_reset(fIOVStmt);
+    int rc = SQLITE_DONE;
+    if(timeline) {
+      timeline_iovs = timeline->countUntil(IOVTimeStamp(t, 0));
+      if(!timeline->find(IOVTimeStamp(t, 0), begin_ts, end_ts)) {
+	mf::LogError("DBFolder") << "No IOV at time " << t << "\n";
+	throw cet::exception("DBFolder") << "No IOV at time " << t << ".";
+      }
+    }
+    else {
+      if(sqlite3_bind_text(fIOVStmt, 1, fTag.c_str(), -1, SQLITE_TRANSIENT) != SQLITE_OK ||
+	 sqlite3_bind_int64(fIOVStmt, 2, t) != SQLITE_OK)
+	SQLiteBindError();
+      rc = sqlite3_step(fIOVStmt);
+      if(rc != SQLITE_ROW) {
+	mf::LogError("DBFolder") << "sqlite3_step returned error result = " << rc << "\n";
+	throw cet::exception("DBFolder") << "sqlite3_step error.";
+      }
+
+      // Stash begin and end time.
+      // A NULL end time means the IOV is open ended.
+
+      begin_ts = IOVTimeStamp(sqlite3_column_int64(fIOVStmt, 1), 0);
+      if(sqlite3_column_type(fIOVStmt, 2) != SQLITE_NULL)
+	end_ts = IOVTimeStamp(sqlite3_column_int64(fIOVStmt, 2), 0);
+    }
+    //mf::LogInfo("DBFolder") << "IOV = " << begin_ts.DBStamp() << " - " << end_ts.DBStamp() << "\n";
+
+    // Count channels of the IOVs up to this one (once per IOV).
+    // Channels that first appear in a later IOV are not counted, so the walk
+    // below stops as early as the data allow.
+
+    long begin_time = begin_ts.Stamp();
+    auto count = fSQLiteChannelCounts.find(begin_time);
+    if(count == fSQLiteChannelCounts.end()) {
+      SQLiteReset reset(fCountStmt);
+      if(sqlite3_bind_text(fCountStmt, 1, fTag.c_str(), -1, SQLITE_TRANSIENT) != SQLITE_OK ||
+	 sqlite3_bind_int64(fCountStmt, 2, begin_time) != SQLITE_OK)
+	SQLiteBindError();
+      int crc = sqlite3_step(fCountStmt);
+      if(crc != SQLITE_ROW) {
+	mf::LogError("DBFolder") << "sqlite3_step returned error result = " << crc << "\n";
+	throw cet::exception("DBFolder") << "sqlite3_step error.";
+      }
+      count = fSQLiteChannelCounts.emplace(begin_time, sqlite3_column_int64(fCountStmt, 0)).first;
+      //mf::LogInfo("DBFolder") << "Number of channels = " << count->second << "\n";
+    }
+    size_t maxrows = count->second;
+
+    // Collect rows, in the order they are found.
+    // The result dataset is created when the first row supplies the column types.
+
+    DBDataset result;
+    std::unordered_set<DBChannelID_t> seen;
+    seen.reserve(maxrows);
+    bool firstrow = true;
+
+    // Loop over IOVs, newest first.
+
+    sqlite3_int64 iov_id = 0;
+    bool first_iov = true;
+    auto next_iov = [&]() {
+      if(timeline) {
+	if(timeline_iovs == 0)
+	  return false;
+	iov_id = timeline->entries()[--timeline_iovs].iov_id;
+	return true;
+      }
+      if(!first_iov)
+	rc = sqlite3_step(fIOVStmt);
+      first_iov = false;
+      if(rc != SQLITE_ROW)
+	return false;
+      iov_id = sqlite3_column_int64(fIOVStmt, 0);
+      return true;
+    };
+    while(result.nrows() < maxrows && next_iov()) {
+      SQLiteReset data_reset(fDataStmt);
+      if(sqlite3_bind_int64(fDataStmt, 1, iov_id) != SQLITE_OK)
+	SQLiteBindError();
+
+      // Loop over data rows of this IOV.
+
+      int drc = SQLITE_ROW;
+      while((drc = sqlite3_step(fDataStmt)) == SQLITE_ROW) {
+
+	// The first relevant column is the channel.
+	// Skip channels that were already found in a newer IOV.
+
+	int chcol = fSQLiteColumns.front();
+	int chtype = sqlite3_column_type(fDataStmt, chcol);
+	if(chtype != SQLITE_INTEGER) {
+	  mf::LogError("DBFolder") << "First column has wrong type " << chtype << "." << "\n";
+	  throw cet::exception("DBFolder") << "First column has wrong type " << chtype << ".";
+	}
+	if(!seen.insert(sqlite3_column_int64(fDataStmt, chcol)).second)
+	  continue;
+
+	// Column types are the declared types, or else taken from the first row.
+	// Columns that turn out to hold reals are promoted (see DBDataset::appendDouble).
+
+	if(firstrow) {
+	  std::vector<std::string> column_names = fSQLiteColumnNames;
+	  std::vector<std::string> column_types;
+	  column_types.reserve(fSQLiteColumns.size());
+	  for(size_t i=0; i<fSQLiteColumns.size(); ++i) {
+	    int col = fSQLiteColumns[i];
+	    int dtype = sqlite3_column_type(fDataStmt, col);
+	    if(!fSQLiteColumnTypes[i].empty())
+	      column_types.push_back(fSQLiteColumnTypes[i]);
+	    else if(dtype == SQLITE_INTEGER)
+	      column_types.push_back("integer");
+	    else if(dtype == SQLITE_FLOAT)
+	      column_types.push_back("real");
+	    else if(dtype == SQLITE_TEXT)
+	      column_types.push_back("text");
+	    else if(dtype == SQLITE_NULL)
+	      column_types.push_back("NULL");
 	    else {
-	      mf::LogError("DBFolder") << "Unrecognized sqlite data type" << "\n";
-	      throw cet::exception("DBFolder") << "Unrecognized sqlite data type.";
+	      mf::LogError("DBFolder") << "Unknown type " << dtype << "\n";
+	      throw cet::exception("DBFolder") << "Unknown type " << dtype;
 	    }
-	    firstcol = false;
+	  }
+	  result = DBDataset(begin_ts, end_ts,
+			     std::move(column_names),
+			     std::move(column_types),
+			     maxrows);
+	  firstrow = false;
+	}
+
+	// Loop over relevant columns.
+
+	for(size_t i=0; i<fSQLiteColumns.size(); ++i) {
+	  int col = fSQLiteColumns[i];
+	  int dtype = sqlite3_column_type(fDataStmt, col);
+	  if(dtype == SQLITE_INTEGER)
+	    result.appendLong(i, sqlite3_column_int64(fDataStmt, col));
+	  else if(dtype == SQLITE_FLOAT)
+	    result.appendDouble(i, sqlite3_column_double(fDataStmt, col));
+	  else if(dtype == SQLITE_TEXT)
+	    result.appendString(i, std::string_view((const char*)sqlite3_column_text(fDataStmt, col),
+						  sqlite3_column_bytes(fDataStmt, col)));
+	  else if(dtype == SQLITE_NULL)
+	    result.appendNull(i);
+	  else {
+	    mf::LogError("DBFolder") << "Unrecognized sqlite data type" << "\n";
+	    throw cet::exception("DBFolder") << "Unrecognized sqlite data type.";
 	  }
 	}
       }
-      else if(rc != SQLITE_DONE) {
-	mf::LogError("DBFolder") << "sqlite3_step returned error result = " << rc << "\n";
+      if(drc != SQLITE_DONE) {
+	mf::LogError("DBFolder") << "sqlite3_step returned error result = " << drc << "\n";
 	throw cet::exception("DBFolder") << "sqlite3_step error.";
       }
     }
-    if(irow != nrows) {
-      mf::LogError("DBFolder") << "Wrong number of data rows " << irow << "," << nrows << "\n";
-      throw cet::exception("DBFolder") << "Wrong number of data rows " << irow << "," << nrows << "\n";
+    if(rc != SQLITE_ROW && rc != SQLITE_DONE) {
+      mf::LogError("DBFolder") << "sqlite3_step returned error result = " << rc << "\n";
+      throw cet::exception("DBFolder") << "sqlite3_step error.";
     }
-    if(values.size() != nrows * nrelcols) {
-      mf::LogError("DBFolder") << "Wrong number of values "
-			       << values.size() << "," << nrows << "," << nrelcols << "\n";
-      throw cet::exception("DBFolder") << "Wrong number of values "
-				       << values.size() << "," << nrows << "," << nrelcols << "\n";
+    if(firstrow) {
+      mf::LogError("DBFolder") << "No data rows." << "\n";
+      throw cet::exception("DBFolder") << "No data rows.";
     }
 
-    // Delete statement.
-
-    sqlite3_finalize(stmt);
-
-    // Close database.
-
-    sqlite3_close(db);
-
-    // Fill result.
+    // Order rows by channel.
 
-    data = DBDataset(begin_ts, end_ts,
-		     std::move(column_names),
-		     std::move(column_types),
-		     std::move(channels),
-		     std::move(values));
+    result.sortRows();
+    data = std::move(result);
 
     // Done.
 
@@ -735,7 +1671,7 @@ namespace lariov {
 	  log << names[col] << " = " << value << "\n";
 	}
 	else if(types[col] == "text" or types[col] == "boolean") {
-	  std::string value = dbrow.getStringData(col);
+	  std::string_view value = dbrow.getStringData(col);
 	  log << names[col] << " = " << value << "\n";
 	}
 	else {
@@ -848,15 +1784,6 @@ namespace lariov {
       }
     }
 
-    // Compare number of values.
-
-    if(data1.data().size() != data2.data().size()) {
-      mf::LogWarning("DBFolder") << "Values size mismatch " << data1.data().size()
-				 << " vs. " << data2.data().size()
-				 << "\n";
-      compare_ok = false;
-    }
-
     // Data rows.
     if(compare_ok) {
       for(size_t row=0; row<nrows1; ++row) {
@@ -891,8 +1818,8 @@ namespace lariov {
 	    }
 	  }
 	  else if(types1[col] == "text") {
-	    std::string value1 = dbrow2.getStringData(col);
-	    std::string value2 = dbrow2.getStringData(col);
+	    std::string_view value1 = dbrow1.getStringData(col);
+	    std::string_view value2 = dbrow2.getStringData(col);
 	    if(value1 != value2) {
 	      mf::LogWarning("DBFolder") << "Value mismatch " << value1 << " vs. " << value2 << "\n";
 	      compare_ok = false;
@@ -3,10 +3,25 @@
 
 #include "larevt/CalibrationDBI/IOVData/IOVTimeStamp.h"
 #include "larevt/CalibrationDBI/Interface/CalibrationDBIFwd.h"
+#include "larevt/CalibrationDBI/Providers/DBBundle.h"
 #include "larevt/CalibrationDBI/Providers/DBDataset.h"
+#include "larevt/CalibrationDBI/Providers/DBDatasetCache.h"
+#include "larevt/CalibrationDBI/Providers/DBDiskCache.h"
+#include "larevt/CalibrationDBI/Providers/DBFolderStats.h"
+#include "larevt/CalibrationDBI/Providers/DBSharedCache.h"
+#include "larevt/CalibrationDBI/Providers/DBTimeline.h"
+#include <chrono>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+struct sqlite3;
+struct sqlite3_stmt;
+
 namespace lariov {
 
   typedef void *Dataset;
@@ -15,6 +30,24 @@ namespace lariov {
   class DBFolder {
 
     public:
+
+      // Handle for a named column with value type T (long or double).
+      // Obtained from GetColumnHandle, which resolves the name once.
+      // Column layout is the same for all IOVs of a folder, so a handle
+      // stays usable after updates (it is re-resolved if the layout changes).
+
+      template<class T> class ColumnHandle {
+        public:
+          ColumnHandle() : fColumn(-1) {}
+          const std::string& Name() const {return fName;}
+          bool IsValid() const {return fColumn >= 0;}
+        private:
+          friend class DBFolder;
+          ColumnHandle(const std::string& name, int col) : fName(name), fColumn(col) {}
+          std::string fName;
+          int fColumn;
+      };
+
       DBFolder(const std::string& name, const std::string& url, const std::string& url2, 
 	       const std::string& tag = "", bool useqlite=false, bool testmode=false);
       virtual ~DBFolder();
@@ -25,15 +58,138 @@ namespace lariov {
       int GetNamedChannelData(DBChannelID_t channel, const std::string& name, std::string& data);
       //int GetNamedChannelData(DBChannelID_t channel, const std::string& name, std::vector<double>& data);
 
+      // Whole column access.
+      // Column data are aligned with Channels() (same row order).
+      // Views are valid until the next UpdateData.
+
+      template<class T> ColumnHandle<T> GetColumnHandle(const std::string& name) const;
+      template<class T> DBDataset::ColumnView<T> GetColumnData(const ColumnHandle<T>& handle) const;
+      const std::vector<DBChannelID_t>& Channels() const {return fCache->channels();}
+
       const std::string& URL() const {return fURL;}
       const std::string& FolderName() const {return fFolderName;}
       const std::string& Tag() const {return fTag;}
 
-      const IOVTimeStamp& CachedStart() const {return fCache.beginTime();}
-      const IOVTimeStamp& CachedEnd() const   {return fCache.endTime();}
+      const IOVTimeStamp& CachedStart() const {return fCache->beginTime();}
+      const IOVTimeStamp& CachedEnd() const   {return fCache->endTime();}
+
+      // Current dataset (remains valid after later updates).
+
+      std::shared_ptr<const DBDataset> CurrentDataset() const {return fCache;}
+
+      // Conditions access statistics of this folder (see DBFolderStats).
+      // Providers record their snapshot updates and lookups here too.
+
+      DBFolderStats& Stats() const {return *fStats;}
+
+      // Configure the in-memory dataset cache.
+      // Zero means unlimited.
+
+      void SetCacheSize(size_t n) {fDatasetCache.setMaxDatasets(n);}
+      void SetCacheMemoryLimit(size_t bytes) {fDatasetCache.setMaxBytes(bytes);}
+      const DBDatasetCache& DatasetCache() const {return fDatasetCache;}
+
+      // Configure the persistent on-disk dataset cache (http only).
+      // Empty directory disables the disk cache.
+
+      void SetDiskCacheDir(const std::string& dir);
+
+      // Read datasets from a conditions bundle file (see DBBundle), before
+      // any other source.  Empty path disables the bundle.  If the folder has
+      // no url and no sqlite database, the bundle is the only source, and it
+      // is an error if it does not contain the folder and tag.
+
+      void SetBundle(const std::string& path);
+
+      // Configure the node-wide shared memory dataset cache.
+      // Capacity is the number of datasets kept per folder and tag (0 = disabled),
+      // and max_bytes their maximum total size (0 = unlimited).
+      // Open ended datasets are shared for open_lifetime seconds.
+
+      void SetSharedCache(size_t capacity, size_t max_bytes, unsigned int open_lifetime);
+
+      // Enable background prefetching of the next IOV.
+
+      void SetPrefetch(bool prefetch) {fPrefetch = prefetch;}
+
+      // Convert libwda http datasets with at least this many rows in parallel
+      // (0 = never).  Compressed transfers are converted while they arrive.
+
+      void SetParallelParseRows(size_t n) {fParallelParseRows = n;}
+
+      // Fetch http datasets with libcurl, accepting compressed (gzip, deflate)
+      // responses, instead of libwda.  Responses are decompressed and converted
+      // while they arrive.
+
+      void SetCompressedTransfer(bool compressed) {fCompressed = compressed;}
+
+      // Keep the previous dataset at IOV changes, so that the rows that changed
+      // can be found (GetChangedRows).
+
+      void SetDeltaUpdates(bool delta);
+
+      // Rows of the current dataset that are new or differ from the previous
+      // dataset, and channels of the previous dataset that are no longer present.
+      // Returns false (and no rows) if there is no previous dataset to compare
+      // with, or if the columns differ, i.e. everything should be considered changed.
+
+      bool GetChangedRows(std::vector<size_t>& rows, std::vector<DBChannelID_t>& removed) const;
+
+      // Load the IOV begin times of the tag once (at the first IOV change, or
+      // at the first call of GetIOV or NextIOVBoundary), and resolve IOVs from
+      // this timeline.  The sqlite IOV query is then no longer needed, and http
+      // requests for closed IOVs ask for the IOV begin time, so that all events
+      // of an IOV share one url (and proxy or disk cache entry).
+      // If the timeline can not be loaded, IOVs are resolved as before.
+
+      void SetTimeline(bool timeline) {fUseTimeline = timeline;}
+
+      // Interval containing the specified time, according to the timeline.
+      // Returns false if there is no timeline, or if the time precedes the first IOV.
+
+      bool GetIOV(const IOVTimeStamp& ts, IOVTimeStamp& begin, IOVTimeStamp& end) const;
+
+      // First IOV boundary after the specified time, according to the timeline
+      // (MaxTimeStamp if there is none, or if there is no timeline).
+
+      IOVTimeStamp NextIOVBoundary(const IOVTimeStamp& ts) const;
+
+      // The timeline (nullptr if disabled or not available).
+
+      const DBTimeline* Timeline() const;
+
+      // Hedged requests and failover between the primary (url) and secondary
+      // (url2) servers.  If the primary has not answered within the specified
+      // percentile of its recent latencies (but at least min_delay seconds),
+      // the request is also sent to the secondary, and the first answer is used.
+
+      void SetHedging(bool hedge, double percentile, double min_delay);
+
+      // Skip a server for cooldown seconds after this many consecutive
+      // failures (0 = never skip).  Applies to hedged requests.
+
+      void SetCircuitBreaker(unsigned int failures, double cooldown);
+
+      // Fetch concurrently with the other folders at IOV changes (see DBFolderCoordinator).
+
+      void SetCoordinatedFetch(bool coordinated);
+
+      // Start fetching the dataset for the specified time in a worker thread,
+      // if this folder is in use and its current IOV does not contain the time.
+      // The dataset is picked up by the next UpdateData.
+
+      void StartFetch(const IOVTimeStamp& ts);
 
       bool UpdateData(DBTimeStamp_t raw_time);
 
+      // Load the datasets of all IOVs that overlap [raw_tmin, raw_tmax] (same
+      // time encoding as UpdateData) into the dataset cache, where they are
+      // pinned, so that UpdateData for times in this range never fetches.
+      // Failures are not fatal (the datasets will be fetched when needed).
+      // Returns the number of datasets loaded.
+
+      size_t Preload(DBTimeStamp_t raw_tmin, DBTimeStamp_t raw_tmax);
+
       void GetSQLiteData(int t, DBDataset& data) const;
 
       int GetChannelList( std::vector<DBChannelID_t>& channels ) const;
@@ -42,13 +198,40 @@ namespace lariov {
 
       bool CompareDataset(const DBDataset& data1, const DBDataset& data2) const;
 
+      // Check for, or create, the indexes used by the sqlite queries of
+      // a folder in a local .db file.  Return true if all indexes are present.
+
+      static bool EnsureSQLiteIndexes(const std::string& path, const std::string& folder, bool create);
+
     private:
 
       void GetRow(DBChannelID_t channel);
       size_t GetColumn(const std::string& name) const;
 
+      std::shared_ptr<DBDataset> FetchDataset(const IOVTimeStamp& ts) const;
+      std::shared_ptr<DBDataset> GetHTTPData(const std::string& url, const IOVTimeStamp& ts) const;
+      std::shared_ptr<DBDataset> GetHedgedHTTPData(const IOVTimeStamp& ts) const;
+      std::string DataURL(const std::string& url, const IOVTimeStamp& ts) const;
+      double HedgeDelay() const;
+      bool BreakerOpen(int i, std::chrono::steady_clock::time_point now) const;
+
+      struct HedgeState;
+      struct HedgeControl;
+      void StartHedgeRequest(const std::shared_ptr<HedgeState>& state, int i, const std::string& fullurl) const;
+      void RecordHedgeOutcome(int i, bool ok, double latency) const;
+
+      void LoadSQLiteTimeline(std::vector<DBTimeline::Entry>& entries) const;
+      void LoadHTTPTimeline(const std::string& url, std::vector<DBTimeline::Entry>& entries) const;
+
+      void StartPrefetch();
+      void CollectPrefetch(bool wait);
+
+      void OpenSQLite();
+      void CloseSQLite();
+      sqlite3_stmt* PrepareSQLite(const std::string& sql) const;
+
       bool IsValid(const IOVTimeStamp& time) const {
-        if (time >= fCache.beginTime() && time < fCache.endTime()) return true;
+        if (time >= fCache->beginTime() && time < fCache->endTime()) return true;
 	else return false;
       }
 
@@ -61,17 +244,94 @@ namespace lariov {
       bool        fTestMode;
       std::string fSQLitePath;
       int         fMaximumTimeout;
+      size_t      fParallelParseRows;
+      bool        fCompressed;
+      bool        fDeltaUpdates;
+      bool        fUseTimeline;
+
+      // Persistent sqlite connection and prepared queries.
+
+      mutable std::mutex       fSQLiteMutex;
+      sqlite3*                 fSQLiteDB;
+      sqlite3_stmt*            fIOVStmt;            // IOV resolution.
+      sqlite3_stmt*            fDataStmt;           // Data rows of one IOV.
+      sqlite3_stmt*            fCountStmt;          // Channels in tag up to a time.
+      mutable std::map<long, size_t> fSQLiteChannelCounts;  // Results of fCountStmt, by IOV begin time.
+      std::vector<int>         fSQLiteColumns;      // Relevant result columns of data query.
+      std::vector<std::string> fSQLiteColumnNames;  // Names of relevant columns.
+      std::vector<std::string> fSQLiteColumnTypes;  // Declared types of relevant columns ("" = unknown).
+
+      // Hedged requests and circuit breakers (index 0 = fURL, 1 = fURL2).
+
+      mutable std::mutex       fHTTPMutex;          // Protects the members below.
+      bool                     fHedge;
+      double                   fHedgePercentile;
+      double                   fHedgeMinDelay;      // Seconds.
+      unsigned int             fBreakerFailures;
+      double                   fBreakerCooldown;    // Seconds.
+      mutable std::deque<double> fLatencies;        // Recent primary latencies (seconds).
+      mutable unsigned int     fBreakerCount[2];    // Consecutive failures.
+      mutable std::chrono::steady_clock::time_point fBreakerOpenUntil[2];
+
+      // Hedged request threads, including abandoned ones, which still record
+      // their outcome while the folder exists.  The threads are detached and
+      // share this block with the folder, so that the destructor does not wait
+      // for them (compressed transfers are cancelled; libwda requests run until
+      // they end or time out).
+
+      std::shared_ptr<HedgeControl> fHedgeControl;
+
+      // IOV timeline (loaded once, then read only).
+
+      mutable std::mutex       fTimelineMutex;
+      mutable bool             fTimelineLoaded;     // Load attempted.
+      mutable DBTimeline       fTimeline;           // Empty if not available.
 
       // Database cache.
 
-      DBDataset fCache;
+      std::shared_ptr<const DBDataset> fCache;    // Current dataset.
+      std::shared_ptr<const DBDataset> fPrevious; // Previous dataset (delta updates).
+      DBDatasetCache fDatasetCache;                // Recently used datasets.
+      std::unique_ptr<DBDiskCache> fDiskCache;     // Persistent dataset cache.
+      std::unique_ptr<DBSharedCache> fSharedCache; // Node-wide dataset cache.
+      std::shared_ptr<const DBBundle> fBundle;     // Conditions bundle.
+      std::shared_ptr<DBFolderStats> fStats;       // Access statistics (shared with fetch threads).
 
       // Database row cache.
 
       int              fCachedRowNumber;
       DBChannelID_t    fCachedChannel;
       DBDataset::DBRow fCachedRow;
+
+      // Background prefetch of the next IOV.
+      // Declared last, so that a pending fetch completes before other members are destroyed.
+
+      bool             fPrefetch;
+      bool             fCoordinated;    // Registered with DBFolderCoordinator.
+      bool             fUsed;           // UpdateData has fetched data.
+      IOVTimeStamp     fPrefetchTime;
+      std::future<std::shared_ptr<DBDataset> > fPrefetchResult;
   };
+
+  // Resolve column handle.
+  // Throws if the column does not exist or does not have type T.
+
+  template<class T>
+  DBFolder::ColumnHandle<T> DBFolder::GetColumnHandle(const std::string& name) const {
+    size_t col = GetColumn(name);
+    fCache->getColumn<T>(col);
+    return ColumnHandle<T>(name, col);
+  }
+
+  // Get whole column.
+
+  template<class T>
+  DBDataset::ColumnView<T> DBFolder::GetColumnData(const ColumnHandle<T>& handle) const {
+    size_t col = handle.fColumn;
+    if(!handle.IsValid() || col >= fCache->ncols() || fCache->colNames()[col] != handle.fName)
+      col = GetColumn(handle.fName);
+    return fCache->getColumn<T>(col);
+  }
 }
 
 #endif
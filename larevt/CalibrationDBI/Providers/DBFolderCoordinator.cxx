@@ -0,0 +1,64 @@
+//=================================================================================
+//
+// Name: DBFolderCoordinator.cxx
+//
+// Purpose: Implementation for class DBFolderCoordinator.
+//
+//=================================================================================
+
+#include <algorithm>
+#include "DBFolderCoordinator.h"
+#include "DBFolder.h"
+#include "larevt/CalibrationDBI/IOVData/IOVDataError.h"
+#include "larevt/CalibrationDBI/IOVData/TimeStampDecoder.h"
+#include "messagefacility/MessageLogger/MessageLogger.h"
+
+// Constructor.
+
+lariov::DBFolderCoordinator::DBFolderCoordinator() :
+  fLastTime(0)
+{}
+
+// Process-wide instance.
+
+lariov::DBFolderCoordinator& lariov::DBFolderCoordinator::Instance()
+{
+  static DBFolderCoordinator instance;
+  return instance;
+}
+
+// Register folder.
+
+void lariov::DBFolderCoordinator::Register(DBFolder* folder)
+{
+  std::lock_guard<std::mutex> lock(fMutex);
+  if(std::find(fFolders.begin(), fFolders.end(), folder) == fFolders.end())
+    fFolders.push_back(folder);
+}
+
+// Unregister folder.
+
+void lariov::DBFolderCoordinator::Unregister(DBFolder* folder)
+{
+  std::lock_guard<std::mutex> lock(fMutex);
+  fFolders.erase(std::remove(fFolders.begin(), fFolders.end(), folder), fFolders.end());
+}
+
+// Announce new event time stamp.
+
+void lariov::DBFolderCoordinator::Update(DBTimeStamp_t raw_time)
+{
+  std::lock_guard<std::mutex> lock(fMutex);
+  if(raw_time == fLastTime || fFolders.empty())
+    return;
+  fLastTime = raw_time;
+
+  // Bad time stamps are reported when the folders are accessed.
+
+  try {
+    IOVTimeStamp ts = TimeStampDecoder::DecodeTimeStamp(raw_time);
+    for(DBFolder* folder : fFolders)
+      folder->StartFetch(ts);
+  }
+  catch(IOVDataError&) {}
+}
@@ -0,0 +1,73 @@
+#ifndef DBFOLDERCOORDINATOR_H
+#define DBFOLDERCOORDINATOR_H
+//=================================================================================
+//
+// Name: DBFolderCoordinator.h
+//
+// Purpose: Header for class DBFolderCoordinator.
+//          This class coordinates the fetching of all database folders of a
+//          process (channel status, pedestals, electronics calibration, PMT
+//          gains, ...) at IOV changes.
+//
+//          Folders that enable coordinated fetching register themselves here.
+//          When a provider announces a new event time stamp (Update), every
+//          registered folder that is in use, and whose current IOV does not
+//          contain the new time, starts fetching the new dataset in a worker
+//          thread.  All fetches run at the same time, so the stall at an IOV
+//          change is that of the slowest folder instead of the sum of all of
+//          them.
+//
+//          Providers still update lazily.  The fetched dataset is picked up
+//          by DBFolder::UpdateData the first time the folder is accessed.
+//          Folders that have never been accessed are not fetched.
+//
+//          Repeated announcements of the same time stamp (one per provider)
+//          are ignored.
+//
+// Data members:
+//
+// fMutex    - Protects the members below.
+// fFolders  - Registered folders.
+// fLastTime - Most recently announced time stamp.
+//
+//=================================================================================
+
+#include <mutex>
+#include <vector>
+#include "larevt/CalibrationDBI/Interface/CalibrationDBIFwd.h"
+
+namespace lariov
+{
+  class DBFolder;
+
+  class DBFolderCoordinator
+  {
+  public:
+
+    // Process-wide instance.
+
+    static DBFolderCoordinator& Instance();
+
+    // Register and unregister folders.
+
+    void Register(DBFolder* folder);
+    void Unregister(DBFolder* folder);
+
+    // Announce new event time stamp (raw time stamp, as for DBFolder::UpdateData).
+    // Starts fetches of expired folders that are in use.
+
+    void Update(DBTimeStamp_t raw_time);
+
+  private:
+
+    DBFolderCoordinator();
+
+    // Data members.
+
+    std::mutex fMutex;                 // Protects the members below.
+    std::vector<DBFolder*> fFolders;   // Registered folders.
+    DBTimeStamp_t fLastTime;           // Most recently announced time stamp.
+  };
+}
+
+#endif
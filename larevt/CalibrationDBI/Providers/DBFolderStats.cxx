@@ -0,0 +1,217 @@
+//=================================================================================
+//
+// Name: DBFolderStats.cxx
+//
+// Purpose: Implementation for class DBFolderStats.
+//
+//=================================================================================
+
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include "DBFolderStats.h"
+#include "messagefacility/MessageLogger/MessageLogger.h"
+
+namespace {
+
+  // Process-wide registry.
+
+  struct Registry
+  {
+    std::mutex fMutex;
+    std::vector<std::shared_ptr<lariov::DBFolderStats> > fStats;
+    std::string fJSONFile;
+    bool fJSONWritten = false;     // fJSONFile already written.
+  };
+
+  Registry& registry()
+  {
+    static Registry instance;
+    return instance;
+  }
+
+  uint64_t nanoseconds(double seconds)
+  {
+    return seconds > 0. ? uint64_t(seconds * 1.e9 + 0.5) : 0;
+  }
+
+  // Write a JSON string (folder and tag names only need minimal escaping).
+
+  void writeString(std::ostream& out, const std::string& s)
+  {
+    out << '"';
+    for(char c : s) {
+      if(c == '"' || c == '\\')
+	out << '\\' << c;
+      else if(static_cast<unsigned char>(c) < 0x20)
+	out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c)
+	    << std::dec << std::setfill(' ');
+      else
+	out << c;
+    }
+    out << '"';
+  }
+}
+
+// Create and register.
+
+std::shared_ptr<lariov::DBFolderStats> lariov::DBFolderStats::create(const std::string& folder,
+								     const std::string& tag)
+{
+  auto stats = std::make_shared<DBFolderStats>(folder, tag);
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.fMutex);
+  reg.fStats.push_back(stats);
+  return stats;
+}
+
+// Statistics of all folders.
+
+std::vector<std::shared_ptr<const lariov::DBFolderStats> > lariov::DBFolderStats::all()
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.fMutex);
+  return std::vector<std::shared_ptr<const DBFolderStats> >(reg.fStats.begin(), reg.fStats.end());
+}
+
+// Write all statistics as JSON.
+// Folders that were never used (e.g. replaced by reconfiguration) are skipped.
+
+void lariov::DBFolderStats::writeJSON(std::ostream& out)
+{
+  std::vector<std::shared_ptr<const DBFolderStats> > stats = all();
+  out << "{\n  \"folders\": [";
+  bool first = true;
+  for(const auto& folder_stats : stats) {
+    Counts c = folder_stats->counts();
+    if(c.iov_switches == 0 && c.fetches == 0 && c.fetch_errors == 0 && c.lookups == 0)
+      continue;
+    out << (first ? "\n    " : ",\n    ");
+    folder_stats->writeJSONObject(out);
+    first = false;
+  }
+  out << "\n  ]\n}\n";
+}
+
+// Set JSON file.
+
+void lariov::DBFolderStats::setJSONFile(const std::string& path)
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.fMutex);
+  if(path != reg.fJSONFile)
+    reg.fJSONWritten = false;
+  reg.fJSONFile = path;
+}
+
+// Write JSON file.  Every conditions service calls this at the end of the
+// job; only the first call writes.
+
+void lariov::DBFolderStats::writeJSONFile()
+{
+  std::string path;
+  {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.fMutex);
+    if(reg.fJSONWritten)
+      return;
+    path = reg.fJSONFile;
+    reg.fJSONWritten = !path.empty();
+  }
+  if(path.empty())
+    return;
+  std::ofstream out(path);
+  writeJSON(out);
+  if(!out)
+    mf::LogWarning("DBFolderStats") << "Could not write conditions access statistics to " << path << "\n";
+}
+
+// Constructor.
+
+lariov::DBFolderStats::DBFolderStats(const std::string& folder, const std::string& tag) :
+  fFolder(folder),
+  fTag(tag)
+{}
+
+// Copy counters.
+
+lariov::DBFolderStats::Counts lariov::DBFolderStats::counts() const
+{
+  Counts result;
+  result.iov_switches = fIOVSwitches;
+  result.memory_hits = fMemoryHits;
+  result.memory_misses = fMemoryMisses;
+  result.shared_hits = fSharedHits;
+  result.disk_hits = fDiskHits;
+  result.bundle_hits = fBundleHits;
+  result.fetches = fFetches;
+  result.fetch_errors = fFetchErrors;
+  result.bytes_received = fBytesReceived;
+  result.dataset_bytes = fDatasetBytes;
+  result.fetch_seconds = fFetchNanoseconds * 1.e-9;
+  result.parse_seconds = fParseNanoseconds * 1.e-9;
+  result.snapshot_updates = fSnapshotUpdates;
+  result.snapshot_rows = fSnapshotRows;
+  result.snapshot_seconds = fSnapshotNanoseconds * 1.e-9;
+  result.lookups = fLookups;
+  return result;
+}
+
+// Write one JSON object.
+
+void lariov::DBFolderStats::writeJSONObject(std::ostream& out) const
+{
+  Counts c = counts();
+  out << "{\"folder\": ";
+  writeString(out, fFolder);
+  out << ", \"tag\": ";
+  writeString(out, fTag);
+  out << ", \"iov_switches\": " << c.iov_switches
+      << ", \"memory_hits\": " << c.memory_hits
+      << ", \"memory_misses\": " << c.memory_misses
+      << ", \"shared_hits\": " << c.shared_hits
+      << ", \"disk_hits\": " << c.disk_hits
+      << ", \"bundle_hits\": " << c.bundle_hits
+      << ", \"fetches\": " << c.fetches
+      << ", \"fetch_errors\": " << c.fetch_errors
+      << ", \"bytes_received\": " << c.bytes_received
+      << ", \"dataset_bytes\": " << c.dataset_bytes
+      << ", \"fetch_seconds\": " << c.fetch_seconds
+      << ", \"parse_seconds\": " << c.parse_seconds
+      << ", \"snapshot_updates\": " << c.snapshot_updates
+      << ", \"snapshot_rows\": " << c.snapshot_rows
+      << ", \"snapshot_seconds\": " << c.snapshot_seconds
+      << ", \"lookups\": " << c.lookups << "}";
+}
+
+// Record one IOV change.
+
+void lariov::DBFolderStats::addIOVSwitch(bool memory_hit)
+{
+  ++fIOVSwitches;
+  if(memory_hit)
+    ++fMemoryHits;
+  else
+    ++fMemoryMisses;
+}
+
+// Record one successful fetch.
+
+void lariov::DBFolderStats::addFetch(double fetch_seconds, double parse_seconds,
+				     uint64_t bytes_received, uint64_t dataset_bytes)
+{
+  ++fFetches;
+  fFetchNanoseconds += nanoseconds(fetch_seconds);
+  fParseNanoseconds += nanoseconds(parse_seconds);
+  fBytesReceived += bytes_received;
+  fDatasetBytes += dataset_bytes;
+}
+
+// Record one snapshot update.
+
+void lariov::DBFolderStats::addSnapshotUpdate(clock_type::time_point start, uint64_t rows)
+{
+  ++fSnapshotUpdates;
+  fSnapshotRows += rows;
+  fSnapshotNanoseconds += nanoseconds(since(start));
+}
@@ -0,0 +1,162 @@
+#ifndef DBFOLDERSTATS_H
+#define DBFOLDERSTATS_H
+//=================================================================================
+//
+// Name: DBFolderStats.h
+//
+// Purpose: Header for class DBFolderStats.
+//          This class holds the conditions access counters and timers of one
+//          database folder: dataset fetches (count, bytes, fetch and parse
+//          wall time), cache hits and misses, IOV switches, provider snapshot
+//          updates, and channel lookups.
+//
+//          Counters are updated from the folder, its worker threads (prefetch,
+//          hedged requests) and the providers that use it, so all of them are
+//          atomic.  Use function counts to read a consistent enough copy.
+//
+//          Each DBFolder creates one DBFolderStats (function create), which is
+//          also kept in a process-wide registry, so that the statistics of all
+//          folders can be written as JSON (functions writeJSON and
+//          writeJSONFile), e.g. at the end of the job.  Statistics outlive
+//          their folder.
+//
+// Counters (struct Counts):
+//
+// iov_switches      - Number of IOV changes (UpdateData returned true).
+// memory_hits       - IOV changes served from the in-memory dataset cache
+//                     (including prefetched datasets).
+// memory_misses     - IOV changes that needed a dataset not in memory.
+// shared_hits       - Datasets found in the node-wide shared memory cache.
+// disk_hits         - Datasets found in the on-disk cache.
+// bundle_hits       - Datasets found in the conditions bundle.
+// fetches           - Datasets fetched from the server or sqlite database,
+//                     including prefetches and both answers of hedged requests.
+// fetch_errors      - Failed fetches.
+// bytes_received    - Response bytes received on the wire (compressed transfer
+//                     only; libwda does not report sizes).
+// dataset_bytes     - Memory used by the fetched datasets.
+// fetch_seconds     - Wall time of fetches (request and transfer).
+// parse_seconds     - Wall time of conversion of responses into datasets.
+// snapshot_updates  - Provider snapshot updates.
+// snapshot_rows     - Rows (re)loaded into provider snapshots.
+// snapshot_seconds  - Wall time of provider snapshot updates.
+// lookups           - Channel lookups (folder and providers).
+//
+//=================================================================================
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace lariov
+{
+  class DBFolderStats
+  {
+  public:
+
+    // Copy of the counters.
+
+    struct Counts
+    {
+      uint64_t iov_switches = 0;
+      uint64_t memory_hits = 0;
+      uint64_t memory_misses = 0;
+      uint64_t shared_hits = 0;
+      uint64_t disk_hits = 0;
+      uint64_t bundle_hits = 0;
+      uint64_t fetches = 0;
+      uint64_t fetch_errors = 0;
+      uint64_t bytes_received = 0;
+      uint64_t dataset_bytes = 0;
+      double fetch_seconds = 0.;
+      double parse_seconds = 0.;
+      uint64_t snapshot_updates = 0;
+      uint64_t snapshot_rows = 0;
+      double snapshot_seconds = 0.;
+      uint64_t lookups = 0;
+    };
+
+    typedef std::chrono::steady_clock clock_type;
+
+    // Create the statistics of a folder, and add them to the registry.
+
+    static std::shared_ptr<DBFolderStats> create(const std::string& folder, const std::string& tag);
+
+    // Statistics of all folders created so far.
+
+    static std::vector<std::shared_ptr<const DBFolderStats> > all();
+
+    // Write the statistics of all folders as JSON.
+
+    static void writeJSON(std::ostream& out);
+
+    // Set the file written by writeJSONFile ("" = none).
+
+    static void setJSONFile(const std::string& path);
+
+    // Write the statistics of all folders to the JSON file, if one is set.
+    // The file is written once; later calls do nothing until setJSONFile
+    // sets a different file.
+
+    static void writeJSONFile();
+
+    // Constructor (use create to register).
+
+    DBFolderStats(const std::string& folder, const std::string& tag);
+
+    // Accessors.
+
+    const std::string& folder() const {return fFolder;}
+    const std::string& tag() const {return fTag;}
+    Counts counts() const;
+
+    // Write these statistics as one JSON object.
+
+    void writeJSONObject(std::ostream& out) const;
+
+    // Recording (thread safe).
+
+    void addIOVSwitch(bool memory_hit);
+    void addSharedHit() {++fSharedHits;}
+    void addDiskHit() {++fDiskHits;}
+    void addBundleHit() {++fBundleHits;}
+    void addFetch(double fetch_seconds, double parse_seconds, uint64_t bytes_received, uint64_t dataset_bytes);
+    void addFetchError() {++fFetchErrors;}
+    void addSnapshotUpdate(clock_type::time_point start, uint64_t rows);
+    void addLookup() {fLookups.fetch_add(1, std::memory_order_relaxed);}
+
+    // Seconds since start.
+
+    static double since(clock_type::time_point start)
+      {return std::chrono::duration<double>(clock_type::now() - start).count();}
+
+  private:
+
+    // Data members.
+
+    std::string fFolder;
+    std::string fTag;
+    std::atomic<uint64_t> fIOVSwitches {0};
+    std::atomic<uint64_t> fMemoryHits {0};
+    std::atomic<uint64_t> fMemoryMisses {0};
+    std::atomic<uint64_t> fSharedHits {0};
+    std::atomic<uint64_t> fDiskHits {0};
+    std::atomic<uint64_t> fBundleHits {0};
+    std::atomic<uint64_t> fFetches {0};
+    std::atomic<uint64_t> fFetchErrors {0};
+    std::atomic<uint64_t> fBytesReceived {0};
+    std::atomic<uint64_t> fDatasetBytes {0};
+    std::atomic<uint64_t> fFetchNanoseconds {0};
+    std::atomic<uint64_t> fParseNanoseconds {0};
+    std::atomic<uint64_t> fSnapshotUpdates {0};
+    std::atomic<uint64_t> fSnapshotRows {0};
+    std::atomic<uint64_t> fSnapshotNanoseconds {0};
+    std::atomic<uint64_t> fLookups {0};
+  };
+}
+
+#endif
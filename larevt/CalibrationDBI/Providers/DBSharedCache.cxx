@@ -0,0 +1,392 @@
+//=================================================================================
+//
+// Name: DBSharedCache.cxx
+//
+// Purpose: Implementation for class DBSharedCache.
+//
+//=================================================================================
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "DBSharedCache.h"
+#include "messagefacility/MessageLogger/MessageLogger.h"
+
+namespace {
+
+  // Index layout.
+
+  const char kINDEX_MAGIC[8] = {'L', 'A', 'R', 'D', 'B', 'S', 'H', 'M'};
+  const std::uint32_t kINDEX_VERSION = 2;
+  const size_t kMAX_CAPACITY = 4096;
+
+  enum SlotState {kEmpty = 0, kWriting = 1, kReady = 2};
+
+  struct IndexHeader
+  {
+    char fMagic[8];                // kINDEX_MAGIC.
+    std::uint32_t fVersion;        // kINDEX_VERSION.
+    std::uint32_t fCapacity;       // Number of slots.
+    std::uint64_t fNextId;         // Next dataset id.
+  };
+
+  struct IndexSlot
+  {
+    std::uint32_t fState;          // SlotState.
+    std::uint32_t fBeginSubStamp;
+    std::uint64_t fBeginStamp;
+    std::uint64_t fEndStamp;
+    std::uint32_t fEndSubStamp;
+    std::uint32_t fReserved;
+    std::uint64_t fId;             // Dataset id.
+    std::int64_t fCreated;         // Publication time.
+    std::uint64_t fSize;           // Dataset size (bytes).
+  };
+
+  // 64-bit FNV-1a hash.
+
+  std::uint64_t hash(const std::string& s)
+  {
+    std::uint64_t h = 14695981039346656037ull;
+    for(unsigned char c : s) {
+      h ^= c;
+      h *= 1099511628211ull;
+    }
+    return h;
+  }
+
+  // Get the status of a shared memory object, and check that it belongs to
+  // this user.  Objects owned by anyone else are never used.
+
+  bool ownedStat(int fd, const std::string& name, struct stat& st)
+  {
+    if(fstat(fd, &st) != 0)
+      return false;
+    if(st.st_uid != geteuid()) {
+      mf::LogWarning("DBSharedCache") << "Ignoring shared memory object " << name
+				      << " owned by uid " << st.st_uid << "\n";
+      return false;
+    }
+    return true;
+  }
+
+  // Locked, mapped index.
+  // The lock is held for the lifetime of this object.
+
+  class SharedIndex
+  {
+  public:
+
+    // Open index for reading (shared lock), or open and if necessary create
+    // index for writing (exclusive lock).
+
+    SharedIndex(const std::string& name, bool write, size_t capacity) :
+      fFd(-1), fAddr(MAP_FAILED), fSize(0), fHeader(nullptr), fSlots(nullptr)
+    {
+      fFd = shm_open(name.c_str(), write ? O_RDWR | O_CREAT : O_RDONLY, 0600);
+      struct stat st;
+      if(fFd < 0 || !ownedStat(fFd, name, st) || flock(fFd, write ? LOCK_EX : LOCK_SH) != 0)
+	return;
+      if(fstat(fFd, &st) != 0)
+	return;
+      fSize = st.st_size;
+      if(fSize >= sizeof(IndexHeader)) {
+	fAddr = mmap(nullptr, fSize, write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fFd, 0);
+	if(fAddr != MAP_FAILED && check())
+	  return;
+      }
+
+      // Initialize new (or invalid) index.
+
+      if(!write)
+	return;
+      unmap();
+      fSize = sizeof(IndexHeader) + capacity * sizeof(IndexSlot);
+      if(ftruncate(fFd, fSize) != 0)
+	return;
+      fAddr = mmap(nullptr, fSize, PROT_READ | PROT_WRITE, MAP_SHARED, fFd, 0);
+      if(fAddr == MAP_FAILED)
+	return;
+      std::memset(fAddr, 0, fSize);
+      IndexHeader* header = static_cast<IndexHeader*>(fAddr);
+      std::memcpy(header->fMagic, kINDEX_MAGIC, sizeof(header->fMagic));
+      header->fVersion = kINDEX_VERSION;
+      header->fCapacity = capacity;
+      header->fNextId = 0;
+      check();
+    }
+
+    ~SharedIndex()
+    {
+      unmap();
+      if(fFd >= 0)
+	close(fFd);      // Also releases lock.
+    }
+
+    SharedIndex(const SharedIndex&) = delete;
+    SharedIndex& operator=(const SharedIndex&) = delete;
+
+    bool valid() const {return fHeader != nullptr;}
+    IndexHeader& header() {return *fHeader;}
+    IndexSlot& slot(size_t i) {return fSlots[i];}
+    size_t capacity() const {return fHeader->fCapacity;}
+
+  private:
+
+    // Validate mapped index.
+
+    bool check()
+    {
+      IndexHeader* header = static_cast<IndexHeader*>(fAddr);
+      if(std::memcmp(header->fMagic, kINDEX_MAGIC, sizeof(header->fMagic)) != 0 ||
+	 header->fVersion != kINDEX_VERSION || header->fCapacity == 0 ||
+	 header->fCapacity > kMAX_CAPACITY ||
+	 fSize != sizeof(IndexHeader) + header->fCapacity * sizeof(IndexSlot))
+	return false;
+      fHeader = header;
+      fSlots = reinterpret_cast<IndexSlot*>(header + 1);
+      return true;
+    }
+
+    void unmap()
+    {
+      if(fAddr != MAP_FAILED)
+	munmap(fAddr, fSize);
+      fAddr = MAP_FAILED;
+      fHeader = nullptr;
+      fSlots = nullptr;
+    }
+
+    int fFd;
+    void* fAddr;
+    size_t fSize;
+    IndexHeader* fHeader;
+    IndexSlot* fSlots;
+  };
+}
+
+// Constructor.
+
+lariov::DBSharedCache::DBSharedCache(const std::string& folder, const std::string& tag,
+				     const std::string& source, size_t capacity,
+				     size_t max_bytes, unsigned int open_lifetime) :
+  fFolder(folder),
+  fTag(tag),
+  fCapacity(std::min(std::max(capacity, size_t(1)), kMAX_CAPACITY)),
+  fMaxBytes(max_bytes),
+  fOpenLifetime(open_lifetime)
+{
+  char key[40];
+  std::snprintf(key, sizeof(key), "%lu_%016llx", static_cast<unsigned long>(geteuid()),
+		static_cast<unsigned long long>(hash(folder + '\0' + tag + '\0' + source)));
+  fPrefix = std::string("/lardb_") + key;
+}
+
+// Find and attach the dataset whose IOV contains the specified time.
+
+std::shared_ptr<lariov::DBDataset> lariov::DBSharedCache::find(const IOVTimeStamp& ts) const
+{
+  std::string name;
+  {
+    SharedIndex index(fPrefix + "_index", false, 0);
+    if(!index.valid())
+      return std::shared_ptr<DBDataset>();
+
+    // Use the most recently published match.
+
+    std::int64_t now = std::time(nullptr);
+    const IndexSlot* match = nullptr;
+    for(size_t i=0; i<index.capacity(); ++i) {
+      const IndexSlot& slot = index.slot(i);
+      if(slot.fState != kReady)
+	continue;
+      IOVTimeStamp begin(slot.fBeginStamp, slot.fBeginSubStamp);
+      IOVTimeStamp end(slot.fEndStamp, slot.fEndSubStamp);
+      if(ts < begin || !(ts < end))
+	continue;
+      if(end == IOVTimeStamp::MaxTimeStamp() && now - slot.fCreated >= std::int64_t(fOpenLifetime))
+	continue;
+      if(match == nullptr || slot.fCreated > match->fCreated)
+	match = &slot;
+    }
+    if(match == nullptr)
+      return std::shared_ptr<DBDataset>();
+    name = fPrefix + "_" + std::to_string(match->fId);
+  }
+  return attach(name);
+}
+
+// Publish dataset.
+
+std::shared_ptr<lariov::DBDataset> lariov::DBSharedCache::store(const DBDataset& data) const
+{
+  if(data.nrows() == 0)
+    return std::shared_ptr<DBDataset>();
+
+  // Serialize before taking the lock.
+
+  std::ostringstream out;
+  data.writeSnapshot(out, fFolder, fTag);
+  std::string snapshot = out.str();
+  if(fMaxBytes != 0 && snapshot.size() > fMaxBytes) {
+    mf::LogWarning("DBSharedCache") << "Dataset of " << snapshot.size() << " bytes exceeds the limit of "
+				    << fMaxBytes << " bytes of " << fPrefix << ", not published\n";
+    return std::shared_ptr<DBDataset>();
+  }
+
+  std::string name;
+  {
+    SharedIndex index(fPrefix + "_index", true, fCapacity);
+    if(!index.valid()) {
+      mf::LogWarning("DBSharedCache") << "Unable to open shared memory index " << fPrefix << "_index\n";
+      return std::shared_ptr<DBDataset>();
+    }
+
+    // Reclaim slots of crashed publishers, and replace datasets with the same
+    // begin time.  Use an existing identical dataset, if there is one.
+
+    std::int64_t now = std::time(nullptr);
+    for(size_t i=0; i<index.capacity(); ++i) {
+      IndexSlot& slot = index.slot(i);
+      IOVTimeStamp begin(slot.fBeginStamp, slot.fBeginSubStamp);
+      IOVTimeStamp end(slot.fEndStamp, slot.fEndSubStamp);
+      bool open_ended = end == IOVTimeStamp::MaxTimeStamp();
+      if(slot.fState == kReady && begin == data.beginTime() && end == data.endTime() &&
+	 (!open_ended || now - slot.fCreated < std::int64_t(fOpenLifetime))) {
+	name = fPrefix + "_" + std::to_string(slot.fId);
+	break;
+      }
+      if(slot.fState == kWriting || (slot.fState == kReady && begin == data.beginTime())) {
+	shm_unlink((fPrefix + "_" + std::to_string(slot.fId)).c_str());
+	slot.fState = kEmpty;
+      }
+    }
+
+    if(name.empty()) {
+
+      // Evict the oldest datasets (lowest ids) until there is a free slot and
+      // the new dataset fits in the byte limit.
+
+      IndexSlot* slot = nullptr;
+      std::vector<IndexSlot*> used;
+      size_t bytes = 0;
+      for(size_t i=0; i<index.capacity(); ++i) {
+	IndexSlot& s = index.slot(i);
+	if(s.fState == kEmpty) {
+	  if(slot == nullptr)
+	    slot = &s;
+	}
+	else {
+	  used.push_back(&s);
+	  bytes += s.fSize;
+	}
+      }
+      std::sort(used.begin(), used.end(),
+		[](const IndexSlot* a, const IndexSlot* b) {return a->fId < b->fId;});
+      for(IndexSlot* s : used) {
+	if(slot != nullptr && (fMaxBytes == 0 || bytes + snapshot.size() <= fMaxBytes))
+	  break;
+	shm_unlink((fPrefix + "_" + std::to_string(s->fId)).c_str());
+	s->fState = kEmpty;
+	bytes -= s->fSize;
+	if(slot == nullptr)
+	  slot = s;
+      }
+      slot->fState = kWriting;
+      slot->fId = index.header().fNextId++;
+      slot->fBeginStamp = data.beginTime().Stamp();
+      slot->fBeginSubStamp = data.beginTime().SubStamp();
+      slot->fEndStamp = data.endTime().Stamp();
+      slot->fEndSubStamp = data.endTime().SubStamp();
+      slot->fCreated = now;
+      slot->fSize = snapshot.size();
+      name = fPrefix + "_" + std::to_string(slot->fId);
+
+      // Write dataset.
+
+      shm_unlink(name.c_str());
+      int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+      size_t written = 0;
+      if(fd >= 0) {
+	while(written < snapshot.size()) {
+	  ssize_t n = write(fd, snapshot.data() + written, snapshot.size() - written);
+	  if(n < 0 && errno == EINTR)
+	    continue;
+	  if(n <= 0)
+	    break;
+	  written += n;
+	}
+	close(fd);
+      }
+      if(written != snapshot.size()) {
+	mf::LogWarning("DBSharedCache") << "Unable to write shared memory dataset " << name << "\n";
+	shm_unlink(name.c_str());
+	slot->fState = kEmpty;
+	return std::shared_ptr<DBDataset>();
+      }
+      slot->fState = kReady;
+    }
+  }
+  return attach(name);
+}
+
+// Attach one published dataset.
+
+std::shared_ptr<lariov::DBDataset> lariov::DBSharedCache::attach(const std::string& name) const
+{
+  std::shared_ptr<DBDataset> result;
+
+  // The dataset may have been evicted since the index was read.
+
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if(fd < 0)
+    return result;
+  struct stat st;
+  void* addr = MAP_FAILED;
+  size_t size = 0;
+  if(ownedStat(fd, name, st) && st.st_size > 0) {
+    size = st.st_size;
+    addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if(addr == MAP_FAILED)
+    return result;
+  std::shared_ptr<const void> mapping(addr, [size](const void* p) {
+      munmap(const_cast<void*>(p), size);});
+
+  result = std::make_shared<DBDataset>();
+  std::string folder;
+  std::string tag;
+  if(!result->attachSnapshot(mapping, static_cast<const char*>(addr), size, &folder, &tag) ||
+     folder != fFolder || tag != fTag) {
+    mf::LogWarning("DBSharedCache") << "Ignoring invalid shared memory dataset " << name << "\n";
+    result.reset();
+  }
+  return result;
+}
+
+// Unlink all published datasets and the index.
+
+void lariov::DBSharedCache::clear() const
+{
+  SharedIndex index(fPrefix + "_index", true, fCapacity);
+  if(index.valid()) {
+    for(size_t i=0; i<index.capacity(); ++i) {
+      IndexSlot& slot = index.slot(i);
+      if(slot.fState != kEmpty)
+	shm_unlink((fPrefix + "_" + std::to_string(slot.fId)).c_str());
+      slot.fState = kEmpty;
+    }
+  }
+  shm_unlink((fPrefix + "_index").c_str());
+}
@@ -0,0 +1,118 @@
+#ifndef DBSHAREDCACHE_H
+#define DBSHAREDCACHE_H
+//=================================================================================
+//
+// Name: DBSharedCache.h
+//
+// Purpose: Header for class DBSharedCache.
+//          This class implements a node-wide cache of parsed DBDatasets in POSIX
+//          shared memory, for one database folder, tag and source (url or sqlite
+//          file).  Concurrent jobs on the same node publish datasets into the
+//          cache, and attach to datasets published by other jobs read-only,
+//          instead of each fetching and holding a private copy.
+//
+//          Each dataset is stored as a DBDataset snapshot (see DBDataset.h) in
+//          its own shared memory object,
+//
+//            /lardb_<uid>_<key>_<id>
+//
+//          where <uid> is the effective user id, <key> is a hash of folder, tag
+//          and source, and <id> is a serial number.  Datasets are located
+//          through an index object,
+//
+//            /lardb_<uid>_<key>_index
+//
+//          which contains a fixed size table of IOVs and ids.  The index is
+//          protected by flock.  Publishing holds the exclusive lock while the
+//          dataset is written, so readers never see partially written datasets.
+//          A slot left in the writing state by a crashed job is reclaimed by the
+//          next publisher.
+//
+//          Each user has a separate cache.  Objects are created with mode 0600,
+//          and objects owned by another user are never used (they could have
+//          been planted under a predictable name).
+//
+//          When the index is full, or the published datasets would exceed the
+//          byte limit (if any), the oldest datasets are unlinked.  Jobs that are
+//          attached to them keep their mappings until they release them.
+//          Datasets larger than the byte limit are not published.
+//
+//          Datasets with an open ended IOV are used for a limited time after
+//          they are published, because the IOV may be closed by a later
+//          database update.
+//
+//          Shared memory objects outlive the jobs that created them, so that
+//          later jobs can use them too.  Their size is bounded by the capacity
+//          and byte limit of the cache.  They are removed when the node reboots,
+//          by clear(), or by hand (/dev/shm/lardb_<uid>_* on Linux).
+//
+//          All errors are non-fatal.  A cache that can not be used simply
+//          behaves as if it were empty.
+//
+// Data members:
+//
+// fFolder       - Folder name.
+// fTag          - Tag.
+// fPrefix       - Shared memory object name prefix (/lardb_<uid>_<key>).
+// fCapacity     - Number of index slots (used when the index is created).
+// fMaxBytes     - Maximum total size of published datasets (bytes, 0 = unlimited).
+// fOpenLifetime - Lifetime of open ended datasets (seconds).
+//
+//=================================================================================
+
+#include <memory>
+#include <string>
+#include "larevt/CalibrationDBI/IOVData/IOVTimeStamp.h"
+#include "larevt/CalibrationDBI/Providers/DBDataset.h"
+
+namespace lariov
+{
+  class DBSharedCache
+  {
+  public:
+
+    // Constructor.
+
+    DBSharedCache(const std::string& folder, const std::string& tag, const std::string& source,
+		  size_t capacity, size_t max_bytes, unsigned int open_lifetime);
+
+    // Simple accessors.
+
+    const std::string& prefix() const {return fPrefix;}
+    size_t capacity() const {return fCapacity;}
+    size_t maxBytes() const {return fMaxBytes;}
+
+    // Find and attach the dataset whose IOV contains the specified time.
+    // Return a null pointer if there is no such dataset.
+
+    std::shared_ptr<DBDataset> find(const IOVTimeStamp& ts) const;
+
+    // Publish dataset.
+    // Return the published dataset, attached to shared memory, or a null
+    // pointer if the dataset was not published.
+
+    std::shared_ptr<DBDataset> store(const DBDataset& data) const;
+
+    // Unlink all published datasets and the index.
+    // Jobs that are attached to datasets keep their mappings.
+
+    void clear() const;
+
+  private:
+
+    // Attach one published dataset.
+
+    std::shared_ptr<DBDataset> attach(const std::string& name) const;
+
+    // Data members.
+
+    std::string fFolder;          // Folder name.
+    std::string fTag;             // Tag.
+    std::string fPrefix;          // Shared memory name prefix.
+    size_t fCapacity;             // Number of index slots.
+    size_t fMaxBytes;             // Maximum total size of published datasets (0 = unlimited).
+    unsigned int fOpenLifetime;   // Lifetime of open ended datasets (seconds).
+  };
+}
+
+#endif
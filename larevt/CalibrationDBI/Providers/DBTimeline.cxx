@@ -0,0 +1,53 @@
+//=================================================================================
+//
+// Name: DBTimeline.cxx
+//
+// Purpose: Implementation for class DBTimeline.
+//
+//=================================================================================
+
+#include <algorithm>
+#include "DBTimeline.h"
+
+// Replace the contents.
+
+void lariov::DBTimeline::assign(std::vector<Entry> entries)
+{
+  std::stable_sort(entries.begin(), entries.end(),
+		   [](const Entry& a, const Entry& b) {return a.begin < b.begin;});
+  fEntries = std::move(entries);
+  fBoundaries.clear();
+  for(const Entry& entry : fEntries) {
+    if(fBoundaries.empty() || fBoundaries.back() != entry.begin)
+      fBoundaries.push_back(entry.begin);
+  }
+}
+
+// Number of IOVs that begin at or before the specified time.
+
+size_t lariov::DBTimeline::countUntil(const IOVTimeStamp& ts) const
+{
+  auto it = std::upper_bound(fEntries.begin(), fEntries.end(), ts,
+			     [](const IOVTimeStamp& t, const Entry& e) {return t < e.begin;});
+  return it - fEntries.begin();
+}
+
+// Find the interval containing the specified time.
+
+bool lariov::DBTimeline::find(const IOVTimeStamp& ts, IOVTimeStamp& begin, IOVTimeStamp& end) const
+{
+  auto it = std::upper_bound(fBoundaries.begin(), fBoundaries.end(), ts);
+  if(it == fBoundaries.begin())
+    return false;
+  end = (it == fBoundaries.end() ? IOVTimeStamp::MaxTimeStamp() : *it);
+  begin = *(it - 1);
+  return true;
+}
+
+// First boundary after the specified time.
+
+lariov::IOVTimeStamp lariov::DBTimeline::nextBoundary(const IOVTimeStamp& ts) const
+{
+  auto it = std::upper_bound(fBoundaries.begin(), fBoundaries.end(), ts);
+  return it == fBoundaries.end() ? IOVTimeStamp::MaxTimeStamp() : *it;
+}
@@ -0,0 +1,71 @@
+#ifndef DBTIMELINE_H
+#define DBTIMELINE_H
+//=================================================================================
+//
+// Name: DBTimeline.h
+//
+// Purpose: Header for class DBTimeline.
+//          This class holds the IOV begin times of one folder and tag, sorted,
+//          so that the IOV containing a time, and the next IOV boundary, can be
+//          found with a binary search instead of a database query.
+//
+//          Each IOV (entry) has a begin time and, for sqlite databases, an
+//          iov id.  Several IOVs may begin at the same time.  An interval ends
+//          where the next distinct begin time starts; the last interval is open
+//          ended.
+//
+//=================================================================================
+
+#include "larevt/CalibrationDBI/IOVData/IOVTimeStamp.h"
+#include <cstddef>
+#include <vector>
+
+namespace lariov
+{
+  class DBTimeline
+  {
+  public:
+
+    // One IOV.
+
+    struct Entry
+    {
+      Entry(const IOVTimeStamp& b, long id = -1) : begin(b), iov_id(id) {}
+      IOVTimeStamp begin;
+      long iov_id;            // -1 = unknown (http).
+    };
+
+    // Replace the contents (entries need not be sorted).
+
+    void assign(std::vector<Entry> entries);
+
+    // Accessors.
+
+    bool empty() const {return fEntries.empty();}
+    size_t size() const {return fEntries.size();}          // Number of IOVs.
+    size_t intervals() const {return fBoundaries.size();}  // Number of distinct begin times.
+    const std::vector<Entry>& entries() const {return fEntries;}
+    const std::vector<IOVTimeStamp>& boundaries() const {return fBoundaries;}
+
+    // Number of IOVs that begin at or before the specified time.
+    // These are entries()[0] .. entries()[n-1], oldest first.
+
+    size_t countUntil(const IOVTimeStamp& ts) const;
+
+    // Find the interval containing the specified time.
+    // Returns false if the time precedes the first IOV.
+
+    bool find(const IOVTimeStamp& ts, IOVTimeStamp& begin, IOVTimeStamp& end) const;
+
+    // First IOV boundary after the specified time (MaxTimeStamp if none).
+
+    IOVTimeStamp nextBoundary(const IOVTimeStamp& ts) const;
+
+  private:
+
+    std::vector<Entry> fEntries;            // Sorted by begin time.
+    std::vector<IOVTimeStamp> fBoundaries;  // Distinct begin times, sorted.
+  };
+}
+
+#endif
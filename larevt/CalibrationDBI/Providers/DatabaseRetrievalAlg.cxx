@@ -1,3 +1,4 @@
+#include "cetlib_except/exception.h"
 #include "fhiclcpp/ParameterSet.h"
 #include "larevt/CalibrationDBI/Providers/DBFolder.h"
 
@@ -16,6 +17,43 @@ namespace lariov {
     std::string tag        = p.get<std::string>("DBTag", "");
     bool usesqlite         = p.get<bool>("UseSQLite", false);
     bool testmode          = p.get<bool>("TestMode", false);
+    size_t cachesize       = p.get<size_t>("CacheSize", 1);
+    size_t cachememory     = p.get<size_t>("CacheMemoryLimitMB", 0);
+    std::string cachedir   = p.get<std::string>("DiskCacheDir", "");
+    std::string bundle     = p.get<std::string>("BundleFile", "");
+    bool prefetch          = p.get<bool>("Prefetch", false);
+    size_t parallelrows    = p.get<size_t>("ParallelParseRows", 0);
+    bool compressed        = p.get<bool>("CompressedTransfer", false);
+    size_t sharedsize      = p.get<size_t>("SharedCacheSize", 0);
+    size_t sharedmemory    = p.get<size_t>("SharedCacheMemoryLimitMB", 256);
+    unsigned int sharedlifetime = p.get<unsigned int>("SharedCacheOpenIOVLifetime", 600);
+    bool coordinated       = p.get<bool>("CoordinatedFetch", false);
+    bool delta             = p.get<bool>("DeltaUpdates", false);
+    bool timeline          = p.get<bool>("IOVTimeline", false);
+    std::string statsfile  = p.get<std::string>("StatsFile", "");
+    bool hedge             = p.get<bool>("HedgeRequests", false);
+    double hedgepercentile = p.get<double>("HedgePercentile", 0.95);
+    double hedgemindelay   = p.get<double>("HedgeMinDelay", 0.);
+    unsigned int breakerfailures = p.get<unsigned int>("CircuitBreakerFailures", 3);
+    double breakercooldown = p.get<double>("CircuitBreakerCooldown", 60.);
+    std::vector<DBTimeStamp_t> preload = p.get<std::vector<DBTimeStamp_t> >("PreloadTimeRange", {});
+    if (!preload.empty() && preload.size() != 2)
+      throw cet::exception("DatabaseRetrievalAlg") << "PreloadTimeRange must be empty or [tmin, tmax].";
     fFolder.reset(new DBFolder(foldername, url, url2, tag, usesqlite, testmode));
+    fFolder->SetCacheSize(cachesize);
+    fFolder->SetCacheMemoryLimit(cachememory * 1024 * 1024);
+    fFolder->SetDiskCacheDir(cachedir);
+    fFolder->SetBundle(bundle);
+    fFolder->SetPrefetch(prefetch);
+    fFolder->SetParallelParseRows(parallelrows);
+    fFolder->SetCompressedTransfer(compressed);
+    fFolder->SetSharedCache(sharedsize, sharedmemory * 1024 * 1024, sharedlifetime);
+    fFolder->SetCoordinatedFetch(coordinated);
+    fFolder->SetDeltaUpdates(delta);
+    fFolder->SetTimeline(timeline);
+    if (statsfile != "") DBFolderStats::setJSONFile(statsfile);
+    fFolder->SetHedging(hedge, hedgepercentile, hedgemindelay);
+    fFolder->SetCircuitBreaker(breakerfailures, breakercooldown);
+    if (!preload.empty()) fFolder->Preload(preload[0], preload[1]);
   }
 }
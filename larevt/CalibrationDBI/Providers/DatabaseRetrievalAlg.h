@@ -15,7 +15,10 @@
 #define DATABASERETRIEVALALG_H
 
 #include <memory>
+#include <numeric>
+#include <vector>
 #include "DBFolder.h"
+#include "larevt/CalibrationDBI/IOVData/Snapshot.h"
 
 namespace fhicl { class ParameterSet; }
 
@@ -53,6 +56,11 @@ namespace lariov {
         return fFolder->UpdateData(ts);
       }
 
+      /// Load all IOVs overlapping [tmin, tmax] up front (see DBFolder::Preload)
+      size_t Preload(DBTimeStamp_t tmin, DBTimeStamp_t tmax) {
+        return fFolder->Preload(tmin, tmax);
+      }
+
       /// Get connection information
       const std::string& URL() const {return fFolder->URL();}
       const std::string& FolderName() const {return fFolder->FolderName();}
@@ -65,6 +73,28 @@ namespace lariov {
 
     protected:
 
+      /// Prepare a snapshot for the current folder data, and return the folder
+      /// rows to be (re)loaded into it.  With delta updates (DeltaUpdates),
+      /// channels no longer in the folder are removed and only new or changed
+      /// rows are returned; otherwise the snapshot is cleared and all rows
+      /// are returned.
+      template <class T>
+      std::vector<size_t> PrepareSnapshot(Snapshot<T>& data) const {
+        std::vector<size_t> rows;
+        std::vector<DBChannelID_t> removed;
+        if (fFolder->GetChangedRows(rows, removed)) {
+          data.ClearChanges();
+          for (DBChannelID_t ch: removed) data.RemoveRow(ch);
+        }
+        else {
+          data.Clear();
+          rows.resize(fFolder->Channels().size());
+          std::iota(rows.begin(), rows.end(), 0);
+        }
+        data.SetIoV(this->Begin(), this->End());
+        return rows;
+      }
+
       std::unique_ptr<DBFolder> fFolder;
   };
 }
@@ -11,6 +11,7 @@
 #include "larevt/CalibrationDBI/IOVData/IOVDataError.h"      // for IOVDataE...
 #include "larevt/CalibrationDBI/IOVData/IOVTimeStamp.h"      // for IOVTimeS...
 #include "larevt/CalibrationDBI/Providers/DBFolder.h"        // for DBFolder
+#include "larevt/CalibrationDBI/Providers/DBFolderCoordinator.h"
 #include "messagefacility/MessageLogger/MessageLogger.h"
 
 //C/C++
@@ -44,6 +45,7 @@ namespace lariov {
 
     this->DatabaseRetrievalAlg::Reconfigure(p.get<fhicl::ParameterSet>("DatabaseRetrievalAlg"));
     fData.Clear();
+    fArrays.Fill(fData);
     IOVTimeStamp tmp = IOVTimeStamp::MaxTimeStamp();
     tmp.SetStamp(tmp.Stamp()-1, tmp.SubStamp());
     fData.SetIoV(tmp, IOVTimeStamp::MaxTimeStamp());
@@ -87,14 +89,16 @@ namespace lariov {
 
         if (geo->SignalType(ch) == geo::kCollection) {
 	  DefaultColl.SetChannel(ch);
-	  fData.AddOrReplaceRow(DefaultColl);
+	  fData.AppendRow(DefaultColl);
 	}
 	else if (geo->SignalType(ch) == geo::kInduction) {
 	  DefaultInd.SetChannel(ch);
-	  fData.AddOrReplaceRow(DefaultInd);
+	  fData.AppendRow(DefaultInd);
 	}
 	else throw IOVDataError("Wire type is not collection or induction!");
       }
+      fData.Finalize();
+      fArrays.Fill(fData);
     }
     else if (fDataSource == DataSource::File) {
       cet::search_path sp("FW_SEARCH_PATH");
@@ -127,8 +131,10 @@ namespace lariov {
         dp.SetPedMeanErr(ped_err);
         dp.SetPedRms(rms);
         dp.SetPedRmsErr(rms_err);
-	fData.AddOrReplaceRow(dp);
+	fData.AppendRow(dp);
       }
+      fData.Finalize();
+      fArrays.Fill(fData);
     } // if source from file
     else {
       std::cout << "Using pedestals from conditions database\n";
@@ -141,6 +147,7 @@ namespace lariov {
   void DetPedestalRetrievalAlg::UpdateTimeStamp(DBTimeStamp_t ts) {
     mf::LogInfo("DetPedestalRetrievalAlg") << "DetPedestalRetrievalAlg::UpdateTimeStamp called.";
     fEventTimeStamp = ts;
+    DBFolderCoordinator::Instance().Update(ts);
   }
 
   // Maybe update method cached data (public non-const version).
@@ -173,28 +180,30 @@ namespace lariov {
       result = const_cast<DetPedestalRetrievalAlg*>(this)->UpdateFolder(ts);
       if(result) {
 
-	//DBFolder was updated, so now update the Snapshot
-	fData.Clear();
-	fData.SetIoV(this->Begin(), this->End());
-
-	std::vector<DBChannelID_t> channels;
-	fFolder->GetChannelList(channels);
-	for (auto it = channels.begin(); it != channels.end(); ++it) {
-
-	  double mean, mean_err, rms, rms_err;
-	  fFolder->GetNamedChannelData(*it, "mean",     mean);
-	  fFolder->GetNamedChannelData(*it, "mean_err", mean_err);
-	  fFolder->GetNamedChannelData(*it, "rms",      rms);
-	  fFolder->GetNamedChannelData(*it, "rms_err",  rms_err);
-
-	  DetPedestal pd(*it);
-	  pd.SetPedMean( (float)mean );
-	  pd.SetPedMeanErr( (float)mean_err );
-	  pd.SetPedRms( (float)rms );
-	  pd.SetPedRmsErr( (float)rms_err );
-
-	  fData.AddOrReplaceRow(pd);
+	//DBFolder was updated, so now update the Snapshot (changed rows only with delta updates)
+	auto start = DBFolderStats::clock_type::now();
+	std::vector<size_t> rows = PrepareSnapshot(fData);
+
+	//Fetch whole columns, aligned with the channel list
+	const std::vector<DBChannelID_t>& channels = fFolder->Channels();
+	auto mean     = fFolder->GetColumnData(fFolder->GetColumnHandle<double>("mean"));
+	auto mean_err = fFolder->GetColumnData(fFolder->GetColumnHandle<double>("mean_err"));
+	auto rms      = fFolder->GetColumnData(fFolder->GetColumnHandle<double>("rms"));
+	auto rms_err  = fFolder->GetColumnData(fFolder->GetColumnHandle<double>("rms_err"));
+	fData.Reserve(rows.size());
+	for (size_t row: rows) {
+
+	  DetPedestal pd(channels[row]);
+	  pd.SetPedMean( (float)mean[row] );
+	  pd.SetPedMeanErr( (float)mean_err[row] );
+	  pd.SetPedRms( (float)rms[row] );
+	  pd.SetPedRmsErr( (float)rms_err[row] );
+
+	  fData.AppendRow(pd);
 	}
+	fData.Finalize();
+	fArrays.Fill(fData);
+	fFolder->Stats().addSnapshotUpdate(start, rows.size());
       }
     }
 
@@ -204,9 +213,20 @@ namespace lariov {
 
   const DetPedestal& DetPedestalRetrievalAlg::Pedestal(DBChannelID_t ch) const {
     DBUpdate();
+    fFolder->Stats().addLookup();
     return fData.GetRow(ch);
   }
 
+  const std::vector<unsigned int>& DetPedestalRetrievalAlg::ChangedChannels() const {
+    DBUpdate();
+    return fData.ChangedChannels();
+  }
+
+  bool DetPedestalRetrievalAlg::AllChannelsChanged() const {
+    DBUpdate();
+    return fData.AllChanged();
+  }
+
   float DetPedestalRetrievalAlg::PedMean(DBChannelID_t ch) const {
     return this->Pedestal(ch).PedMean();
   }
@@ -223,6 +243,25 @@ namespace lariov {
     return this->Pedestal(ch).PedRmsErr();
   }
 
+  const DetPedestalArrays& DetPedestalRetrievalAlg::PedestalArrays() const {
+    DBUpdate();
+    return fArrays;
+  }
+
+  void DetPedestalRetrievalAlg::SubtractPedestals(DBChannelID_t first_ch, size_t n_channels,
+                                                  size_t n_ticks, short const* adc, float* out) const {
+    DBUpdate();
+    fFolder->Stats().addLookup();
+    if (fArrays.Valid()) {
+      fArrays.SubtractPedestals(first_ch, n_channels, n_ticks, adc, out);
+      return;
+    }
+    for (size_t c = 0; c < n_channels; ++c) {
+      DetPedestalArrays::Subtract(adc + c * n_ticks, fData.GetRow(first_ch + c).PedMean(),
+                                  n_ticks, out + c * n_ticks);
+    }
+  }
+
 
 
 }//end namespace lariov
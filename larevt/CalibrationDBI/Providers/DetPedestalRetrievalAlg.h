@@ -19,6 +19,7 @@
 
 // LArSoft libraries
 #include "larevt/CalibrationDBI/IOVData/DetPedestal.h"
+#include "larevt/CalibrationDBI/IOVData/DetPedestalArrays.h"
 #include "larevt/CalibrationDBI/IOVData/Snapshot.h"
 #include "larevt/CalibrationDBI/IOVData/IOVDataConstants.h"
 #include "larevt/CalibrationDBI/Interface/CalibrationDBIFwd.h"
@@ -75,11 +76,24 @@ namespace lariov {
 
       /// Retrieve pedestal information
       const DetPedestal& Pedestal(DBChannelID_t ch) const;
+
+      /// Channels changed at the last IOV change (all loaded channels if
+      /// AllChannelsChanged(); see DeltaUpdates)
+      const std::vector<unsigned int>& ChangedChannels() const;
+      bool AllChannelsChanged() const;
       float PedMean(DBChannelID_t ch) const override;
       float PedRms(DBChannelID_t ch) const override;
       float PedMeanErr(DBChannelID_t ch) const override;
       float PedRmsErr(DBChannelID_t ch) const override;
 
+      /// Pedestal means and RMS as aligned arrays indexed by channel
+      /// (invalid for sparse channel sets; see DetPedestalArrays)
+      const DetPedestalArrays& PedestalArrays() const;
+
+      /// Batch pedestal subtraction with SIMD (see DetPedestalProvider)
+      void SubtractPedestals(DBChannelID_t first_ch, size_t n_channels, size_t n_ticks,
+                             short const* adc, float* out) const override;
+
       //hardcoded information about database folder - useful for debugging cross checks
       static constexpr unsigned int NCOLUMNS = 5;
       static constexpr const char* FIELD_NAMES[NCOLUMNS]
@@ -101,6 +115,7 @@ namespace lariov {
 
       DataSource::ds fDataSource;
       mutable Snapshot<DetPedestal> fData;
+      mutable DetPedestalArrays fArrays;        // Filled with fData.
   };
 }//end namespace lariov
 
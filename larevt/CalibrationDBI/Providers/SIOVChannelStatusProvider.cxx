@@ -15,6 +15,7 @@
 #include "larcore/Geometry/Geometry.h"
 #include "larevt/CalibrationDBI/IOVData/IOVDataConstants.h"
 #include "larevt/CalibrationDBI/Providers/DBFolder.h"
+#include "larevt/CalibrationDBI/Providers/DBFolderCoordinator.h"
 #include "messagefacility/MessageLogger/MessageLogger.h"
 
 // C/C++ standard libraries
@@ -63,8 +64,9 @@ namespace lariov {
 
 	cs.SetChannel(ch);
 	cs.SetStatus( ChannelStatus::GetStatusFromInt(status) );
-	fData.AddOrReplaceRow(cs);
+	fData.AppendRow(cs);
       }
+      fData.Finalize();
     } // if source from file
     else {
       std::cout << "Using channel statuses from conditions database\n";
@@ -77,6 +79,7 @@ namespace lariov {
     mf::LogInfo("SIOVChannelStatusProvider") << "SIOVChannelStatusProvider::UpdateTimeStamp called.";
     fNewNoisy.Clear();
     fEventTimeStamp = ts;
+    DBFolderCoordinator::Instance().Update(ts);
   }
 
   // Maybe update method cached data (public non-const version).
@@ -110,22 +113,23 @@ namespace lariov {
 
       result = const_cast<SIOVChannelStatusProvider*>(this)->UpdateFolder(ts);
       if(result) {
-	//DBFolder was updated, so now update the Snapshot
-	fData.Clear();
-	fData.SetIoV(this->Begin(), this->End());
+	//DBFolder was updated, so now update the Snapshot (changed rows only with delta updates)
+	auto start = DBFolderStats::clock_type::now();
+	std::vector<size_t> rows = PrepareSnapshot(fData);
 
-	std::vector<DBChannelID_t> channels;
-	fFolder->GetChannelList(channels);
-	for (auto it = channels.begin(); it != channels.end(); ++it) {
+	//Fetch whole column, aligned with the channel list
+	const std::vector<DBChannelID_t>& channels = fFolder->Channels();
+	auto status = fFolder->GetColumnData(fFolder->GetColumnHandle<long>("status"));
+	fData.Reserve(rows.size());
+	for (size_t row: rows) {
 
-	  long status;
-	  fFolder->GetNamedChannelData(*it, "status", status);
+	  ChannelStatus cs(channels[row]);
+	  cs.SetStatus( ChannelStatus::GetStatusFromInt((int)status[row]) );
 
-	  ChannelStatus cs(*it);
-	  cs.SetStatus( ChannelStatus::GetStatusFromInt((int)status) );
-
-	  fData.AddOrReplaceRow(cs);
+	  fData.AppendRow(cs);
 	}
+	fData.Finalize();
+	fFolder->Stats().addSnapshotUpdate(start, rows.size());
       }
     }
     return result;
@@ -138,6 +142,7 @@ namespace lariov {
       return fDefault;
     }
     DBUpdate();
+    fFolder->Stats().addLookup();
     if (fNewNoisy.HasChannel(rawToDBChannel(ch))) {
       return fNewNoisy.GetRow(rawToDBChannel(ch));
     }
@@ -147,6 +152,18 @@ namespace lariov {
   }
 
 
+  //----------------------------------------------------------------------------
+  const std::vector<unsigned int>& SIOVChannelStatusProvider::ChangedChannels() const {
+    DBUpdate();
+    return fData.ChangedChannels();
+  }
+
+  bool SIOVChannelStatusProvider::AllChannelsChanged() const {
+    DBUpdate();
+    return fData.AllChanged();
+  }
+
+
   //----------------------------------------------------------------------------
   SIOVChannelStatusProvider::ChannelSet_t
   SIOVChannelStatusProvider::GetChannelsWithStatus(chStatus status) const {
@@ -50,6 +50,11 @@ namespace lariov {
       /// Returns Channel Status
       const ChannelStatus& GetChannelStatus(raw::ChannelID_t channel) const;
 
+      /// Channels changed at the last IOV change (all loaded channels if
+      /// AllChannelsChanged(); see DeltaUpdates)
+      const std::vector<unsigned int>& ChangedChannels() const;
+      bool AllChannelsChanged() const;
+
       //
       // interface methods
       //
@@ -3,6 +3,7 @@
 // art/LArSoft libraries
 #include "cetlib_except/exception.h"
 #include "larcore/Geometry/Geometry.h"
+#include "larevt/CalibrationDBI/Providers/DBFolderCoordinator.h"
 #include "messagefacility/MessageLogger/MessageLogger.h"
 
 #include <fstream>
@@ -55,7 +56,7 @@ namespace lariov {
       for (; itW != geo->end_wire_id(); ++itW) {
 	DBChannelID_t ch = geo->PlaneWireToChannel(*itW);
 	defaultCalib.SetChannel(ch);
-	fData.AddOrReplaceRow(defaultCalib);
+	fData.AppendRow(defaultCalib);
       }
 
     }
@@ -94,12 +95,13 @@ namespace lariov {
         dp.SetShapingTimeErr(shaping_time_err);
 	dp.SetExtraInfo(info);
 
-        fData.AddOrReplaceRow(dp);
+        fData.AppendRow(dp);
       }
     }
     else {
       std::cout << "Using electronics calibrations from conditions database"<<std::endl;
     }
+    fData.Finalize();
   }
 
   // This method saves the time stamp of the latest event.
@@ -107,6 +109,7 @@ namespace lariov {
   void SIOVElectronicsCalibProvider::UpdateTimeStamp(DBTimeStamp_t ts) {
     mf::LogInfo("SIOVElectronicsCalibProvider") << "SIOVElectronicsCalibProvider::UpdateTimeStamp called.";
     fEventTimeStamp = ts;
+    DBFolderCoordinator::Instance().Update(ts);
   }
 
   // Maybe update method cached data (public non-const version).
@@ -139,30 +142,30 @@ namespace lariov {
 
       result = const_cast<SIOVElectronicsCalibProvider*>(this)->UpdateFolder(ts);
       if(result) {
-	//DBFolder was updated, so now update the Snapshot
-	fData.Clear();
-	fData.SetIoV(this->Begin(), this->End());
-
-	std::vector<DBChannelID_t> channels;
-	fFolder->GetChannelList(channels);
-	for (auto it = channels.begin(); it != channels.end(); ++it) {
-
-	  double gain, gain_err, shaping_time, shaping_time_err;
-	  fFolder->GetNamedChannelData(*it, "gain",     gain);
-	  fFolder->GetNamedChannelData(*it, "gain_err", gain_err);
-	  fFolder->GetNamedChannelData(*it, "shaping_time",     shaping_time);
-	  fFolder->GetNamedChannelData(*it, "shaping_time_err", shaping_time_err);
-
-
-	  ElectronicsCalib pg(*it);
-	  pg.SetGain( (float)gain );
-	  pg.SetGainErr( (float)gain_err );
-	  pg.SetShapingTime( (float)shaping_time );
-	  pg.SetShapingTimeErr( (float)shaping_time_err );
+	//DBFolder was updated, so now update the Snapshot (changed rows only with delta updates)
+	auto start = DBFolderStats::clock_type::now();
+	std::vector<size_t> rows = PrepareSnapshot(fData);
+
+	//Fetch whole columns, aligned with the channel list
+	const std::vector<DBChannelID_t>& channels = fFolder->Channels();
+	auto gain             = fFolder->GetColumnData(fFolder->GetColumnHandle<double>("gain"));
+	auto gain_err         = fFolder->GetColumnData(fFolder->GetColumnHandle<double>("gain_err"));
+	auto shaping_time     = fFolder->GetColumnData(fFolder->GetColumnHandle<double>("shaping_time"));
+	auto shaping_time_err = fFolder->GetColumnData(fFolder->GetColumnHandle<double>("shaping_time_err"));
+	fData.Reserve(rows.size());
+	for (size_t row: rows) {
+
+	  ElectronicsCalib pg(channels[row]);
+	  pg.SetGain( (float)gain[row] );
+	  pg.SetGainErr( (float)gain_err[row] );
+	  pg.SetShapingTime( (float)shaping_time[row] );
+	  pg.SetShapingTimeErr( (float)shaping_time_err[row] );
 	  pg.SetExtraInfo(CalibrationExtraInfo("ElectronicsCalib"));
 
-	  fData.AddOrReplaceRow(pg);
+	  fData.AppendRow(pg);
 	}
+	fData.Finalize();
+	fFolder->Stats().addSnapshotUpdate(start, rows.size());
       }
     }
 
@@ -171,9 +174,20 @@ namespace lariov {
 
   const ElectronicsCalib& SIOVElectronicsCalibProvider::ElectronicsCalibObject(DBChannelID_t ch) const {
     DBUpdate();
+    fFolder->Stats().addLookup();
     return fData.GetRow(ch);
   }
 
+  const std::vector<unsigned int>& SIOVElectronicsCalibProvider::ChangedChannels() const {
+    DBUpdate();
+    return fData.ChangedChannels();
+  }
+
+  bool SIOVElectronicsCalibProvider::AllChannelsChanged() const {
+    DBUpdate();
+    return fData.AllChanged();
+  }
+
   float SIOVElectronicsCalibProvider::Gain(DBChannelID_t ch) const {
     return this->ElectronicsCalibObject(ch).Gain();
   }
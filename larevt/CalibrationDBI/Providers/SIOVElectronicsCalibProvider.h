@@ -57,6 +57,11 @@ namespace lariov {
 
       /// Retrieve electronics calibration information
       const ElectronicsCalib& ElectronicsCalibObject(DBChannelID_t ch) const;
+
+      /// Channels changed at the last IOV change (all loaded channels if
+      /// AllChannelsChanged(); see DeltaUpdates)
+      const std::vector<unsigned int>& ChangedChannels() const;
+      bool AllChannelsChanged() const;
       float Gain(DBChannelID_t ch) const override;
       float GainErr(DBChannelID_t ch) const override;
       float ShapingTime(DBChannelID_t ch) const override;
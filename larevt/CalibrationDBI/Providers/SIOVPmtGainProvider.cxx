@@ -3,6 +3,7 @@
 // art/LArSoft libraries
 #include "cetlib_except/exception.h"
 #include "larcore/Geometry/Geometry.h"
+#include "larevt/CalibrationDBI/Providers/DBFolderCoordinator.h"
 #include "messagefacility/MessageLogger/MessageLogger.h"
 
 #include <fstream>
@@ -50,7 +51,7 @@ namespace lariov {
       for (unsigned int od=0; od!=geo->NOpDets(); ++od) {
         if (geo->IsValidOpChannel(od)) {
 	  defaultGain.SetChannel(od);
-	  fData.AddOrReplaceRow(defaultGain);
+	  fData.AppendRow(defaultGain);
 	}
       }
 
@@ -83,12 +84,13 @@ namespace lariov {
         dp.SetGainErr(gain_err);
 	dp.SetExtraInfo(info);
 
-        fData.AddOrReplaceRow(dp);
+        fData.AppendRow(dp);
       }
     }
     else {
       std::cout << "Using pmt gains from conditions database"<<std::endl;
     }
+    fData.Finalize();
   }
 
   // This method saves the time stamp of the latest event.
@@ -96,6 +98,7 @@ namespace lariov {
   void SIOVPmtGainProvider::UpdateTimeStamp(DBTimeStamp_t ts) {
     mf::LogInfo("SIOVPmtGainProvider") << "SIOVPmtGainProvider::UpdateTimeStamp called.";
     fEventTimeStamp = ts;
+    DBFolderCoordinator::Instance().Update(ts);
   }
 
   // Maybe update method cached data (public non-const version).
@@ -128,25 +131,26 @@ namespace lariov {
 
       result = const_cast<SIOVPmtGainProvider*>(this)->UpdateFolder(ts);
       if(result) {
-	//DBFolder was updated, so now update the Snapshot
-	fData.Clear();
-	fData.SetIoV(this->Begin(), this->End());
-
-	std::vector<DBChannelID_t> channels;
-	fFolder->GetChannelList(channels);
-	for (auto it = channels.begin(); it != channels.end(); ++it) {
-
-	  double gain, gain_err;
-	  fFolder->GetNamedChannelData(*it, "gain",     gain);
-	  fFolder->GetNamedChannelData(*it, "gain_sigma", gain_err);
-
-	  PmtGain pg(*it);
-	  pg.SetGain( (float)gain );
-	  pg.SetGainErr( (float)gain_err );
+	//DBFolder was updated, so now update the Snapshot (changed rows only with delta updates)
+	auto start = DBFolderStats::clock_type::now();
+	std::vector<size_t> rows = PrepareSnapshot(fData);
+
+	//Fetch whole columns, aligned with the channel list
+	const std::vector<DBChannelID_t>& channels = fFolder->Channels();
+	auto gain     = fFolder->GetColumnData(fFolder->GetColumnHandle<double>("gain"));
+	auto gain_err = fFolder->GetColumnData(fFolder->GetColumnHandle<double>("gain_sigma"));
+	fData.Reserve(rows.size());
+	for (size_t row: rows) {
+
+	  PmtGain pg(channels[row]);
+	  pg.SetGain( (float)gain[row] );
+	  pg.SetGainErr( (float)gain_err[row] );
 	  pg.SetExtraInfo(CalibrationExtraInfo("PmtGain"));
 
-	  fData.AddOrReplaceRow(pg);
+	  fData.AppendRow(pg);
 	}
+	fData.Finalize();
+	fFolder->Stats().addSnapshotUpdate(start, rows.size());
       }
     }
 
@@ -155,9 +159,20 @@ namespace lariov {
 
   const PmtGain& SIOVPmtGainProvider::PmtGainObject(DBChannelID_t ch) const {
     DBUpdate();
+    fFolder->Stats().addLookup();
     return fData.GetRow(ch);
   }
 
+  const std::vector<unsigned int>& SIOVPmtGainProvider::ChangedChannels() const {
+    DBUpdate();
+    return fData.ChangedChannels();
+  }
+
+  bool SIOVPmtGainProvider::AllChannelsChanged() const {
+    DBUpdate();
+    return fData.AllChanged();
+  }
+
   float SIOVPmtGainProvider::Gain(DBChannelID_t ch) const {
     return this->PmtGainObject(ch).Gain();
   }
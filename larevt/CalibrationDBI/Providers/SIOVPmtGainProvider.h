@@ -53,6 +53,11 @@ namespace lariov {
 
       /// Retrieve gain information
       const PmtGain& PmtGainObject(DBChannelID_t ch) const;
+
+      /// Channels changed at the last IOV change (all loaded channels if
+      /// AllChannelsChanged(); see DeltaUpdates)
+      const std::vector<unsigned int>& ChangedChannels() const;
+      bool AllChannelsChanged() const;
       float Gain(DBChannelID_t ch) const override;
       float GainErr(DBChannelID_t ch) const override;
       CalibrationExtraInfo const& ExtraInfo(DBChannelID_t ch) const override;
@@ -5,5 +5,18 @@
 namespace lariov{
   const unsigned int kNUMBER_HEADER_ROWS = 4;
   const unsigned int kBUFFER_SIZE = 128;
+
+  // Hedged http requests: recent primary latencies kept, number needed before
+  // the percentile is used, and hedge delay (seconds) until then.
+  const unsigned int kMAX_LATENCY_SAMPLES = 100;
+  const unsigned int kMIN_LATENCY_SAMPLES = 10;
+  const double kDEFAULT_HEDGE_DELAY = 2.;
+
+  // Hedged http requests: requests in flight per folder (including abandoned
+  // ones) above which no hedge is sent (failover is still done).
+  const unsigned int kMAX_HEDGE_THREADS = 8;
+
+  // Concurrent http fetches when preloading a time range.
+  const unsigned int kPRELOAD_THREADS = 4;
 }
 #endif
@@ -4,6 +4,7 @@
 #include "art/Persistency/Provenance/ScheduleContext.h"
 #include "fhiclcpp/ParameterSet.h"
 #include "larevt/CalibrationDBI/Interface/DetPedestalService.h"
+#include "larevt/CalibrationDBI/Providers/DBFolderStats.h"
 #include "larevt/CalibrationDBI/Providers/DetPedestalRetrievalAlg.h"
 
 namespace lariov{
@@ -46,6 +47,9 @@ namespace lariov{
     //register callback to update local database cache before each event is processed
     //reg.sPreProcessEvent.watch(&SIOVDetPedestalService::PreProcessEvent, *this);
     reg.sPreProcessEvent.watch(this, &SIOVDetPedestalService::PreProcessEvent);
+
+    //write conditions access statistics (if requested) at the end of the job
+    reg.sPostEndJob.watch(&DBFolderStats::writeJSONFile);
   }
 
 }//end namespace lariov
@@ -4,6 +4,7 @@
 #include "art/Persistency/Provenance/ScheduleContext.h"
 #include "fhiclcpp/ParameterSet.h"
 #include "larevt/CalibrationDBI/Interface/ElectronicsCalibService.h"
+#include "larevt/CalibrationDBI/Providers/DBFolderStats.h"
 #include "larevt/CalibrationDBI/Providers/SIOVElectronicsCalibProvider.h"
 
 namespace lariov{
@@ -49,6 +50,9 @@ namespace lariov{
   {
     //register callback to update local database cache before each event is processed
     reg.sPreProcessEvent.watch(this, &SIOVElectronicsCalibService::PreProcessEvent);
+
+    //write conditions access statistics (if requested) at the end of the job
+    reg.sPostEndJob.watch(&DBFolderStats::writeJSONFile);
   }
 
 }//end namespace lariov
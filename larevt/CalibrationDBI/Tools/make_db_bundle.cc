@@ -0,0 +1,138 @@
+//=================================================================================
+//
+// Name: make_db_bundle.cc
+//
+// Purpose: Write a conditions bundle (see DBBundle) holding every IOV of one or
+//          more folders and tags that overlaps a time range.
+//
+//          Usage: make_db_bundle [-u <url>] <output file> <tmin> <tmax> <folder>[:<tag>] ...
+//
+//          Data are taken from the conditions database server at <url>, or,
+//          without -u, from the local sqlite databases <folder>.db, which are
+//          located using FW_SEARCH_PATH.  <tmin> and <tmax> are raw time stamps
+//          as accepted by DBFolder::UpdateData (seconds, or nanoseconds since
+//          the epoch; see TimeStampDecoder).  For a run range, use the start
+//          time of the first run and the end time of the last run.
+//
+//          Jobs read the bundle with the BundleFile parameter of
+//          DatabaseRetrievalAlg (DBFolder::SetBundle).
+//
+//=================================================================================
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "cetlib_except/exception.h"
+#include "larevt/CalibrationDBI/IOVData/TimeStampDecoder.h"
+#include "larevt/CalibrationDBI/IOVData/IOVDataError.h"
+#include "larevt/CalibrationDBI/Providers/DBBundle.h"
+#include "larevt/CalibrationDBI/Providers/DBFolder.h"
+#include "larevt/CalibrationDBI/Providers/WebError.h"
+
+namespace {
+
+  void usage(const char* prog)
+  {
+    std::cerr << "Usage: " << prog << " [-u <url>] <output file> <tmin> <tmax> <folder>[:<tag>] ..."
+	      << std::endl;
+  }
+
+  // Parse raw time stamp.
+
+  bool parseTime(const char* arg, lariov::DBTimeStamp_t& raw_time)
+  {
+    char* end = nullptr;
+    raw_time = std::strtoull(arg, &end, 10);
+    if(end == arg || *end != '\0') {
+      std::cerr << "Invalid time " << arg << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+}
+
+int main(int argc, char** argv)
+{
+  std::string url;
+  int arg = 1;
+  if(arg + 1 < argc && std::strcmp(argv[arg], "-u") == 0) {
+    url = argv[arg + 1];
+    arg += 2;
+  }
+  if(argc - arg < 4) {
+    usage(argv[0]);
+    return 1;
+  }
+  std::string output = argv[arg];
+  lariov::DBTimeStamp_t raw_tmin = 0;
+  lariov::DBTimeStamp_t raw_tmax = 0;
+  if(!parseTime(argv[arg + 1], raw_tmin) || !parseTime(argv[arg + 2], raw_tmax))
+    return 1;
+
+  try {
+    lariov::IOVTimeStamp tmin = lariov::TimeStampDecoder::DecodeTimeStamp(raw_tmin);
+    lariov::IOVTimeStamp tmax = lariov::TimeStampDecoder::DecodeTimeStamp(raw_tmax);
+    lariov::DBBundle::Writer writer;
+
+    for(int i = arg + 3; i < argc; ++i) {
+      std::string folder = argv[i];
+      std::string tag;
+      size_t colon = folder.find(':');
+      if(colon != std::string::npos) {
+	tag = folder.substr(colon + 1);
+	folder = folder.substr(0, colon);
+      }
+
+      // Preload the IOVs of the range, and take the pinned datasets.  Preload
+      // failures are not fatal in DBFolder, so check that the datasets cover
+      // the whole range without gaps.
+
+      lariov::DBFolder dbfolder(folder, url, "", tag, url.empty(), false);
+      dbfolder.Preload(raw_tmin, raw_tmax);
+      std::vector<lariov::DBDatasetCache::dataset_ptr> datasets = dbfolder.DatasetCache().pinnedDatasets();
+      bool complete = !datasets.empty() && !(tmin < datasets.front()->beginTime());
+      for(size_t j=0; complete && j<datasets.size(); ++j) {
+	const lariov::IOVTimeStamp& end = datasets[j]->endTime();
+	if(j + 1 < datasets.size())
+	  complete = end == datasets[j+1]->beginTime();
+	else
+	  complete = end == lariov::IOVTimeStamp::MaxTimeStamp() || tmax < end;
+      }
+      if(!complete) {
+	std::cerr << "Unable to load all IOVs of folder " << folder << ", tag " << tag << std::endl;
+	return 1;
+      }
+      for(const lariov::DBDatasetCache::dataset_ptr& data : datasets)
+	writer.add(folder, tag, *data);
+      std::cout << "Folder " << folder << ", tag " << tag << ": " << datasets.size() << " IOVs" << std::endl;
+    }
+
+    // Write bundle.
+
+    std::ofstream out(output, std::ios::binary | std::ios::trunc);
+    writer.write(out);
+    out.close();
+    if(!out) {
+      std::cerr << "Unable to write " << output << std::endl;
+      return 1;
+    }
+    std::cout << "Wrote " << writer.size() << " datasets to " << output << std::endl;
+  }
+  catch(lariov::IOVDataError& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  catch(lariov::WebError& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  catch(cet::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
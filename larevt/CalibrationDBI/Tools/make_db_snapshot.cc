@@ -0,0 +1,82 @@
+//=================================================================================
+//
+// Name: make_db_snapshot.cc
+//
+// Purpose: Write a binary DBDataset snapshot for one folder, tag and time,
+//          taken from a local sqlite database.
+//
+//          Usage: make_db_snapshot <folder> <tag> <time> <output file>
+//
+//          The sqlite file <folder>.db is located using FW_SEARCH_PATH.
+//          <time> is a raw time stamp as accepted by DBFolder::UpdateData
+//          (seconds, or nanoseconds since the epoch; see TimeStampDecoder).
+//
+//          Snapshot files can be placed in a DBFolder disk cache directory
+//          (as <cache dir>/<folder>/<tag>/<begin>_<end>.dbcache), or loaded
+//          directly with DBDataset::mapSnapshot.
+//
+//=================================================================================
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "cetlib_except/exception.h"
+#include "larevt/CalibrationDBI/IOVData/TimeStampDecoder.h"
+#include "larevt/CalibrationDBI/IOVData/IOVDataError.h"
+#include "larevt/CalibrationDBI/Providers/DBFolder.h"
+#include "larevt/CalibrationDBI/Providers/DBDataset.h"
+
+int main(int argc, char** argv)
+{
+  if(argc != 5) {
+    std::cerr << "Usage: " << argv[0] << " <folder> <tag> <time> <output file>" << std::endl;
+    return 1;
+  }
+  std::string folder = argv[1];
+  std::string tag = argv[2];
+  std::string output = argv[4];
+
+  try {
+    char* end = nullptr;
+    lariov::DBTimeStamp_t raw_time = std::strtoull(argv[3], &end, 10);
+    if(end == argv[3] || *end != '\0') {
+      std::cerr << "Invalid time " << argv[3] << std::endl;
+      return 1;
+    }
+    lariov::IOVTimeStamp ts = lariov::TimeStampDecoder::DecodeTimeStamp(raw_time);
+
+    // Query sqlite database.
+
+    lariov::DBFolder dbfolder(folder, "", "", tag, true, false);
+    lariov::DBDataset data;
+    dbfolder.GetSQLiteData(ts.Stamp(), data);
+    if(data.nrows() == 0) {
+      std::cerr << "No data for folder " << folder << ", tag " << tag
+		<< ", time " << ts.DBStamp() << std::endl;
+      return 1;
+    }
+
+    // Write snapshot.
+
+    std::ofstream out(output, std::ios::binary | std::ios::trunc);
+    data.writeSnapshot(out, folder, tag);
+    out.close();
+    if(!out) {
+      std::cerr << "Unable to write " << output << std::endl;
+      return 1;
+    }
+    std::cout << "Wrote " << data.nrows() << " channels, IOV "
+	      << data.beginTime().DBStamp() << " - " << data.endTime().DBStamp()
+	      << " to " << output << std::endl;
+  }
+  catch(lariov::IOVDataError& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  catch(cet::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,318 @@
+/**
+ * @file   DBDataset_test.cxx
+ * @brief  Text responses and snapshot files of DBDataset
+ * @see    DBDataset.h
+ *
+ * Numbers in text responses must convert like `strtol()` and `strtod()` did
+ * (white space, signs, exponents, overflow), including quoted fields, and a
+ * body fed to `DBDataset::TextParser` in pieces of any size must give the same
+ * dataset as `parse()` of the whole body.
+ *
+ * A dataset written with `writeSnapshot()` must read back the same through
+ * `attachSnapshot()` and `mapSnapshot()`, for all column kinds, and truncated
+ * or corrupted snapshots must be rejected without changing the dataset.
+ */
+
+// Boost libraries
+#define BOOST_TEST_MODULE ( dbdataset_test )
+#include <cetlib/quiet_unit_test.hpp> // BOOST_AUTO_TEST_CASE()
+#include <boost/test/test_tools.hpp> // BOOST_CHECK(), BOOST_CHECK_EQUAL()
+
+// framework libraries
+#include "cetlib_except/exception.h"
+
+// LArSoft libraries
+#include "larevt/CalibrationDBI/Providers/DBDataset.h"
+
+// C/C++ standard libraries
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+
+namespace {
+
+  /// Dataset with one column of each kind; some text values are empty, and
+  /// some booleans and numbers are null
+  lariov::DBDataset MakeDataset(unsigned int nrows) {
+    lariov::DBDataset data(lariov::IOVTimeStamp(1500000000, 5), lariov::IOVTimeStamp(1500000100, 0),
+                           { "channel", "status", "gain", "good", "label" },
+                           { "integer", "integer", "real", "boolean", "text" },
+                           nrows);
+    for (unsigned int row = 0; row < nrows; ++row) {
+      data.appendLong(0, 10 + 2 * row);
+      if (row % 5 == 4) data.appendNull(1);
+      else data.appendLong(1, long(row) * 1000000007L - 3);
+      data.appendDouble(2, 0.25 * row - 1.);
+      if (row % 3 == 2) data.appendNull(3);
+      else data.appendLong(3, row % 3);
+      if (row % 4 == 1) data.appendString(4, "");
+      else data.appendString(4, "label " + std::to_string(row));
+    }
+    return data;
+  }
+
+  /// Snapshot bytes in 8-byte aligned memory
+  std::shared_ptr<std::vector<std::uint64_t>> Snapshot
+    (lariov::DBDataset const& data, size_t& size)
+  {
+    std::ostringstream out;
+    data.writeSnapshot(out, "folder", "tag");
+    std::string const bytes = out.str();
+    size = bytes.size();
+    auto buffer = std::make_shared<std::vector<std::uint64_t>>((size + 7) / 8);
+    std::memcpy(buffer->data(), bytes.data(), size);
+    return buffer;
+  }
+
+  /// Whether two datasets hold the same schema and values
+  void CheckSame(lariov::DBDataset const& a, lariov::DBDataset const& b) {
+    BOOST_CHECK(a.beginTime() == b.beginTime());
+    BOOST_CHECK(a.endTime() == b.endTime());
+    BOOST_CHECK(a.colNames() == b.colNames());
+    BOOST_CHECK(a.colTypes() == b.colTypes());
+    BOOST_CHECK(a.channels() == b.channels());
+    BOOST_REQUIRE(a.sameColumns(b));
+    unsigned int mismatches = 0;
+    for (size_t row = 0; row < a.nrows(); ++row)
+      if (!a.sameRow(row, b, row)) ++mismatches;
+    BOOST_CHECK_EQUAL(mismatches, 0U);
+  }
+
+  /// Response body with the specified integer and real fields, one row each
+  std::string ResponseBody(std::vector<std::string> const& longs, std::vector<std::string> const& doubles) {
+    std::string body = "1500000000.000000\n1500000100.000000\n"
+      "channel,count,gain,label\ninteger,bigint,real,text\n";
+    for (size_t row = 0; row < longs.size(); ++row)
+      body += std::to_string(row) + "," + longs[row] + "," + doubles[row] + ",x\n";
+    return body;
+  }
+
+} // local namespace
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(ParseNumbers) {
+
+  // fields that do not need quoting, converted as strtol and strtod do
+  std::vector<std::string> const longs {
+    "12", " 12", "\t-7", " \v\f\r+42", "+-5", "--5", "++5", "- 5", "12abc", "abc", "",
+    "1e3", "0x1A", "9223372036854775807", "9223372036854775808", "99999999999999999999",
+    "-9223372036854775808", "-99999999999999999999", "007", "-0", "+", "-"
+  };
+  std::vector<std::string> const doubles {
+    "1.5", " -2e3", "+.5", "\t7E2", "3.25xyz", "abc", "", "+-1", "1e400", "-1e400",
+    "1e-400", "-1e-400", "4.9e-324", "1.7976931348623157e308", "inf", "-Infinity",
+    "1e", "1e+", ".", "-.e1", "  +1.25e-2", "0.1"
+  };
+  BOOST_REQUIRE_EQUAL(longs.size(), doubles.size());
+
+  lariov::DBDataset data;
+  data.parse(ResponseBody(longs, doubles));
+  BOOST_REQUIRE_EQUAL(data.nrows(), longs.size());
+  BOOST_CHECK_EQUAL(data.colKind(1), lariov::DBDataset::kLong);
+  BOOST_CHECK_EQUAL(data.colKind(2), lariov::DBDataset::kDouble);
+  for (size_t row = 0; row < longs.size(); ++row) {
+    BOOST_TEST_MESSAGE("'" << longs[row] << "', '" << doubles[row] << "'");
+    BOOST_CHECK_EQUAL(data.getLongData(row, 1), std::strtol(longs[row].c_str(), nullptr, 10));
+    BOOST_CHECK_EQUAL(data.getDoubleData(row, 2), std::strtod(doubles[row].c_str(), nullptr));
+  }
+
+  // a few explicitly
+  BOOST_CHECK_EQUAL(data.getLongData(3, 1), 42L);
+  BOOST_CHECK_EQUAL(data.getLongData(4, 1), 0L);
+  BOOST_CHECK_EQUAL(data.getLongData(15, 1), LONG_MAX);
+  BOOST_CHECK_EQUAL(data.getLongData(17, 1), LONG_MIN);
+  BOOST_CHECK_EQUAL(data.getDoubleData(1, 2), -2000.);
+  BOOST_CHECK_EQUAL(data.getDoubleData(8, 2), HUGE_VAL);
+  BOOST_CHECK_EQUAL(data.getDoubleData(9, 2), -HUGE_VAL);
+  BOOST_CHECK_EQUAL(data.getDoubleData(10, 2), 0.);
+  BOOST_CHECK_EQUAL(data.getDoubleData(12, 2), 4.9e-324);
+
+  // quoted fields
+  lariov::DBDataset quoted;
+  quoted.parse("1500000000.000000\n1500000100.000000\n"
+               "channel,\"count\",gain,label\ninteger,bigint,real,text\n"
+               "\"5\",\" -15\",\"2.5e1\",\"a \"\"b\"\", c\"\n"
+               "6,\"\",\"\",\"\"\n"
+               "7,\"+1,5\",\"1,5\",\",\"\n");
+  BOOST_REQUIRE_EQUAL(quoted.nrows(), 3U);
+  BOOST_CHECK_EQUAL(quoted.colNames()[1], "count");
+  BOOST_CHECK_EQUAL(quoted.channels()[0], 5U);
+  BOOST_CHECK_EQUAL(quoted.getLongData(0, 1), -15L);
+  BOOST_CHECK_EQUAL(quoted.getDoubleData(0, 2), 25.);
+  BOOST_CHECK_EQUAL(quoted.getStringData(0, 3), "a \"b\", c");
+  BOOST_CHECK_EQUAL(quoted.getLongData(1, 1), 0L);
+  BOOST_CHECK_EQUAL(quoted.getDoubleData(1, 2), 0.);
+  BOOST_CHECK_EQUAL(quoted.getStringData(1, 3), "");
+  BOOST_CHECK_EQUAL(quoted.getLongData(2, 1), 1L);
+  BOOST_CHECK_EQUAL(quoted.getDoubleData(2, 2), 1.);
+  BOOST_CHECK_EQUAL(quoted.getStringData(2, 3), ",");
+
+} // BOOST_AUTO_TEST_CASE(ParseNumbers)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(IncrementalParsing) {
+
+  // quoted fields with line-like content, CRLF, empty lines, and an
+  // unterminated last line
+  std::string const body = "1500000000.000000\r\n-\n"
+    "channel,status,gain,good,label\ninteger,integer,real,boolean,text\n"
+    "1, 2,1.5,true,\"one, \"\"1\"\"\"\r\n"
+    "\n"
+    "3,-4,2e1,0,\n"
+    "5,,\"-.5\",False,plain\r\n"
+    "7,8,9,1,last";
+
+  lariov::DBDataset whole;
+  whole.parse(body);
+  BOOST_REQUIRE_EQUAL(whole.nrows(), 4U);
+  BOOST_CHECK(whole.endTime() == lariov::IOVTimeStamp::MaxTimeStamp());
+  BOOST_CHECK_EQUAL(whole.getStringData(0, 4), "one, \"1\"");
+  BOOST_CHECK_EQUAL(whole.getStringData(3, 4), "last");
+
+  for (size_t piece = 1; piece <= body.size(); ++piece) {
+    lariov::DBDataset data;
+    lariov::DBDataset::TextParser parser(data);
+    for (size_t pos = 0; pos < body.size(); pos += piece)
+      parser.feed(std::string_view(body).substr(pos, piece));
+    parser.finish();
+    BOOST_TEST_MESSAGE("pieces of " << piece << " bytes");
+    CheckSame(whole, data);
+    BOOST_CHECK_EQUAL(data.getStringData(0, 4), whole.getStringData(0, 4));
+  }
+
+  // empty pieces are harmless
+  lariov::DBDataset data;
+  lariov::DBDataset::TextParser parser(data);
+  parser.feed("");
+  parser.feed(body);
+  parser.feed("");
+  parser.finish();
+  CheckSame(whole, data);
+
+  // malformed bodies
+  lariov::DBDataset bad;
+  lariov::DBDataset::TextParser incomplete(bad);
+  incomplete.feed("1500000000.000000\n-\nchannel,gain\n");
+  BOOST_CHECK_THROW(incomplete.finish(), cet::exception);
+  lariov::DBDataset::TextParser wrong_bool(bad);
+  BOOST_CHECK_THROW(wrong_bool.feed("1500000000.000000\n-\nchannel,good\ninteger,boolean\n1,maybe\n"),
+                    cet::exception);
+
+} // BOOST_AUTO_TEST_CASE(IncrementalParsing)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(SnapshotRoundTrip) {
+
+  for (unsigned int nrows: { 0U, 1U, 63U, 64U, 65U, 1000U }) {
+    lariov::DBDataset const data = MakeDataset(nrows);
+
+    size_t size = 0;
+    auto buffer = Snapshot(data, size);
+    lariov::DBDataset copy;
+    std::string folder, tag;
+    BOOST_REQUIRE(copy.attachSnapshot
+      (buffer, reinterpret_cast<char const*>(buffer->data()), size, &folder, &tag));
+    BOOST_CHECK(copy.isMapped());
+    BOOST_CHECK_EQUAL(folder, "folder");
+    BOOST_CHECK_EQUAL(tag, "tag");
+    CheckSame(data, copy);
+
+    // values as appended
+    for (size_t row = 0; row < copy.nrows(); ++row) {
+      BOOST_CHECK_EQUAL(copy.getLongData(row, 1), (row % 5 == 4)? 0L: long(row) * 1000000007L - 3);
+      BOOST_CHECK_EQUAL(copy.getDoubleData(row, 2), 0.25 * row - 1.);
+      BOOST_CHECK_EQUAL(copy.getLongData(row, 3), (row % 3 == 1)? 1L: 0L);
+      BOOST_CHECK_EQUAL(copy.getStringData(row, 4),
+                        (row % 4 == 1)? std::string(): "label " + std::to_string(row));
+    }
+
+    // the snapshot of a mapped dataset is the same
+    size_t size2 = 0;
+    auto buffer2 = Snapshot(copy, size2);
+    BOOST_CHECK_EQUAL(size2, size);
+    BOOST_CHECK(std::memcmp(buffer->data(), buffer2->data(), size) == 0);
+  }
+
+  // through a file
+  lariov::DBDataset const data = MakeDataset(100);
+  std::string const path = "DBDataset_test_" + std::to_string(getpid()) + ".snap";
+  {
+    std::ofstream out(path, std::ios::binary);
+    data.writeSnapshot(out, "folder", "tag");
+  }
+  lariov::DBDataset mapped;
+  BOOST_REQUIRE(mapped.mapSnapshot(path));
+  std::remove(path.c_str());
+  CheckSame(data, mapped);
+
+} // BOOST_AUTO_TEST_CASE(SnapshotRoundTrip)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(SnapshotRejection) {
+
+  lariov::DBDataset const data = MakeDataset(70);
+  size_t size = 0;
+  auto const buffer = Snapshot(data, size);
+  char const* const bytes = reinterpret_cast<char const*>(buffer->data());
+
+  // a loaded dataset stays unchanged after rejections
+  lariov::DBDataset target = MakeDataset(3);
+  auto unchanged = [&target]() {
+    return target.nrows() == 3 && !target.isMapped() && target.getStringData(2, 4) == "label 2";
+  };
+
+  // truncated
+  for (size_t n: { size_t(0), size_t(8), size - 64, size - 8 })
+    BOOST_CHECK(!target.attachSnapshot(buffer, bytes, n));
+  BOOST_CHECK(!target.attachSnapshot(buffer, nullptr, size));
+  BOOST_CHECK(unchanged());
+
+  // misaligned
+  auto shifted = std::make_shared<std::vector<std::uint64_t>>(buffer->size() + 1);
+  char* const shifted_bytes = reinterpret_cast<char*>(shifted->data()) + 4;
+  std::memcpy(shifted_bytes, bytes, size);
+  BOOST_CHECK(!target.attachSnapshot(shifted, shifted_bytes, size));
+
+  // any corrupted byte
+  auto corrupted = std::make_shared<std::vector<std::uint64_t>>(*buffer);
+  char* const corrupted_bytes = reinterpret_cast<char*>(corrupted->data());
+  unsigned int accepted = 0;
+  for (size_t i = 0; i < size; ++i) {
+    corrupted_bytes[i] ^= 0x10;
+    if (target.attachSnapshot(corrupted, corrupted_bytes, size)) ++accepted;
+    corrupted_bytes[i] = bytes[i];
+  }
+  BOOST_CHECK_EQUAL(accepted, 0U);
+  BOOST_CHECK(unchanged());
+
+  // the original is still fine
+  BOOST_CHECK(target.attachSnapshot(corrupted, corrupted_bytes, size));
+  CheckSame(data, target);
+
+  // files
+  lariov::DBDataset mapped;
+  BOOST_CHECK(!mapped.mapSnapshot("DBDataset_test_missing.snap"));
+  std::string const path = "DBDataset_test_" + std::to_string(getpid()) + ".snap";
+  {
+    std::ofstream out(path, std::ios::binary);
+    out.write(bytes, size - 8);
+  }
+  BOOST_CHECK(!mapped.mapSnapshot(path));
+  std::remove(path.c_str());
+  BOOST_CHECK_EQUAL(mapped.nrows(), 0U);
+
+} // BOOST_AUTO_TEST_CASE(SnapshotRejection)
@@ -0,0 +1,180 @@
+/**
+ * @file   DBDiskCache_test.cxx
+ * @brief  Persistent on-disk dataset cache
+ * @see    DBDiskCache.h
+ *
+ * Stored datasets must be found for any time inside their IOV and only
+ * there; files written by earlier jobs must be found; cache files that
+ * vanish or get corrupted must give a miss (and be forgotten); concurrent
+ * stores of the same dataset must never publish a torn file.
+ */
+
+// Boost libraries
+#define BOOST_TEST_MODULE ( dbdiskcache_test )
+#include <cetlib/quiet_unit_test.hpp> // BOOST_AUTO_TEST_CASE()
+#include <boost/test/test_tools.hpp> // BOOST_CHECK(), BOOST_CHECK_EQUAL()
+
+// LArSoft libraries
+#include "larevt/CalibrationDBI/Providers/DBDiskCache.h"
+
+// C/C++ standard libraries
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+  /// Dataset of `n` channels with IOV [begin, end)
+  lariov::DBDataset MakeDataset(lariov::IOVTimeStamp const& begin, lariov::IOVTimeStamp const& end,
+                                long n = 10)
+  {
+    lariov::DBDataset data(begin, end, { "channel", "mean" }, { "integer", "real" });
+    for (long ch = 0; ch < n; ++ch) {
+      data.appendLong(0, ch);
+      data.appendDouble(1, begin.Stamp() + 0.5 * ch);
+    }
+    return data;
+  }
+
+  /// Name of the cache file of an IOV
+  std::string FileName(lariov::DBDiskCache const& cache,
+                       lariov::IOVTimeStamp const& begin, lariov::IOVTimeStamp const& end)
+  {
+    return cache.directory() + "/" + begin.DBStamp() + "_" + end.DBStamp() + ".dbcache";
+  }
+
+  struct CacheDirFixture {
+    std::string dir;
+    CacheDirFixture() {
+      char name[] = "/tmp/DBDiskCache_test_XXXXXX";
+      BOOST_REQUIRE(mkdtemp(name));
+      dir = name;
+    }
+    ~CacheDirFixture() { std::system(("rm -rf " + dir).c_str()); }
+  };
+
+  lariov::IOVTimeStamp const T0(1500000000, 0);
+  lariov::IOVTimeStamp const T1(1500000100, 0);
+  lariov::IOVTimeStamp const T2(1500000200, 0);
+  lariov::IOVTimeStamp const T3(1500000300, 0);
+  lariov::IOVTimeStamp const T4(1500000400, 0);
+
+} // local namespace
+
+
+BOOST_FIXTURE_TEST_SUITE(DBDiskCacheTests, CacheDirFixture)
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(StoreAndFind) {
+
+  lariov::DBDiskCache cache(dir, "pedestals", "v1");
+  BOOST_CHECK(!cache.find(T0)); // no directory yet
+
+  BOOST_CHECK(cache.store(MakeDataset(T0, T1)));
+  BOOST_CHECK(cache.store(MakeDataset(T2, T3)));
+  BOOST_CHECK(!cache.store(MakeDataset(T2, T3))); // already there
+  BOOST_CHECK(!cache.store(MakeDataset(T3, lariov::IOVTimeStamp::MaxTimeStamp()))); // open ended
+
+  // hits
+  for (lariov::IOVTimeStamp const& ts: { T0, lariov::IOVTimeStamp(1500000099, 999999), T2 }) {
+    auto data = cache.find(ts);
+    BOOST_REQUIRE(data);
+    BOOST_CHECK(ts >= data->beginTime() && ts < data->endTime());
+    BOOST_CHECK_EQUAL(data->nrows(), 10U);
+    BOOST_CHECK_EQUAL(data->getDoubleData(3, 1), data->beginTime().Stamp() + 1.5);
+  }
+
+  // misses: before, between and after the stored IOVs
+  for (lariov::IOVTimeStamp const& ts: { lariov::IOVTimeStamp(1499999999, 0), T1, T3, T4 })
+    BOOST_CHECK(!cache.find(ts));
+
+  // another job finds the stored files, and tag and folder are separate
+  lariov::DBDiskCache other(dir, "pedestals", "v1");
+  BOOST_CHECK(other.find(T2));
+  BOOST_CHECK(!lariov::DBDiskCache(dir, "pedestals", "v2").find(T2));
+  BOOST_CHECK(!lariov::DBDiskCache(dir, "gains", "v1").find(T2));
+
+  // files stored by another job after the index is loaded are known once
+  // this cache tries to store them
+  BOOST_CHECK(other.store(MakeDataset(T3, T4)));
+  BOOST_CHECK(!cache.find(T3));
+  BOOST_CHECK(!cache.store(MakeDataset(T3, T4)));
+  BOOST_CHECK(cache.find(T3));
+
+} // BOOST_AUTO_TEST_CASE(StoreAndFind)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(StaleFiles) {
+
+  lariov::DBDiskCache cache(dir, "pedestals", "v1");
+  BOOST_CHECK(cache.store(MakeDataset(T0, T1)));
+  BOOST_CHECK(cache.store(MakeDataset(T1, T2)));
+  BOOST_CHECK(cache.store(MakeDataset(T2, T3)));
+  BOOST_REQUIRE(cache.find(T0));
+
+  // removed behind the cache's back
+  BOOST_CHECK_EQUAL(std::remove(FileName(cache, T0, T1).c_str()), 0);
+  BOOST_CHECK(!cache.find(T0));
+
+  // corrupted: a miss, and the file is removed so that it can be stored again
+  std::string const path = FileName(cache, T1, T2);
+  {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(200);
+    file.put('\x7f');
+  }
+  BOOST_CHECK(!cache.find(T1));
+  BOOST_CHECK(!std::ifstream(path));
+  BOOST_CHECK(cache.store(MakeDataset(T1, T2)));
+  BOOST_CHECK(cache.find(T1));
+
+  // contents that do not match the file name
+  {
+    lariov::DBDiskCache other(dir + "/other", "pedestals", "v1");
+    BOOST_REQUIRE(other.store(MakeDataset(T0, T1)));
+    BOOST_CHECK_EQUAL(std::rename(FileName(other, T0, T1).c_str(), FileName(cache, T3, T4).c_str()), 0);
+  }
+  lariov::DBDiskCache reloaded(dir, "pedestals", "v1");
+  BOOST_CHECK(!reloaded.find(T3));
+  BOOST_CHECK(reloaded.find(T2));
+
+} // BOOST_AUTO_TEST_CASE(StaleFiles)
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(ConcurrentStores) {
+
+  // threads of one job storing the same datasets at the same time
+  lariov::DBDiskCache cache(dir, "pedestals", "v1");
+  lariov::DBDataset const data1 = MakeDataset(T0, T1, 100000);
+  lariov::DBDataset const data2 = MakeDataset(T1, T2, 100000);
+  for (int round = 0; round < 20; ++round) {
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i)
+      threads.emplace_back([&] {
+          while (!go) std::this_thread::yield();
+          cache.store(data1);
+          cache.store(data2);
+        });
+    go = true;
+    for (std::thread& t: threads) t.join();
+
+    lariov::DBDiskCache reloaded(dir, "pedestals", "v1");
+    for (lariov::IOVTimeStamp const& ts: { T0, T1 }) {
+      auto data = reloaded.find(ts);
+      BOOST_REQUIRE(data);
+      BOOST_CHECK_EQUAL(data->nrows(), 100000U);
+    }
+    BOOST_CHECK_EQUAL(std::remove(FileName(cache, T0, T1).c_str()), 0);
+    BOOST_CHECK_EQUAL(std::remove(FileName(cache, T1, T2).c_str()), 0);
+  }
+
+} // BOOST_AUTO_TEST_CASE(ConcurrentStores)
+
+BOOST_AUTO_TEST_SUITE_END()
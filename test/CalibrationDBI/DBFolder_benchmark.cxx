@@ -0,0 +1,206 @@
+/**
+ * @file   DBFolder_benchmark.cxx
+ * @brief  Conditions fetch benchmark against the loopback database server
+ * @see    DBTestServer.h
+ *
+ * Usage: DBFolder_benchmark [channels [IOVs [latency_ms [payload_scale]]]]
+ *
+ * If DBFOLDER_BENCHMARK_STATS is set, the access statistics of all folders
+ * are printed at the end (JSON, see DBFolderStats.h).
+ *
+ * For each IOV change the benchmark reports:
+ * * fetch: the http request alone (libwda), including server latency;
+ * * parse: conversion of the libwda response into a DBDataset;
+ * * first event: the cost paid by the first event after the IOV change, i.e.
+ *   the update plus one access to every channel, for DBFolder (with libwda,
+ *   and with compressed transfer), DetPedestalRetrievalAlg and
+ *   SIOVChannelStatusProvider, and for pedestals and channel status together,
+ *   with and without coordinated fetching.
+ */
+
+// LArSoft libraries
+#include "larevt/CalibrationDBI/Providers/DBFolder.h"
+#include "larevt/CalibrationDBI/Providers/DetPedestalRetrievalAlg.h"
+#include "larevt/CalibrationDBI/Providers/SIOVChannelStatusProvider.h"
+#include "larevt/CalibrationDBI/Providers/WebError.h"
+#include "DBTestServer.h"
+
+// framework libraries
+#include "fhiclcpp/ParameterSet.h"
+
+// C/C++ standard libraries
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include "wda.h"
+
+
+namespace {
+
+  std::string const PedestalFolder = "detpedestals_data";
+  std::string const StatusFolder = "channelstatus_data";
+
+  /// Returns the time spent running `f`, in milliseconds
+  double timeit(std::function<void()> const& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>
+      (std::chrono::steady_clock::now() - start).count();
+  }
+
+  /// Time stamp in the format used by the providers (ns)
+  lariov::DBTimeStamp_t nanoseconds(long seconds)
+    { return lariov::DBTimeStamp_t(seconds) * 1000000000; }
+
+  /// Configuration of a provider reading `folder` from `url`
+  fhicl::ParameterSet providerConfig
+    (std::string const& folder, std::string const& url, bool coordinated = false)
+  {
+    fhicl::ParameterSet db;
+    db.put<std::string>("DBFolderName", folder);
+    db.put<std::string>("DBUrl", url);
+    db.put<std::string>("DBTag", "v1");
+    db.put<bool>("CoordinatedFetch", coordinated);
+    fhicl::ParameterSet pset;
+    pset.put<fhicl::ParameterSet>("DatabaseRetrievalAlg", db);
+    pset.put<bool>("UseDB", true);
+    return pset;
+  }
+
+  void printRow(std::string const& name, std::vector<double> const& times) {
+    std::printf("  %-32s", name.c_str());
+    for (double t: times) std::printf(" %9.2f", t);
+    std::printf("\n");
+  }
+
+} // local namespace
+
+
+int main(int argc, char** argv) {
+
+  unsigned int const nchannels = (argc > 1)? std::atoi(argv[1]): 8256;
+  unsigned int const niovs = (argc > 2)? std::atoi(argv[2]): 4;
+  double const latency = (argc > 3)? std::atof(argv[3]) / 1000.: 0.;
+  unsigned int const scale = (argc > 4)? std::atoi(argv[4]): 1;
+
+  // databases and server
+  char tmpl[] = "/tmp/dbfolderbenchXXXXXX";
+  std::string const dir = mkdtemp(tmpl);
+  std::vector<long> begins;
+  for (unsigned int iov = 0; iov < niovs; ++iov) begins.push_back(1500000000 + 1000 * iov);
+  lariov::DBTestServer::MakeDatabase(dir + "/" + PedestalFolder + ".db", PedestalFolder,
+    { { "mean", "real" }, { "mean_err", "real" }, { "rms", "real" }, { "rms_err", "real" } },
+    nchannels, begins);
+  lariov::DBTestServer::MakeDatabase(dir + "/" + StatusFolder + ".db", StatusFolder,
+    { { "status", "integer" } }, nchannels, begins);
+
+  lariov::DBTestServer server(dir);
+  server.Start();
+  server.SetLatency(latency);
+  server.SetPayloadScale(scale);
+  unsigned int const nrows = nchannels * std::max(scale, 1U);
+
+  std::cout << "DBFolder benchmark: " << nrows << " channels, " << niovs << " IOVs, "
+    << latency * 1000. << " ms server latency\n"
+    << "Times in ms, one column per IOV change.\n";
+
+  int status = 0;
+  try {
+
+    // fetch and parse, separately
+    std::vector<double> fetch, parse;
+    for (long begin: begins) {
+      std::string url = server.URL() + "/data?f=" + PedestalFolder
+        + "&t=" + std::to_string(begin + 10) + ".000000&tag=v1";
+      Dataset data = nullptr;
+      int err = 0;
+      fetch.push_back(timeit([&]{ data = getDataWithTimeout(url.c_str(), nullptr, 60, &err); }));
+      if (getHTTPstatus(data) != 200) {
+        releaseDataset(data);
+        throw lariov::WebError("fetch of " + url + " failed");
+      }
+      parse.push_back(timeit([&]{ lariov::DBDataset dataset(data, true); }));
+    }
+    printRow("fetch (" + PedestalFolder + ")", fetch);
+    printRow("parse (" + PedestalFolder + ")", parse);
+
+    // first event after each IOV change
+    std::vector<double> folder_times, gzip_times, pedestal_times, status_times;
+    unsigned long plain_bytes = 0, gzip_bytes = 0;
+    lariov::DBFolder folder(PedestalFolder, server.URL(), "", "v1");
+    lariov::DBFolder gzip_folder(PedestalFolder, server.URL(), "", "v1");
+    gzip_folder.SetCompressedTransfer(true);
+    lariov::DetPedestalRetrievalAlg pedestals(providerConfig(PedestalFolder, server.URL()));
+    lariov::SIOVChannelStatusProvider statuses(providerConfig(StatusFolder, server.URL()));
+    double sum = 0.;
+    for (long begin: begins) {
+      lariov::DBTimeStamp_t ts = nanoseconds(begin + 10);
+      for (lariov::DBFolder* f: { &folder, &gzip_folder }) {
+        unsigned long const bytes = server.BytesSent();
+        double t = timeit([&]{
+          f->UpdateData(ts);
+          for (unsigned int ch = 0; ch < nrows; ++ch) {
+            double mean = 0.;
+            f->GetNamedChannelData(ch, "mean", mean);
+            sum += mean;
+          }
+        });
+        ((f == &folder)? folder_times: gzip_times).push_back(t);
+        ((f == &folder)? plain_bytes: gzip_bytes) += server.BytesSent() - bytes;
+      }
+      pedestal_times.push_back(timeit([&]{
+        pedestals.Update(ts);
+        for (unsigned int ch = 0; ch < nrows; ++ch) sum += pedestals.PedMean(ch);
+      }));
+      status_times.push_back(timeit([&]{
+        statuses.UpdateTimeStamp(ts);
+        for (unsigned int ch = 0; ch < nrows; ++ch) sum += statuses.Status(ch);
+      }));
+    }
+
+    // pedestals and channel status together, as in an event loop
+    std::vector<double> serial_times, coordinated_times;
+    for (bool coordinated: { false, true }) {
+      lariov::DetPedestalRetrievalAlg peds(providerConfig(PedestalFolder, server.URL(), coordinated));
+      lariov::SIOVChannelStatusProvider stats(providerConfig(StatusFolder, server.URL(), coordinated));
+      for (long begin: begins) {
+        lariov::DBTimeStamp_t ts = nanoseconds(begin + 10);
+        double t = timeit([&]{
+          peds.UpdateTimeStamp(ts);
+          stats.UpdateTimeStamp(ts);
+          for (unsigned int ch = 0; ch < nrows; ++ch) sum += peds.PedMean(ch);
+          for (unsigned int ch = 0; ch < nrows; ++ch) sum += stats.Status(ch);
+        });
+        (coordinated? coordinated_times: serial_times).push_back(t);
+      }
+    }
+
+    printRow("first event (DBFolder)", folder_times);
+    printRow("first event (DBFolder, gzip)", gzip_times);
+    printRow("first event (pedestals)", pedestal_times);
+    printRow("first event (channel status)", status_times);
+    printRow("first event (both, serial)", serial_times);
+    printRow("first event (both, coordinated)", coordinated_times);
+    std::cout << "Bytes on the wire (DBFolder): " << plain_bytes
+      << ", with gzip: " << gzip_bytes << "\n";
+    std::cout << "Requests served: " << server.Requests()
+      << " (checksum " << sum << ")" << std::endl;
+    if (std::getenv("DBFOLDER_BENCHMARK_STATS"))
+      lariov::DBFolderStats::writeJSON(std::cout);
+  }
+  catch (std::exception const& e) {
+    std::cerr << "DBFolder_benchmark: " << e.what() << std::endl;
+    status = 1;
+  }
+
+  server.Stop();
+  std::remove((dir + "/" + PedestalFolder + ".db").c_str());
+  std::remove((dir + "/" + StatusFolder + ".db").c_str());
+  rmdir(dir.c_str());
+  return status;
+}
@@ -0,0 +1,223 @@
+/**
+ * @file   DBSharedCache_test.cxx
+ * @brief  Node-wide shared memory dataset cache
+ * @see    DBSharedCache.h
+ *
+ * Published datasets must be found by other caches of the same user, folder,
+ * tag and source, and only for times inside their IOV; the number of datasets
+ * and their total size must stay within the limits (if any); objects must be private to
+ * the user, and objects that are corrupted or owned by someone else must give
+ * a miss.
+ */
+
+// Boost libraries
+#define BOOST_TEST_MODULE ( dbsharedcache_test )
+#include <cetlib/quiet_unit_test.hpp> // BOOST_AUTO_TEST_CASE()
+#include <boost/test/test_tools.hpp> // BOOST_CHECK(), BOOST_CHECK_EQUAL()
+
+// LArSoft libraries
+#include "larevt/CalibrationDBI/Providers/DBSharedCache.h"
+
+// C/C++ standard libraries
+#include <sstream>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace {
+
+  /// Dataset of `n` channels with IOV [begin, end)
+  lariov::DBDataset MakeDataset(lariov::IOVTimeStamp const& begin, lariov::IOVTimeStamp const& end,
+                                long n = 10)
+  {
+    lariov::DBDataset data(begin, end, { "channel", "mean" }, { "integer", "real" });
+    for (long ch = 0; ch < n; ++ch) {
+      data.appendLong(0, ch);
+      data.appendDouble(1, begin.Stamp() + 0.5 * ch);
+    }
+    return data;
+  }
+
+  /// Size of the published form of a dataset
+  size_t SnapshotSize(lariov::DBDataset const& data, std::string const& folder) {
+    std::ostringstream out;
+    data.writeSnapshot(out, folder, "v1");
+    return out.str().size();
+  }
+
+  /// Mode and owner of a shared memory object; false if there is no such object
+  bool Stat(std::string const& name, struct stat& st) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+    bool ok = fstat(fd, &st) == 0;
+    close(fd);
+    return ok;
+  }
+
+  /// Folder name private to this test process, and caches removed at the end
+  struct SharedCacheFixture {
+    std::string folder = "DBSharedCache_test_" + std::to_string(getpid());
+    ~SharedCacheFixture() {
+      for (std::string const& f: { folder, folder + "_big" })
+        lariov::DBSharedCache(f, "v1", "sqlite", 1, 0, 0).clear();
+    }
+  };
+
+  lariov::IOVTimeStamp const T0(1500000000, 0);
+  lariov::IOVTimeStamp const T1(1500000100, 0);
+  lariov::IOVTimeStamp const T2(1500000200, 0);
+  lariov::IOVTimeStamp const T3(1500000300, 0);
+  lariov::IOVTimeStamp const T4(1500000400, 0);
+
+  size_t const kMB = 1024 * 1024;
+
+} // local namespace
+
+
+BOOST_FIXTURE_TEST_SUITE(DBSharedCacheTests, SharedCacheFixture)
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(StoreAndFind) {
+
+  lariov::DBSharedCache cache(folder, "v1", "sqlite", 10, kMB, 600);
+  BOOST_CHECK(cache.prefix().find("/lardb_" + std::to_string(geteuid()) + "_") == 0);
+  BOOST_CHECK(!cache.find(T0)); // no index yet
+
+  BOOST_REQUIRE(cache.store(MakeDataset(T0, T1)));
+  BOOST_REQUIRE(cache.store(MakeDataset(T2, T3)));
+  BOOST_CHECK(!cache.store(lariov::DBDataset())); // empty
+
+  // hits, also from another cache of the same folder, tag and source
+  lariov::DBSharedCache other(folder, "v1", "sqlite", 10, kMB, 600);
+  for (lariov::IOVTimeStamp const& ts: { T0, lariov::IOVTimeStamp(1500000099, 999999), T2 }) {
+    auto data = other.find(ts);
+    BOOST_REQUIRE(data);
+    BOOST_CHECK(ts >= data->beginTime() && ts < data->endTime());
+    BOOST_CHECK_EQUAL(data->nrows(), 10U);
+    BOOST_CHECK_EQUAL(data->getDoubleData(3, 1), data->beginTime().Stamp() + 1.5);
+  }
+
+  // misses: before, between and after the published IOVs
+  for (lariov::IOVTimeStamp const& ts: { lariov::IOVTimeStamp(1499999999, 0), T1, T3, T4 })
+    BOOST_CHECK(!cache.find(ts));
+
+  // tag and source are separate
+  BOOST_CHECK(!lariov::DBSharedCache(folder, "v2", "sqlite", 10, kMB, 600).find(T0));
+  BOOST_CHECK(!lariov::DBSharedCache(folder, "v1", "http", 10, kMB, 600).find(T0));
+
+  // open ended datasets are used for a limited time only
+  BOOST_REQUIRE(cache.store(MakeDataset(T3, lariov::IOVTimeStamp::MaxTimeStamp())));
+  BOOST_CHECK(cache.find(T4));
+  BOOST_CHECK(!lariov::DBSharedCache(folder, "v1", "sqlite", 10, kMB, 0).find(T4));
+
+  // clear
+  cache.clear();
+  BOOST_CHECK(!other.find(T0));
+  BOOST_CHECK(!other.find(T2));
+
+} // BOOST_AUTO_TEST_CASE(StoreAndFind)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(Limits) {
+
+  // slots: the oldest dataset is evicted; attached datasets stay readable
+  {
+    lariov::DBSharedCache cache(folder, "v1", "sqlite", 2, kMB, 600);
+    auto first = cache.store(MakeDataset(T0, T1));
+    BOOST_REQUIRE(first);
+    BOOST_REQUIRE(cache.store(MakeDataset(T1, T2)));
+    BOOST_REQUIRE(cache.store(MakeDataset(T2, T3)));
+    BOOST_CHECK(!cache.find(T0));
+    BOOST_CHECK(cache.find(T1));
+    BOOST_CHECK(cache.find(T2));
+    BOOST_CHECK_EQUAL(first->getDoubleData(3, 1), T0.Stamp() + 1.5);
+    cache.clear();
+  }
+
+  // bytes: room for two datasets in ten slots
+  std::string const big = folder + "_big";
+  size_t const size = SnapshotSize(MakeDataset(T0, T1, 1000), big);
+  lariov::DBSharedCache cache(big, "v1", "sqlite", 10, 2 * size + size / 2, 600);
+  BOOST_REQUIRE(cache.store(MakeDataset(T0, T1, 1000)));
+  BOOST_REQUIRE(cache.store(MakeDataset(T1, T2, 1000)));
+  BOOST_CHECK(cache.find(T0));
+  BOOST_REQUIRE(cache.store(MakeDataset(T2, T3, 1000)));
+  BOOST_CHECK(!cache.find(T0));
+  BOOST_CHECK(cache.find(T1));
+  BOOST_CHECK(cache.find(T2));
+
+  // a small dataset still fits next to two big ones...
+  BOOST_REQUIRE(cache.store(MakeDataset(T3, T4, 10)));
+  BOOST_CHECK(cache.find(T1));
+
+  // ...and a dataset above the limit is not published at all
+  BOOST_CHECK(!cache.store(MakeDataset(T4, lariov::IOVTimeStamp::MaxTimeStamp(), 3000)));
+  BOOST_CHECK(cache.find(T1));
+  BOOST_CHECK(cache.find(T3));
+
+  // no byte limit
+  lariov::DBSharedCache unlimited(big, "v1", "sqlite", 10, 0, 600);
+  BOOST_CHECK(unlimited.store(MakeDataset(T4, lariov::IOVTimeStamp::MaxTimeStamp(), 3000)));
+  BOOST_CHECK(unlimited.find(T1));
+  BOOST_CHECK(unlimited.find(T4));
+
+} // BOOST_AUTO_TEST_CASE(Limits)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(Ownership) {
+
+  lariov::DBSharedCache cache(folder, "v1", "sqlite", 10, kMB, 600);
+  BOOST_REQUIRE(cache.store(MakeDataset(T0, T1)));
+  BOOST_REQUIRE(cache.store(MakeDataset(T1, T2)));
+
+  // private to the user
+  for (std::string const& name: { cache.prefix() + "_index", cache.prefix() + "_0" }) {
+    struct stat st;
+    BOOST_REQUIRE(Stat(name, st));
+    BOOST_CHECK_EQUAL(st.st_uid, geteuid());
+    BOOST_CHECK_EQUAL(st.st_mode & 077, 0U);
+  }
+
+  // corrupted dataset: a miss
+  {
+    int fd = shm_open((cache.prefix() + "_0").c_str(), O_RDWR, 0);
+    BOOST_REQUIRE(fd >= 0);
+    char c = 0;
+    BOOST_CHECK_EQUAL(pread(fd, &c, 1, 200), 1);
+    c ^= 0x10;
+    BOOST_CHECK_EQUAL(pwrite(fd, &c, 1, 200), 1);
+    close(fd);
+  }
+  BOOST_CHECK(!cache.find(T0));
+  BOOST_CHECK(cache.find(T1));
+
+  // objects of another user are not trusted (only root can make them here)
+  if (geteuid() == 0) {
+    int fd = shm_open((cache.prefix() + "_1").c_str(), O_RDWR, 0);
+    BOOST_REQUIRE(fd >= 0);
+    BOOST_CHECK_EQUAL(fchown(fd, 1, 1), 0);
+    close(fd);
+    BOOST_CHECK(!cache.find(T1));
+
+    fd = shm_open((cache.prefix() + "_index").c_str(), O_RDWR, 0);
+    BOOST_REQUIRE(fd >= 0);
+    BOOST_CHECK_EQUAL(fchown(fd, 1, 1), 0);
+    close(fd);
+    BOOST_CHECK(!cache.find(T1));
+    BOOST_CHECK(!cache.store(MakeDataset(T2, T3)));
+
+    // give the index back, so that the fixture can clear the cache
+    fd = shm_open((cache.prefix() + "_index").c_str(), O_RDWR, 0);
+    BOOST_REQUIRE(fd >= 0);
+    BOOST_CHECK_EQUAL(fchown(fd, geteuid(), getegid()), 0);
+    close(fd);
+  }
+
+} // BOOST_AUTO_TEST_CASE(Ownership)
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,535 @@
+/**
+ * @file   DBTestServer.cxx
+ * @brief  Loopback stand-in for the conditions database web server
+ * @see    DBTestServer.h
+ */
+
+#include "DBTestServer.h"
+
+// LArSoft libraries
+#include "larevt/CalibrationDBI/Providers/DBFolder.h"
+
+// C/C++ standard and POSIX libraries
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "sqlite3.h"
+#include "zlib.h"
+
+namespace {
+
+  // Compresses a response body with gzip framing.
+  std::string gzipCompress(std::string const& data) {
+    z_stream zs {};
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      throw std::runtime_error("deflateInit2 failed");
+    std::string result(deflateBound(&zs, data.size()), '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = data.size();
+    zs.next_out = reinterpret_cast<Bytef*>(&result[0]);
+    zs.avail_out = result.size();
+    int const res = deflate(&zs, Z_FINISH);
+    result.resize(zs.total_out);
+    deflateEnd(&zs);
+    if (res != Z_STREAM_END) throw std::runtime_error("deflate failed");
+    return result;
+  }
+
+  // Whether the request header accepts gzip content encoding.
+  bool acceptsGzip(std::string request) {
+    std::transform(request.begin(), request.end(), request.begin(), ::tolower);
+    std::string::size_type pos = request.find("\r\naccept-encoding:");
+    if (pos == std::string::npos) return false;
+    return request.substr(pos, request.find("\r\n", pos + 2) - pos).find("gzip")
+      != std::string::npos;
+  }
+
+  // Decodes %xx and '+' in a query string value.
+  std::string urlDecode(std::string const& s) {
+    std::string result;
+    for (size_t i = 0; i < s.size(); ++i) {
+      if (s[i] == '%' && i + 2 < s.size()) {
+        result += char(std::strtol(s.substr(i + 1, 2).c_str(), nullptr, 16));
+        i += 2;
+      }
+      else if (s[i] == '+') result += ' ';
+      else result += s[i];
+    }
+    return result;
+  } // urlDecode()
+
+  // Parses the query string of a request target.
+  std::map<std::string, std::string> parseQuery(std::string const& target) {
+    std::map<std::string, std::string> result;
+    std::string::size_type pos = target.find('?');
+    while (pos != std::string::npos) {
+      std::string::size_type end = target.find('&', pos + 1);
+      std::string item = target.substr(pos + 1, end == std::string::npos? end: end - pos - 1);
+      std::string::size_type eq = item.find('=');
+      if (eq != std::string::npos)
+        result[urlDecode(item.substr(0, eq))] = urlDecode(item.substr(eq + 1));
+      pos = end;
+    }
+    return result;
+  } // parseQuery()
+
+  // Formats an IOV time as the server does.
+  std::string formatTime(sqlite3_int64 t) {
+    return std::to_string(t) + ".000000";
+  }
+
+  // Appends a text field, quoted if needed.
+  void appendText(std::string& out, const char* text, int n) {
+    std::string value(text, n);
+    if (value.find_first_of(",\"\n") == std::string::npos) {
+      out += value;
+      return;
+    }
+    out += '"';
+    for (char c: value) {
+      if (c == '"') out += '"';
+      out += c;
+    }
+    out += '"';
+  } // appendText()
+
+  // Owns an sqlite connection.
+  class SQLiteConnection {
+  public:
+    SQLiteConnection(std::string const& path, int flags) {
+      if (sqlite3_open_v2(path.c_str(), &fDB, flags, nullptr) != SQLITE_OK) {
+        std::string msg = "Unable to open " + path + ": " + sqlite3_errmsg(fDB);
+        sqlite3_close(fDB);
+        throw std::runtime_error(msg);
+      }
+    }
+    ~SQLiteConnection() { sqlite3_close(fDB); }
+    SQLiteConnection(SQLiteConnection const&) = delete;
+    SQLiteConnection& operator= (SQLiteConnection const&) = delete;
+    sqlite3* get() const { return fDB; }
+    void exec(std::string const& sql) {
+      char* err = nullptr;
+      if (sqlite3_exec(fDB, sql.c_str(), nullptr, nullptr, &err) != SQLITE_OK) {
+        std::string msg = "sqlite error in \"" + sql + "\": " + (err? err: "");
+        sqlite3_free(err);
+        throw std::runtime_error(msg);
+      }
+    }
+  private:
+    sqlite3* fDB = nullptr;
+  }; // class SQLiteConnection
+
+  // Owns a prepared statement.
+  class SQLiteStatement {
+  public:
+    SQLiteStatement(sqlite3* db, std::string const& sql) {
+      if (sqlite3_prepare_v2(db, sql.c_str(), -1, &fStmt, nullptr) != SQLITE_OK)
+        throw std::runtime_error("sqlite error preparing \"" + sql + "\": " + sqlite3_errmsg(db));
+    }
+    ~SQLiteStatement() { sqlite3_finalize(fStmt); }
+    SQLiteStatement(SQLiteStatement const&) = delete;
+    SQLiteStatement& operator= (SQLiteStatement const&) = delete;
+    sqlite3_stmt* get() const { return fStmt; }
+  private:
+    sqlite3_stmt* fStmt = nullptr;
+  }; // class SQLiteStatement
+
+} // local namespace
+
+
+namespace lariov {
+
+  //----------------------------------------------------------------------------
+  DBTestServer::DBTestServer(std::string dir)
+    : fDir(std::move(dir))
+    , fRandom(12345)
+  {}
+
+
+  //----------------------------------------------------------------------------
+  DBTestServer::~DBTestServer() { Stop(); }
+
+
+  //----------------------------------------------------------------------------
+  void DBTestServer::Start() {
+    if (fRunning) return;
+
+    fListenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fListenFd < 0) throw std::runtime_error("DBTestServer: socket() failed");
+    int on = 1;
+    setsockopt(fListenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+    if (bind(fListenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+      || listen(fListenFd, 64) != 0
+      || getsockname(fListenFd, reinterpret_cast<sockaddr*>(&addr), &len) != 0)
+    {
+      close(fListenFd);
+      fListenFd = -1;
+      throw std::runtime_error("DBTestServer: unable to listen on loopback");
+    }
+    fPort = ntohs(addr.sin_port);
+
+    fRunning = true;
+    fAcceptThread = std::thread([this]{ Serve(); });
+  } // DBTestServer::Start()
+
+
+  //----------------------------------------------------------------------------
+  void DBTestServer::Stop() {
+    if (!fRunning) return;
+    fRunning = false;
+    fAcceptThread.join();
+    close(fListenFd);
+    fListenFd = -1;
+
+    std::vector<std::thread> workers;
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      workers.swap(fWorkers);
+    }
+    for (std::thread& worker: workers) worker.join();
+  } // DBTestServer::Stop()
+
+
+  //----------------------------------------------------------------------------
+  std::string DBTestServer::URL() const {
+    return "http://127.0.0.1:" + std::to_string(fPort);
+  }
+
+
+  //----------------------------------------------------------------------------
+  void DBTestServer::SetLatency(double seconds, double jitter) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fLatency = seconds;
+    fJitter = jitter;
+  }
+
+  void DBTestServer::SetFailureRate(double rate, int status) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fFailureRate = rate;
+    fFailureStatus = status;
+  }
+
+  void DBTestServer::FailNext(unsigned int n, int status) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fFailNext = n;
+    fFailNextStatus = status;
+  }
+
+  void DBTestServer::SetPayloadScale(unsigned int n) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fPayloadScale = std::max(n, 1U);
+  }
+
+
+  //----------------------------------------------------------------------------
+  void DBTestServer::Serve() {
+    while (fRunning) {
+      pollfd pfd { fListenFd, POLLIN, 0 };
+      if (poll(&pfd, 1, 50) <= 0) continue;
+      int fd = accept(fListenFd, nullptr, nullptr);
+      if (fd < 0) continue;
+      std::lock_guard<std::mutex> lock(fMutex);
+      fWorkers.emplace_back([this, fd]{ Handle(fd); });
+    }
+  } // DBTestServer::Serve()
+
+
+  //----------------------------------------------------------------------------
+  void DBTestServer::Handle(int fd) {
+
+    // read the request header
+    std::string request;
+    char buffer[4096];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 65536) {
+      ssize_t n = read(fd, buffer, sizeof(buffer));
+      if (n <= 0) break;
+      request.append(buffer, n);
+    }
+    ++fRequests;
+
+    // draw the behaviour of this request
+    double delay = 0.;
+    int status = 0;
+    unsigned int scale = 1;
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      delay = fLatency;
+      if (fJitter > 0.)
+        delay += std::uniform_real_distribution<double>(0., fJitter)(fRandom);
+      if (fFailNext > 0) {
+        --fFailNext;
+        status = fFailNextStatus;
+      }
+      else if (fFailureRate > 0.
+        && std::uniform_real_distribution<double>(0., 1.)(fRandom) < fFailureRate)
+      {
+        status = fFailureStatus;
+      }
+      scale = fPayloadScale;
+    }
+
+    std::string body;
+    if (status == 0) {
+      std::string::size_type begin = request.find(' ');
+      std::string::size_type end = request.find(' ', begin + 1);
+      if (request.compare(0, 4, "GET ") != 0 || end == std::string::npos) {
+        status = 400;
+        body = "Bad request";
+      }
+      else {
+        try {
+          status = Respond(request.substr(begin + 1, end - begin - 1), scale, body);
+        }
+        catch (std::exception const& e) {
+          status = 500;
+          body = e.what();
+        }
+      }
+    }
+    else body = "Injected failure";
+    if (status != 200) ++fFailures;
+    bool const gzip = (status == 200) && acceptsGzip(request);
+    if (gzip) body = gzipCompress(body);
+    fBytesSent += body.size();
+
+    if (delay > 0.)
+      std::this_thread::sleep_for(std::chrono::duration<double>(delay));
+    ++fResponses;
+
+    std::ostringstream header;
+    header << "HTTP/1.1 " << status << (status == 200? " OK": " Error") << "\r\n"
+      << "Content-Type: text/plain\r\n"
+      << (gzip? "Content-Encoding: gzip\r\n": "")
+      << "Content-Length: " << body.size() << "\r\n"
+      << "Connection: close\r\n\r\n";
+    std::string response = header.str() + body;
+    size_t written = 0;
+    while (written < response.size()) {
+      ssize_t n = write(fd, response.data() + written, response.size() - written);
+      if (n <= 0) break;
+      written += n;
+    }
+    close(fd);
+  } // DBTestServer::Handle()
+
+
+  //----------------------------------------------------------------------------
+  int DBTestServer::Respond
+    (std::string const& target, unsigned int scale, std::string& body) const
+  {
+    bool const iovs = (target.compare(0, 5, "/iovs") == 0);
+    if (!iovs && target.compare(0, 5, "/data") != 0) {
+      body = "Unknown request " + target;
+      return 404;
+    }
+    std::map<std::string, std::string> query = parseQuery(target);
+    std::string const& folder = query["f"];
+    std::string const& tag = query["tag"];
+    double t = std::strtod(query["t"].c_str(), nullptr);
+    if (folder.empty() || folder.find('/') != std::string::npos) {
+      body = "Missing folder";
+      return 400;
+    }
+
+    SQLiteConnection db(fDir + "/" + folder + ".db", SQLITE_OPEN_READONLY);
+
+    // IOV list: one begin time per line
+    if (iovs) {
+      SQLiteStatement list(db.get(),
+        "SELECT DISTINCT i.begin_time FROM " + folder + "_iovs i, " + folder + "_tag_iovs g"
+        " WHERE g.tag=?1 AND g.iov_id=i.iov_id ORDER BY i.begin_time");
+      sqlite3_bind_text(list.get(), 1, tag.c_str(), -1, SQLITE_TRANSIENT);
+      body.clear();
+      while (sqlite3_step(list.get()) == SQLITE_ROW)
+        body += formatTime(sqlite3_column_int64(list.get(), 0)) + "\n";
+      return 200;
+    }
+
+    // IOV
+    SQLiteStatement iov(db.get(),
+      "SELECT (SELECT MAX(i.begin_time) FROM " + folder + "_iovs i, " + folder + "_tag_iovs g"
+      " WHERE g.tag=?1 AND g.iov_id=i.iov_id AND i.begin_time <= ?2),"
+      " (SELECT MIN(i.begin_time) FROM " + folder + "_iovs i, " + folder + "_tag_iovs g"
+      " WHERE g.tag=?1 AND g.iov_id=i.iov_id AND i.begin_time > ?2)");
+    sqlite3_bind_text(iov.get(), 1, tag.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_double(iov.get(), 2, t);
+    if (sqlite3_step(iov.get()) != SQLITE_ROW || sqlite3_column_type(iov.get(), 0) == SQLITE_NULL) {
+      body = "No data for folder " + folder + " at " + query["t"];
+      return 404;
+    }
+    body = formatTime(sqlite3_column_int64(iov.get(), 0)) + "\n";
+    body += (sqlite3_column_type(iov.get(), 1) == SQLITE_NULL)
+      ? std::string("-")
+      : formatTime(sqlite3_column_int64(iov.get(), 1));
+    body += "\n";
+
+    // most recent values of each channel
+    SQLiteStatement data(db.get(),
+      "SELECT d.* FROM " + folder + "_data d, " + folder + "_iovs i, " + folder + "_tag_iovs g"
+      " WHERE g.tag=?1 AND g.iov_id=i.iov_id AND d.__iov_id=i.iov_id AND i.begin_time <= ?2"
+      " ORDER BY d.channel, i.begin_time DESC");
+    sqlite3_bind_text(data.get(), 1, tag.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_double(data.get(), 2, t);
+
+    sqlite3_stmt* stmt = data.get();
+    std::vector<int> columns;
+    int chcol = -1;
+    std::string names, types;
+    for (int col = 0; col < sqlite3_column_count(stmt); ++col) {
+      std::string name = sqlite3_column_name(stmt, col);
+      if (name == "__iov_id") continue;
+      if (name == "channel") chcol = col;
+      std::string type = sqlite3_column_decltype(stmt, col)? sqlite3_column_decltype(stmt, col): "";
+      std::transform(type.begin(), type.end(), type.begin(), ::tolower);
+      if (!columns.empty()) { names += ','; types += ','; }
+      names += name;
+      types += type;
+      columns.push_back(col);
+    }
+    if (chcol != columns.front()) {
+      body = "Folder " + folder + " does not start with a channel column";
+      return 500;
+    }
+    body += names + "\n" + types + "\n";
+
+    // rows, repeated with shifted channel numbers to scale the payload
+    std::vector<std::string> rows;
+    std::vector<sqlite3_int64> channels;
+    std::unordered_set<sqlite3_int64> seen;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      sqlite3_int64 channel = sqlite3_column_int64(stmt, chcol);
+      if (!seen.insert(channel).second) continue;
+      std::string row;
+      for (size_t i = 1; i < columns.size(); ++i) {
+        int col = columns[i];
+        row += ',';
+        switch (sqlite3_column_type(stmt, col)) {
+          case SQLITE_INTEGER:
+            row += std::to_string(sqlite3_column_int64(stmt, col));
+            break;
+          case SQLITE_FLOAT: {
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "%.17g", sqlite3_column_double(stmt, col));
+            row += buffer;
+            break;
+          }
+          case SQLITE_NULL:
+            break;
+          default:
+            appendText(row, reinterpret_cast<const char*>(sqlite3_column_text(stmt, col)),
+              sqlite3_column_bytes(stmt, col));
+        } // switch
+      }
+      rows.push_back(std::move(row));
+      channels.push_back(channel);
+    }
+    sqlite3_int64 stride = channels.empty()? 0: channels.back() + 1;
+    for (unsigned int copy = 0; copy < scale; ++copy) {
+      for (size_t i = 0; i < rows.size(); ++i) {
+        body += std::to_string(channels[i] + copy * stride);
+        body += rows[i];
+        body += '\n';
+      }
+    }
+    return 200;
+  } // DBTestServer::Respond()
+
+
+  //----------------------------------------------------------------------------
+  void DBTestServer::MakeDatabase(
+    std::string const& path, std::string const& folder,
+    std::vector<ColumnSpec_t> const& columns,
+    unsigned int nchannels, std::vector<long> const& iov_begins,
+    std::string const& tag
+  ) {
+    std::remove(path.c_str());
+    SQLiteConnection db(path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+
+    std::string coldefs;
+    std::string params;
+    for (size_t i = 0; i < columns.size(); ++i) {
+      coldefs += ", " + columns[i].first + " " + columns[i].second;
+      params += ",?" + std::to_string(i + 3);
+    }
+    db.exec("CREATE TABLE " + folder + "_iovs (iov_id integer primary key, begin_time integer)");
+    db.exec("CREATE TABLE " + folder + "_tag_iovs (tag text, iov_id integer)");
+    db.exec("CREATE TABLE " + folder + "_data (__iov_id integer, channel integer" + coldefs + ")");
+    db.exec("BEGIN");
+
+    SQLiteStatement insert_iov(db.get(), "INSERT INTO " + folder + "_iovs VALUES (?1,?2)");
+    SQLiteStatement insert_tag(db.get(), "INSERT INTO " + folder + "_tag_iovs VALUES (?1,?2)");
+    SQLiteStatement insert_data(db.get(),
+      "INSERT INTO " + folder + "_data VALUES (?1,?2" + params + ")");
+    for (unsigned int iov = 0; iov < iov_begins.size(); ++iov) {
+      sqlite3_bind_int64(insert_iov.get(), 1, iov + 1);
+      sqlite3_bind_int64(insert_iov.get(), 2, iov_begins[iov]);
+      sqlite3_step(insert_iov.get());
+      sqlite3_reset(insert_iov.get());
+      sqlite3_bind_text(insert_tag.get(), 1, tag.c_str(), -1, SQLITE_TRANSIENT);
+      sqlite3_bind_int64(insert_tag.get(), 2, iov + 1);
+      sqlite3_step(insert_tag.get());
+      sqlite3_reset(insert_tag.get());
+
+      for (unsigned int channel = 0; channel < nchannels; ++channel) {
+        if (LastUpdate(channel, iov) != iov) continue;
+        sqlite3_stmt* stmt = insert_data.get();
+        sqlite3_bind_int64(stmt, 1, iov + 1);
+        sqlite3_bind_int64(stmt, 2, channel);
+        for (unsigned int col = 0; col < columns.size(); ++col) {
+          std::string const& type = columns[col].second;
+          if (type == "integer" || type == "bigint" || type == "boolean")
+            sqlite3_bind_int64(stmt, col + 3, TestLong(channel, iov, col));
+          else if (type == "text")
+            sqlite3_bind_text(stmt, col + 3, TestText(channel, iov, col).c_str(), -1, SQLITE_TRANSIENT);
+          else
+            sqlite3_bind_double(stmt, col + 3, TestValue(channel, iov, col));
+        }
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+          throw std::runtime_error("DBTestServer: unable to fill " + path);
+        sqlite3_reset(stmt);
+      }
+    }
+    db.exec("COMMIT");
+
+    // indexes as recommended for DBFolder sqlite access
+    lariov::DBFolder::EnsureSQLiteIndexes(path, folder, true);
+  } // DBTestServer::MakeDatabase()
+
+
+  //----------------------------------------------------------------------------
+  double DBTestServer::TestValue(unsigned int channel, unsigned int iov, unsigned int col) {
+    return 400. + 0.25 * channel + 0.5 * iov + col;
+  }
+
+  long DBTestServer::TestLong(unsigned int channel, unsigned int iov, unsigned int col) {
+    return (channel + iov + col) % 5;
+  }
+
+  std::string DBTestServer::TestText(unsigned int channel, unsigned int iov, unsigned int col) {
+    return "c" + std::to_string(channel) + "_" + std::to_string(iov) + "_" + std::to_string(col);
+  }
+
+  unsigned int DBTestServer::LastUpdate(unsigned int channel, unsigned int iov) {
+    if (iov == 0 || (channel + iov) % 2 == 0) return iov;
+    return iov - 1;
+  }
+
+} // namespace lariov
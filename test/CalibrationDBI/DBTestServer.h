@@ -0,0 +1,149 @@
+/**
+ * @file   DBTestServer.h
+ * @brief  Loopback stand-in for the conditions database web server
+ *
+ * DBTestServer answers `/data?f=<folder>&t=<time>&tag=<tag>` requests the way
+ * the conditions database web server does, using local sqlite files
+ * `<dir>/<folder>.db` in the layout also read by DBFolder (tables
+ * `<folder>_iovs`, `<folder>_tag_iovs` and `<folder>_data`).
+ *
+ * The response contains the IOV begin and end times, the column names, the
+ * column types, and one row per channel with the most recent values at the
+ * requested time (partial IOVs are merged).
+ *
+ * `/iovs?f=<folder>&tag=<tag>` requests are answered with the IOV begin
+ * times of the tag, one per line, in increasing order.
+ *
+ * Responses are gzip compressed when the request accepts it.
+ *
+ * Latency, failures and payload size can be configured while the server
+ * is running, for fetch performance and error handling tests.
+ */
+
+#ifndef LAREVT_TEST_CALIBRATIONDBI_DBTESTSERVER_H
+#define LAREVT_TEST_CALIBRATIONDBI_DBTESTSERVER_H
+
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace lariov {
+
+  class DBTestServer {
+
+  public:
+
+    /// Column name and sqlite type, used to create test databases
+    typedef std::pair<std::string, std::string> ColumnSpec_t;
+
+    /// Serves folders from sqlite files in directory `dir`
+    explicit DBTestServer(std::string dir);
+
+    /// Stops the server
+    ~DBTestServer();
+
+    DBTestServer(DBTestServer const&) = delete;
+    DBTestServer& operator= (DBTestServer const&) = delete;
+
+    /// Starts listening on an ephemeral loopback port
+    void Start();
+
+    /// Stops listening and waits for requests in progress
+    void Stop();
+
+    /// Base URL to configure DBFolder with (valid after Start())
+    std::string URL() const;
+
+    /// Sets the delay before each response (seconds), with uniform jitter
+    void SetLatency(double seconds, double jitter = 0.);
+
+    /// Fails a random fraction of the requests with the specified HTTP status
+    void SetFailureRate(double rate, int status = 503);
+
+    /// Fails the next `n` requests with the specified HTTP status
+    void FailNext(unsigned int n, int status = 503);
+
+    /// Repeats each channel `n` times (with shifted channel numbers)
+    void SetPayloadScale(unsigned int n);
+
+    /// Number of requests received so far
+    unsigned int Requests() const { return fRequests; }
+
+    /// Number of responses sent (or being sent) so far, after their latency
+    unsigned int Responses() const { return fResponses; }
+
+    /// Number of requests answered with an error so far
+    unsigned int Failures() const { return fFailures; }
+
+    /// Number of response body bytes sent so far (after compression)
+    unsigned long BytesSent() const { return fBytesSent; }
+
+    /**
+     * @brief Creates a test database for a folder
+     * @param path sqlite file to be (re)created
+     * @param folder folder name
+     * @param columns data columns (the channel column is added)
+     * @param nchannels number of channels
+     * @param iov_begins begin times of the IOVs (seconds), all tagged `tag`
+     * @param tag tag of the IOVs
+     *
+     * The first IOV contains all channels; later IOVs are partial and update
+     * only every other channel.  Values are deterministic functions of
+     * channel, IOV and column number: `TestValue()` for real columns,
+     * `TestLong()` for integer columns (a valid channel status) and
+     * `TestText()` for text columns.  The indexes used by DBFolder are
+     * created as well.
+     */
+    static void MakeDatabase(std::string const& path, std::string const& folder,
+                             std::vector<ColumnSpec_t> const& columns,
+                             unsigned int nchannels,
+                             std::vector<long> const& iov_begins,
+                             std::string const& tag = "v1");
+
+    /// Values stored by MakeDatabase() for a channel, IOV index and column
+    static double TestValue(unsigned int channel, unsigned int iov, unsigned int col);
+    static long TestLong(unsigned int channel, unsigned int iov, unsigned int col);
+    static std::string TestText(unsigned int channel, unsigned int iov, unsigned int col);
+
+    /// IOV index of the value of a channel at IOV index `iov`
+    static unsigned int LastUpdate(unsigned int channel, unsigned int iov);
+
+  private:
+
+    void Serve();
+    void Handle(int fd);
+
+    /// Fills the body for a request target; returns the HTTP status
+    int Respond(std::string const& target, unsigned int scale, std::string& body) const;
+
+    std::string fDir;
+    int fListenFd = -1;
+    int fPort = 0;
+    std::atomic<bool> fRunning { false };
+    std::thread fAcceptThread;
+
+    std::mutex fMutex; // protects the members below
+    std::vector<std::thread> fWorkers;
+    double fLatency = 0.;
+    double fJitter = 0.;
+    double fFailureRate = 0.;
+    int fFailureStatus = 503;
+    unsigned int fFailNext = 0;
+    int fFailNextStatus = 503;
+    unsigned int fPayloadScale = 1;
+    std::mt19937 fRandom;
+
+    std::atomic<unsigned int> fRequests { 0 };
+    std::atomic<unsigned int> fResponses { 0 };
+    std::atomic<unsigned int> fFailures { 0 };
+    std::atomic<unsigned long> fBytesSent { 0 };
+
+  }; // class DBTestServer
+
+} // namespace lariov
+
+#endif // LAREVT_TEST_CALIBRATIONDBI_DBTESTSERVER_H
@@ -0,0 +1,620 @@
+/**
+ * @file   DBTestServer_test.cxx
+ * @brief  Test of DBFolder against the loopback conditions database server
+ * @see    DBTestServer.h
+ */
+
+// Boost libraries
+#define BOOST_TEST_MODULE ( dbtestserver_test )
+#include <cetlib/quiet_unit_test.hpp> // BOOST_AUTO_TEST_CASE()
+#include <boost/test/test_tools.hpp> // BOOST_CHECK(), BOOST_CHECK_EQUAL()
+
+// LArSoft libraries
+#include "larevt/CalibrationDBI/Providers/DBBundle.h"
+#include "larevt/CalibrationDBI/Providers/DBFolder.h"
+#include "larevt/CalibrationDBI/Providers/SIOVChannelStatusProvider.h"
+#include "larevt/CalibrationDBI/Providers/WebError.h"
+#include "DBTestServer.h"
+
+// framework libraries
+#include "fhiclcpp/ParameterSet.h"
+#include "cetlib_except/exception.h"
+
+// C/C++ standard libraries
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <sqlite3.h>
+#include <unistd.h>
+
+
+namespace {
+
+  std::string const Folder = "test_folder";
+  std::vector<long> const IOVBegins { 1500001000, 1500002000, 1500003000 };
+  unsigned int const NChannels = 300;
+
+  /// Creates the test database in a fresh directory and serves it
+  struct ServerFixture {
+
+    ServerFixture(): server(MakeDirectory()) { server.Start(); }
+
+    ~ServerFixture() {
+      server.Stop();
+      std::remove((dir + "/" + Folder + ".db").c_str());
+      rmdir(dir.c_str());
+    }
+
+    std::string MakeDirectory() {
+      char tmpl[] = "/tmp/dbtestserverXXXXXX";
+      dir = mkdtemp(tmpl);
+      lariov::DBTestServer::MakeDatabase(dir + "/" + Folder + ".db", Folder,
+        { { "mean", "real" }, { "status", "integer" }, { "label", "text" } },
+        NChannels, IOVBegins);
+      return dir;
+    }
+
+    std::string dir;
+    lariov::DBTestServer server;
+
+  }; // struct ServerFixture
+
+  /// Time stamp in the format used by DBFolder::UpdateData() (ns)
+  lariov::DBTimeStamp_t nanoseconds(long seconds)
+    { return lariov::DBTimeStamp_t(seconds) * 1000000000; }
+
+} // local namespace
+
+
+BOOST_FIXTURE_TEST_SUITE(DBTestServerTests, ServerFixture)
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(PartialIOVs) {
+
+  lariov::DBFolder folder(Folder, server.URL(), "", "v1");
+
+  for (unsigned int iov = 0; iov < IOVBegins.size(); ++iov) {
+    BOOST_CHECK(folder.UpdateData(nanoseconds(IOVBegins[iov] + 10)));
+    BOOST_CHECK_EQUAL(folder.CachedStart().Stamp(), (unsigned long) IOVBegins[iov]);
+    if (iov + 1 < IOVBegins.size())
+      BOOST_CHECK_EQUAL(folder.CachedEnd().Stamp(), (unsigned long) IOVBegins[iov + 1]);
+    else
+      BOOST_CHECK(folder.CachedEnd() == lariov::IOVTimeStamp::MaxTimeStamp());
+    BOOST_CHECK_EQUAL(folder.Channels().size(), NChannels);
+
+    for (unsigned int channel = 0; channel < NChannels; channel += 7) {
+      unsigned int last = lariov::DBTestServer::LastUpdate(channel, iov);
+      double mean = 0.;
+      long status = -1;
+      std::string label;
+      folder.GetNamedChannelData(channel, "mean", mean);
+      folder.GetNamedChannelData(channel, "status", status);
+      folder.GetNamedChannelData(channel, "label", label);
+      BOOST_CHECK_EQUAL(mean, lariov::DBTestServer::TestValue(channel, last, 0));
+      BOOST_CHECK_EQUAL(status, lariov::DBTestServer::TestLong(channel, last, 1));
+      BOOST_CHECK_EQUAL(label, lariov::DBTestServer::TestText(channel, last, 2));
+    }
+  }
+  BOOST_CHECK_EQUAL(server.Requests(), IOVBegins.size());
+
+} // BOOST_AUTO_TEST_CASE(PartialIOVs)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(SameAsSQLite) {
+
+  setenv("FW_SEARCH_PATH", dir.c_str(), 1);
+  lariov::DBFolder http(Folder, server.URL(), "", "v1");
+  lariov::DBFolder sqlite(Folder, "", "", "v1", true);
+
+  for (long begin: IOVBegins) {
+    lariov::DBDataset data;
+    sqlite.GetSQLiteData(begin + 10, data);
+    http.UpdateData(nanoseconds(begin + 10));
+    BOOST_CHECK_EQUAL(data.nrows(), http.Channels().size());
+    for (size_t row = 0; row < data.nrows(); ++row) {
+      double mean = 0.;
+      http.GetNamedChannelData(data.channels()[row], "mean", mean);
+      BOOST_CHECK_EQUAL(mean, data.getDoubleData(row, 1));
+    }
+  }
+
+} // BOOST_AUTO_TEST_CASE(SameAsSQLite)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(ChannelAddedLater) {
+
+  // one more channel, only in the last IOV
+  std::string const path = dir + "/" + Folder + ".db";
+  sqlite3* db = nullptr;
+  BOOST_REQUIRE_EQUAL(sqlite3_open(path.c_str(), &db), SQLITE_OK);
+  std::string const sql = "INSERT INTO " + Folder + "_data (__iov_id, channel, mean, status, label)"
+    " VALUES (" + std::to_string(IOVBegins.size()) + ", " + std::to_string(NChannels) + ", 1.5, 2, 'late')";
+  BOOST_CHECK_EQUAL(sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr), SQLITE_OK);
+  sqlite3_close(db);
+
+  // earlier IOVs do not have it (and are complete without it)
+  setenv("FW_SEARCH_PATH", dir.c_str(), 1);
+  for (bool timeline: { false, true }) {
+    lariov::DBFolder sqlite(Folder, "", "", "v1", true);
+    sqlite.SetTimeline(timeline);
+    for (unsigned int iov = 0; iov < IOVBegins.size(); ++iov) {
+      lariov::DBDataset data;
+      sqlite.GetSQLiteData(IOVBegins[iov] + 10, data);
+      bool const last = (iov + 1 == IOVBegins.size());
+      BOOST_CHECK_EQUAL(data.nrows(), last? NChannels + 1: NChannels);
+      for (unsigned int channel = 0; channel < NChannels; channel += 13) {
+        size_t const row = std::lower_bound(data.channels().begin(), data.channels().end(), channel)
+          - data.channels().begin();
+        BOOST_CHECK_EQUAL(data.getDoubleData(row, 1),
+          lariov::DBTestServer::TestValue(channel, lariov::DBTestServer::LastUpdate(channel, iov), 0));
+      }
+    }
+  }
+
+} // BOOST_AUTO_TEST_CASE(ChannelAddedLater)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(SQLiteValueTypes) {
+
+  // columns whose first value does not tell their type
+  std::string const path = dir + "/mixed.db";
+  sqlite3* db = nullptr;
+  BOOST_REQUIRE_EQUAL(sqlite3_open(path.c_str(), &db), SQLITE_OK);
+  char const* const sql =
+    "CREATE TABLE mixed_iovs (iov_id integer primary key, begin_time integer);"
+    "CREATE TABLE mixed_tag_iovs (tag text, iov_id integer);"
+    "CREATE TABLE mixed_data (__iov_id integer, channel integer, gain numeric, note, scale real, count integer);"
+    "INSERT INTO mixed_iovs VALUES (1, 1500001000);"
+    "INSERT INTO mixed_tag_iovs VALUES ('v1', 1);"
+    "INSERT INTO mixed_data VALUES (1, 0, 400, NULL, 2, NULL);"
+    "INSERT INTO mixed_data VALUES (1, 1, 400.25, 'x', 2.5, 7);"
+    "INSERT INTO mixed_data VALUES (1, 2, NULL, '', NULL, 1.5);";
+  BOOST_CHECK_EQUAL(sqlite3_exec(db, sql, nullptr, nullptr, nullptr), SQLITE_OK);
+  sqlite3_close(db);
+
+  setenv("FW_SEARCH_PATH", dir.c_str(), 1);
+  lariov::DBFolder folder("mixed", "", "", "v1", true);
+  lariov::DBDataset data;
+  folder.GetSQLiteData(1500001010, data);
+  BOOST_REQUIRE_EQUAL(data.nrows(), 3U);
+
+  // numeric: integer first, then real (promoted, not truncated)
+  BOOST_CHECK_EQUAL(data.colKind(1), lariov::DBDataset::kDouble);
+  BOOST_CHECK_EQUAL(data.getDoubleData(0, 1), 400.);
+  BOOST_CHECK_EQUAL(data.getDoubleData(1, 1), 400.25);
+  BOOST_CHECK_EQUAL(data.getDoubleData(2, 1), 0.);
+
+  // undeclared: null first, then text
+  BOOST_CHECK_EQUAL(data.colKind(2), lariov::DBDataset::kString);
+  BOOST_CHECK_EQUAL(data.getStringData(0, 2), "");
+  BOOST_CHECK_EQUAL(data.getStringData(1, 2), "x");
+
+  // declared real with an integer first value, declared integer holding a real
+  BOOST_CHECK_EQUAL(data.colKind(3), lariov::DBDataset::kDouble);
+  BOOST_CHECK_EQUAL(data.getDoubleData(1, 3), 2.5);
+  BOOST_CHECK_EQUAL(data.getDoubleData(1, 4), 7.);
+  BOOST_CHECK_EQUAL(data.getDoubleData(2, 4), 1.5);
+
+  // variant access
+  BOOST_CHECK_EQUAL(std::get<long>(data.getData(1, 0)), 1);
+  BOOST_CHECK_EQUAL(std::get<double>(data.getData(1, 1)), 400.25);
+  BOOST_CHECK_EQUAL(*std::get<std::unique_ptr<std::string>>(data.getData(1, 2)), "x");
+
+  std::remove(path.c_str());
+
+} // BOOST_AUTO_TEST_CASE(SQLiteValueTypes)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(FailuresAndLatency) {
+
+  lariov::DBFolder folder(Folder, server.URL(), "", "v1");
+
+  server.FailNext(1, 503);
+  BOOST_CHECK_THROW(folder.UpdateData(nanoseconds(1500001010)), lariov::WebError);
+  BOOST_CHECK_EQUAL(server.Failures(), 1U);
+
+  // a slow answer is waited for
+  server.SetLatency(0.2);
+  BOOST_CHECK(folder.UpdateData(nanoseconds(1500001010)));
+  BOOST_CHECK_EQUAL(server.Requests(), 2U);
+  BOOST_CHECK_EQUAL(server.Responses(), 2U);
+  BOOST_CHECK_EQUAL(server.Failures(), 1U);
+
+  server.SetLatency(0.);
+  server.SetPayloadScale(3);
+  BOOST_CHECK(folder.UpdateData(nanoseconds(1500002010)));
+  BOOST_CHECK_EQUAL(folder.Channels().size(), 3 * NChannels);
+
+} // BOOST_AUTO_TEST_CASE(FailuresAndLatency)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(HedgingAndFailover) {
+
+  lariov::DBTestServer secondary(dir);
+  secondary.Start();
+
+  // slow primary: the secondary answers first (the hedge delay is 0.05 s,
+  // twenty times shorter than the primary latency)
+  {
+    lariov::DBFolder folder(Folder, server.URL(), secondary.URL(), "v1");
+    folder.SetHedging(true, 0.95, 0.05);
+    folder.SetCacheSize(1);
+
+    // collect enough latency samples for the hedge delay to be used
+    for (unsigned int i = 0; i < 12; ++i)
+      BOOST_CHECK(folder.UpdateData(nanoseconds(IOVBegins[i % IOVBegins.size()] + 10)));
+    BOOST_CHECK_EQUAL(secondary.Requests(), 0U);
+
+    unsigned int const answered = server.Responses();
+    server.SetLatency(1.);
+    BOOST_CHECK(folder.UpdateData(nanoseconds(IOVBegins[1] + 10)));
+    BOOST_CHECK_EQUAL(server.Responses(), answered);
+    BOOST_CHECK_EQUAL(secondary.Requests(), 1U);
+    BOOST_CHECK_EQUAL(secondary.Responses(), 1U);
+    server.SetLatency(0.);
+  } // the folder does not wait for the abandoned primary request...
+  BOOST_CHECK_LT(server.Responses(), server.Requests());
+  while (server.Responses() < server.Requests()) // ...which ends on its own
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  // failing primary: fail over, then stop asking it
+  lariov::DBFolder folder(Folder, server.URL(), secondary.URL(), "v1");
+  folder.SetHedging(true, 0.95, 0.05);
+  folder.SetCircuitBreaker(2, 60.);
+  folder.SetCacheSize(1);
+  unsigned int const primary = server.Requests();
+  unsigned int const secondary_requests = secondary.Requests();
+  server.FailNext(100);
+  BOOST_CHECK(folder.UpdateData(nanoseconds(IOVBegins[2] + 10)));
+  BOOST_CHECK(folder.UpdateData(nanoseconds(IOVBegins[1] + 10)));
+  BOOST_CHECK_EQUAL(server.Requests(), primary + 2);
+  BOOST_CHECK(folder.UpdateData(nanoseconds(IOVBegins[0] + 10)));
+  BOOST_CHECK_EQUAL(server.Requests(), primary + 2);
+  BOOST_CHECK_EQUAL(secondary.Requests(), secondary_requests + 3);
+
+  double mean = 0.;
+  folder.GetNamedChannelData(7, "mean", mean);
+  BOOST_CHECK_EQUAL(mean, lariov::DBTestServer::TestValue(7, 0, 0));
+
+  secondary.Stop();
+
+} // BOOST_AUTO_TEST_CASE(HedgingAndFailover)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(AbandonedHedgeRequests) {
+
+  lariov::DBTestServer secondary(dir);
+  secondary.Start();
+  {
+    lariov::DBFolder folder(Folder, server.URL(), secondary.URL(), "v1");
+    folder.SetHedging(true, 0.95, 0.01);
+    folder.SetCircuitBreaker(1, 60.);
+    folder.SetCacheSize(1);
+    for (unsigned int i = 0; i < 12; ++i)
+      BOOST_CHECK(folder.UpdateData(nanoseconds(IOVBegins[i % IOVBegins.size()] + 10)));
+
+    // slow, failing primary: the secondary wins, and the abandoned primary
+    // request still counts as a failure when it ends
+    unsigned int const primary = server.Requests();
+    server.SetLatency(0.5);
+    server.FailNext(1);
+    BOOST_CHECK(folder.UpdateData(nanoseconds(IOVBegins[1] + 10)));
+    BOOST_CHECK_EQUAL(secondary.Requests(), 1U);
+    while (server.Responses() == primary)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(500)); // answer received
+    server.SetLatency(0.);
+    BOOST_CHECK_EQUAL(server.Requests(), primary + 1);
+
+    // the primary is skipped
+    BOOST_CHECK(folder.UpdateData(nanoseconds(IOVBegins[2] + 10)));
+    BOOST_CHECK_EQUAL(server.Requests(), primary + 1);
+    BOOST_CHECK_EQUAL(secondary.Requests(), 2U);
+
+    // no failover to the skipped primary
+    secondary.FailNext(1);
+    BOOST_CHECK_THROW(folder.UpdateData(nanoseconds(IOVBegins[0] + 10)), lariov::WebError);
+    BOOST_CHECK_EQUAL(server.Requests(), primary + 1);
+    BOOST_CHECK_EQUAL(secondary.Requests(), 3U);
+  }
+
+  // a folder with a request still in flight is destroyed without waiting
+  // for it (compressed transfers are cancelled, libwda requests are left to
+  // end on their own), and the request ends safely after the folder is gone
+  for (bool compressed: { true, false }) {
+    {
+      lariov::DBFolder folder(Folder, server.URL(), secondary.URL(), "v1");
+      folder.SetHedging(true, 0.95, 0.01);
+      folder.SetCompressedTransfer(compressed);
+      for (unsigned int i = 0; i < 12; ++i)
+        BOOST_CHECK(folder.UpdateData(nanoseconds(IOVBegins[i % IOVBegins.size()] + 10)));
+      server.SetLatency(0.5);
+      BOOST_CHECK(folder.UpdateData(nanoseconds(IOVBegins[1] + 10)));
+      server.SetLatency(0.);
+    }
+    BOOST_CHECK_LT(server.Responses(), server.Requests());
+    while (server.Responses() < server.Requests())
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100)); // answer received
+  }
+
+  secondary.Stop();
+
+} // BOOST_AUTO_TEST_CASE(AbandonedHedgeRequests)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(CompressedTransfer) {
+
+  lariov::DBFolder plain(Folder, server.URL(), "", "v1");
+  lariov::DBFolder compressed(Folder, server.URL(), "", "v1");
+  compressed.SetCompressedTransfer(true);
+
+  for (long begin: IOVBegins) {
+    unsigned long const before = server.BytesSent();
+    BOOST_CHECK(plain.UpdateData(nanoseconds(begin + 10)));
+    unsigned long const plain_bytes = server.BytesSent() - before;
+    BOOST_CHECK(compressed.UpdateData(nanoseconds(begin + 10)));
+    unsigned long const compressed_bytes = server.BytesSent() - before - plain_bytes;
+    BOOST_CHECK_LT(2 * compressed_bytes, plain_bytes);
+
+    BOOST_CHECK(compressed.CachedStart() == plain.CachedStart());
+    BOOST_CHECK(compressed.CachedEnd() == plain.CachedEnd());
+    BOOST_CHECK(compressed.Channels() == plain.Channels());
+    for (unsigned int channel = 0; channel < NChannels; channel += 7) {
+      double mean1 = 0., mean2 = 0.;
+      long status1 = -1, status2 = -2;
+      std::string label1, label2;
+      plain.GetNamedChannelData(channel, "mean", mean1);
+      compressed.GetNamedChannelData(channel, "mean", mean2);
+      plain.GetNamedChannelData(channel, "status", status1);
+      compressed.GetNamedChannelData(channel, "status", status2);
+      plain.GetNamedChannelData(channel, "label", label1);
+      compressed.GetNamedChannelData(channel, "label", label2);
+      BOOST_CHECK_EQUAL(mean1, mean2);
+      BOOST_CHECK_EQUAL(status1, status2);
+      BOOST_CHECK_EQUAL(label1, label2);
+    }
+  }
+
+  server.FailNext(1, 503);
+  BOOST_CHECK_THROW(compressed.UpdateData(nanoseconds(IOVBegins[0] + 10)), lariov::WebError);
+
+} // BOOST_AUTO_TEST_CASE(CompressedTransfer)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(DeltaUpdates) {
+
+  fhicl::ParameterSet db;
+  db.put<std::string>("DBFolderName", Folder);
+  db.put<std::string>("DBUrl", server.URL());
+  db.put<std::string>("DBTag", "v1");
+  db.put<bool>("DeltaUpdates", true);
+  fhicl::ParameterSet pset;
+  pset.put<fhicl::ParameterSet>("DatabaseRetrievalAlg", db);
+  pset.put<bool>("UseDB", true);
+  lariov::SIOVChannelStatusProvider provider(pset);
+
+  // first IOV: everything is loaded
+  provider.UpdateTimeStamp(nanoseconds(IOVBegins[0] + 10));
+  BOOST_CHECK(provider.AllChannelsChanged());
+  BOOST_CHECK_EQUAL(provider.ChangedChannels().size(), NChannels);
+
+  // later IOVs: only the channels with different values (all of them when
+  // going back to the first IOV)
+  for (unsigned int iov: { 1U, 2U, 0U }) {
+    unsigned int const previous = (iov == 0)? 2: iov - 1;
+    provider.UpdateTimeStamp(nanoseconds(IOVBegins[iov] + 10));
+    BOOST_CHECK(!provider.AllChannelsChanged());
+    std::vector<unsigned int> expected;
+    for (unsigned int channel = 0; channel < NChannels; ++channel) {
+      unsigned int const last = lariov::DBTestServer::LastUpdate(channel, iov);
+      if (last != lariov::DBTestServer::LastUpdate(channel, previous))
+        expected.push_back(channel);
+      BOOST_CHECK_EQUAL(provider.Status(channel), lariov::DBTestServer::TestLong(channel, last, 1));
+    }
+    std::vector<unsigned int> changed = provider.ChangedChannels();
+    std::sort(changed.begin(), changed.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(changed.begin(), changed.end(), expected.begin(), expected.end());
+  }
+
+} // BOOST_AUTO_TEST_CASE(DeltaUpdates)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(Statistics) {
+
+  lariov::DBFolder folder(Folder, server.URL(), "", "v1");
+  folder.SetCacheSize(IOVBegins.size());
+  folder.SetCompressedTransfer(true);
+
+  server.FailNext(1, 503);
+  BOOST_CHECK_THROW(folder.UpdateData(nanoseconds(IOVBegins[0] + 10)), lariov::WebError);
+  for (long begin: IOVBegins) BOOST_CHECK(folder.UpdateData(nanoseconds(begin + 10)));
+  BOOST_CHECK(folder.UpdateData(nanoseconds(IOVBegins[0] + 10)));
+  BOOST_CHECK(!folder.UpdateData(nanoseconds(IOVBegins[0] + 20)));
+  for (unsigned int channel = 0; channel < 10; ++channel) {
+    double mean = 0.;
+    folder.GetNamedChannelData(channel, "mean", mean);
+  }
+  lariov::DBFolderStats::Counts const counts = folder.Stats().counts();
+  BOOST_CHECK_EQUAL(counts.iov_switches, IOVBegins.size() + 1);
+  BOOST_CHECK_EQUAL(counts.memory_hits, 1U);
+  BOOST_CHECK_EQUAL(counts.memory_misses, IOVBegins.size());
+  BOOST_CHECK_EQUAL(counts.fetches, IOVBegins.size());
+  BOOST_CHECK_EQUAL(counts.fetch_errors, 1U);
+  BOOST_CHECK_GT(counts.bytes_received, 0U);
+  BOOST_CHECK_GT(counts.dataset_bytes, counts.bytes_received);
+  BOOST_CHECK_GT(counts.fetch_seconds, 0.);
+  BOOST_CHECK_GT(counts.parse_seconds, 0.);
+  BOOST_CHECK_EQUAL(counts.lookups, 10U);
+
+  std::ostringstream json;
+  lariov::DBFolderStats::writeJSON(json);
+  BOOST_CHECK(json.str().find("\"folder\": \"" + Folder + "\"") != std::string::npos);
+  BOOST_CHECK(json.str().find("\"fetch_errors\": 1,") != std::string::npos);
+
+  // every conditions service asks for the file at the end of the job; it is written once
+  std::string const path = dir + "/stats.json";
+  lariov::DBFolderStats::setJSONFile(path);
+  lariov::DBFolderStats::writeJSONFile();
+  BOOST_CHECK(std::ifstream(path).good());
+  std::remove(path.c_str());
+  lariov::DBFolderStats::writeJSONFile();
+  BOOST_CHECK(!std::ifstream(path).good());
+  lariov::DBFolderStats::setJSONFile("");
+
+} // BOOST_AUTO_TEST_CASE(Statistics)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(IOVTimeline) {
+
+  lariov::DBFolder http(Folder, server.URL(), "", "v1");
+  http.SetTimeline(true);
+
+  lariov::IOVTimeStamp begin(0), end(0);
+  BOOST_CHECK(!http.GetIOV(lariov::IOVTimeStamp(IOVBegins[0] - 10), begin, end));
+  BOOST_CHECK(http.GetIOV(lariov::IOVTimeStamp(IOVBegins[1] + 10), begin, end));
+  BOOST_CHECK_EQUAL(begin.Stamp(), (unsigned long) IOVBegins[1]);
+  BOOST_CHECK_EQUAL(end.Stamp(), (unsigned long) IOVBegins[2]);
+  BOOST_CHECK_EQUAL(http.NextIOVBoundary(lariov::IOVTimeStamp(IOVBegins[0] - 10)).Stamp(),
+                    (unsigned long) IOVBegins[0]);
+  BOOST_CHECK_EQUAL(http.NextIOVBoundary(lariov::IOVTimeStamp(IOVBegins[0])).Stamp(),
+                    (unsigned long) IOVBegins[1]);
+  BOOST_CHECK(http.NextIOVBoundary(lariov::IOVTimeStamp(IOVBegins[2] + 10))
+              == lariov::IOVTimeStamp::MaxTimeStamp());
+  BOOST_CHECK_EQUAL(server.Requests(), 1U); // the timeline is loaded once
+
+  BOOST_CHECK(http.UpdateData(nanoseconds(IOVBegins[1] + 10)));
+  BOOST_CHECK_EQUAL(http.CachedStart().Stamp(), (unsigned long) IOVBegins[1]);
+  BOOST_CHECK_EQUAL(http.CachedEnd().Stamp(), (unsigned long) IOVBegins[2]);
+  BOOST_CHECK_EQUAL(server.Requests(), 2U);
+
+  // sqlite IOVs resolved from the timeline give the same (merged) datasets
+  setenv("FW_SEARCH_PATH", dir.c_str(), 1);
+  lariov::DBFolder plain(Folder, "", "", "v1", true);
+  lariov::DBFolder indexed(Folder, "", "", "v1", true);
+  indexed.SetTimeline(true);
+  BOOST_CHECK(indexed.Timeline() != nullptr);
+  for (long begin: IOVBegins) {
+    lariov::DBDataset expected, data;
+    plain.GetSQLiteData(begin + 10, expected);
+    indexed.GetSQLiteData(begin + 10, data);
+    BOOST_CHECK(data.beginTime() == expected.beginTime());
+    BOOST_CHECK(data.endTime() == expected.endTime());
+    BOOST_CHECK_EQUAL(data.nrows(), expected.nrows());
+    for (size_t row = 0; row < std::min(data.nrows(), expected.nrows()); ++row)
+      BOOST_CHECK(data.sameRow(row, expected, row));
+  }
+  lariov::DBDataset none;
+  BOOST_CHECK_THROW(indexed.GetSQLiteData(IOVBegins[0] - 10, none), cet::exception);
+
+} // BOOST_AUTO_TEST_CASE(IOVTimeline)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(Preload) {
+
+  // walking IOVs one by one: the range touches the first two IOVs
+  lariov::DBFolder walk(Folder, server.URL(), "", "v1");
+  walk.SetCacheSize(1);
+  BOOST_CHECK_EQUAL
+    (walk.Preload(nanoseconds(IOVBegins[0] + 10), nanoseconds(IOVBegins[1] + 10)), 2U);
+  BOOST_CHECK_EQUAL(server.Requests(), 2U);
+  BOOST_CHECK_EQUAL(walk.DatasetCache().pinned(), 2U);
+  for (long t: { IOVBegins[0] + 20, IOVBegins[1] + 20, IOVBegins[0] + 30 })
+    BOOST_CHECK(walk.UpdateData(nanoseconds(t)));
+  BOOST_CHECK_EQUAL(server.Requests(), 2U); // pinned datasets are not evicted
+  BOOST_CHECK_EQUAL(walk.Stats().counts().memory_hits, 3U);
+
+  // with a timeline, all IOVs are fetched concurrently
+  lariov::DBFolder timeline(Folder, server.URL(), "", "v1");
+  timeline.SetTimeline(true);
+  BOOST_CHECK_EQUAL
+    (timeline.Preload(nanoseconds(IOVBegins[0] - 10), nanoseconds(IOVBegins[2] + 10)), IOVBegins.size());
+  BOOST_CHECK_EQUAL(server.Requests(), 3U + IOVBegins.size());
+  for (unsigned int iov = 0; iov < IOVBegins.size(); ++iov) {
+    BOOST_CHECK(timeline.UpdateData(nanoseconds(IOVBegins[iov] + 10)));
+    double mean = 0.;
+    timeline.GetNamedChannelData(8, "mean", mean);
+    BOOST_CHECK_EQUAL(mean, lariov::DBTestServer::TestValue(8, lariov::DBTestServer::LastUpdate(8, iov), 0));
+  }
+  BOOST_CHECK_EQUAL(server.Requests(), 3U + IOVBegins.size());
+
+  // failures are not fatal
+  lariov::DBFolder failing(Folder, server.URL(), "", "v1");
+  server.FailNext(1, 503);
+  BOOST_CHECK_EQUAL
+    (failing.Preload(nanoseconds(IOVBegins[0] + 10), nanoseconds(IOVBegins[1] + 10)), 0U);
+  BOOST_CHECK(failing.UpdateData(nanoseconds(IOVBegins[0] + 10)));
+
+} // BOOST_AUTO_TEST_CASE(Preload)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(Bundle) {
+
+  // bundle the last two IOVs, as make_db_bundle does
+  std::string const path = dir + "/conditions.bundle";
+  {
+    lariov::DBFolder source(Folder, server.URL(), "", "v1");
+    lariov::DBBundle::Writer writer;
+    for (unsigned int iov = 1; iov < IOVBegins.size(); ++iov) {
+      source.UpdateData(nanoseconds(IOVBegins[iov] + 10));
+      writer.add(Folder, "v1", *source.CurrentDataset());
+    }
+    std::ofstream out(path, std::ios::binary);
+    writer.write(out);
+  }
+  unsigned int const requests = server.Requests();
+
+  lariov::DBFolder folder(Folder, "", "", "v1");
+  folder.SetBundle(path);
+  folder.SetTimeline(true);
+  BOOST_CHECK_EQUAL(folder.NextIOVBoundary(lariov::IOVTimeStamp(IOVBegins[1] + 10)).Stamp(),
+                    (unsigned long) IOVBegins[2]);
+  for (unsigned int iov = 1; iov < IOVBegins.size(); ++iov) {
+    BOOST_CHECK(folder.UpdateData(nanoseconds(IOVBegins[iov] + 10)));
+    BOOST_CHECK_EQUAL(folder.CachedStart().Stamp(), (unsigned long) IOVBegins[iov]);
+    BOOST_CHECK_EQUAL(folder.Channels().size(), NChannels);
+    for (unsigned int channel = 0; channel < NChannels; channel += 11) {
+      unsigned int last = lariov::DBTestServer::LastUpdate(channel, iov);
+      double mean = 0.;
+      std::string label;
+      folder.GetNamedChannelData(channel, "mean", mean);
+      folder.GetNamedChannelData(channel, "label", label);
+      BOOST_CHECK_EQUAL(mean, lariov::DBTestServer::TestValue(channel, last, 0));
+      BOOST_CHECK_EQUAL(label, lariov::DBTestServer::TestText(channel, last, 2));
+    }
+  }
+  BOOST_CHECK_EQUAL(folder.Stats().counts().bundle_hits, IOVBegins.size() - 1);
+  BOOST_CHECK_EQUAL(server.Requests(), requests);
+
+  // outside the bundle, with no other source
+  BOOST_CHECK_THROW(folder.UpdateData(nanoseconds(IOVBegins[0] + 10)), cet::exception);
+  lariov::DBFolder other("other_folder", "", "", "v1");
+  BOOST_CHECK_THROW(other.SetBundle(path), cet::exception);
+
+  // outside the bundle, falling back to the server
+  lariov::DBFolder fallback(Folder, server.URL(), "", "v1");
+  fallback.SetBundle(path);
+  BOOST_CHECK(fallback.UpdateData(nanoseconds(IOVBegins[0] + 10)));
+  BOOST_CHECK_EQUAL(server.Requests(), requests + 1);
+
+  std::remove(path.c_str());
+
+} // BOOST_AUTO_TEST_CASE(Bundle)
+
+BOOST_AUTO_TEST_SUITE_END()
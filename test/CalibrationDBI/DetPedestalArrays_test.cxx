@@ -0,0 +1,131 @@
+/**
+ * @file   DetPedestalArrays_test.cxx
+ * @brief  Aligned pedestal arrays and batch pedestal subtraction
+ * @see    DetPedestalArrays.h
+ *
+ * The arrays must hold the pedestal of every channel of the snapshot, and the
+ * (SIMD) batch subtraction must give the same result as the scalar
+ * `adc - PedMean()` for any number of ticks and any buffer alignment.
+ */
+
+// Boost libraries
+#define BOOST_TEST_MODULE ( detpedestalarrays_test )
+#include <cetlib/quiet_unit_test.hpp> // BOOST_AUTO_TEST_CASE()
+#include <boost/test/test_tools.hpp> // BOOST_CHECK(), BOOST_CHECK_EQUAL()
+
+// LArSoft libraries
+#include "larevt/CalibrationDBI/IOVData/DetPedestalArrays.h"
+#include "larevt/CalibrationDBI/IOVData/IOVDataConstants.h"
+#include "larevt/CalibrationDBI/IOVData/IOVDataError.h"
+
+// C/C++ standard libraries
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+  lariov::DetPedestal MakePedestal(unsigned int ch) {
+    lariov::DetPedestal ped(ch);
+    ped.SetPedMean(400.f + 0.25f * ch);
+    ped.SetPedRms(1.f + 0.5f * (ch % 7));
+    ped.SetPedMeanErr(0.f);
+    ped.SetPedRmsErr(0.f);
+    return ped;
+  }
+
+} // local namespace
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(Arrays) {
+
+  // every third channel missing
+  lariov::Snapshot<lariov::DetPedestal> data;
+  for (unsigned int ch = 1000; ch < 9000; ++ch)
+    if (ch % 3 != 0) data.AppendRow(MakePedestal(ch));
+  data.Finalize();
+
+  lariov::DetPedestalArrays arrays;
+  arrays.Fill(data);
+  BOOST_CHECK(arrays.Valid());
+  BOOST_CHECK_EQUAL(arrays.FirstChannel(), 1000U);
+  BOOST_CHECK_EQUAL(arrays.NChannels(), 8000U);
+  BOOST_CHECK_EQUAL(reinterpret_cast<std::uintptr_t>(arrays.PedMean()) % lariov::kPEDESTAL_ALIGNMENT, 0U);
+  BOOST_CHECK_EQUAL(reinterpret_cast<std::uintptr_t>(arrays.PedRms()) % lariov::kPEDESTAL_ALIGNMENT, 0U);
+
+  unsigned int mismatches = 0;
+  for (unsigned int ch = 900; ch < 9100; ++ch) {
+    bool present = ch >= 1000 && ch < 9000 && ch % 3 != 0;
+    if (arrays.HasChannel(ch) != present) ++mismatches;
+    if (!present) continue;
+    lariov::DetPedestal const& ped = data.GetRow(ch);
+    size_t i = ch - arrays.FirstChannel();
+    if (arrays.PedMean()[i] != ped.PedMean() || arrays.PedRms()[i] != ped.PedRms()) ++mismatches;
+  }
+  BOOST_CHECK_EQUAL(mismatches, 0U);
+
+  // sparse channels are not converted
+  lariov::Snapshot<lariov::DetPedestal> sparse;
+  for (unsigned int ch = 0; ch < 1000000; ch += 10000) sparse.AppendRow(MakePedestal(ch));
+  sparse.Finalize();
+  arrays.Fill(sparse);
+  BOOST_CHECK(!arrays.Valid());
+  BOOST_CHECK(!arrays.HasChannel(0));
+
+} // BOOST_AUTO_TEST_CASE(Arrays)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(Subtraction) {
+
+  std::mt19937 random(20201116);
+  std::uniform_int_distribution<int> sample
+    (std::numeric_limits<short>::min(), std::numeric_limits<short>::max());
+
+  // any length and (mis)alignment against the scalar subtraction
+  std::vector<short> adc(80);
+  std::vector<float> out(80);
+  unsigned int mismatches = 0;
+  for (size_t offset = 0; offset < 8; ++offset) {
+    for (size_t n = 0; n + offset <= adc.size(); ++n) {
+      for (short& s: adc) s = sample(random);
+      std::fill(out.begin(), out.end(), -1.f);
+      lariov::DetPedestalArrays::Subtract(adc.data() + offset, 2048.5f, n, out.data() + offset);
+      for (size_t i = 0; i < out.size(); ++i) {
+        bool inside = i >= offset && i < offset + n;
+        if (out[i] != (inside ? adc[i] - 2048.5f : -1.f)) ++mismatches;
+      }
+    }
+  }
+  BOOST_CHECK_EQUAL(mismatches, 0U);
+
+  // block of channels
+  lariov::Snapshot<lariov::DetPedestal> data;
+  for (unsigned int ch = 0; ch < 100; ++ch)
+    if (ch != 50) data.AppendRow(MakePedestal(ch));
+  data.Finalize();
+  lariov::DetPedestalArrays arrays;
+  arrays.Fill(data);
+
+  size_t const n_ticks = 37;
+  std::vector<short> block(20 * n_ticks);
+  for (short& s: block) s = sample(random);
+  std::vector<float> result(block.size());
+  arrays.SubtractPedestals(10, 20, n_ticks, block.data(), result.data());
+  mismatches = 0;
+  for (size_t c = 0; c < 20; ++c)
+    for (size_t t = 0; t < n_ticks; ++t)
+      if (result[c * n_ticks + t] != block[c * n_ticks + t] - data.GetRow(10 + c).PedMean()) ++mismatches;
+  BOOST_CHECK_EQUAL(mismatches, 0U);
+
+  // missing channel
+  BOOST_CHECK_THROW(arrays.SubtractPedestals(40, 20, n_ticks, block.data(), result.data()),
+                    lariov::IOVDataError);
+  BOOST_CHECK_THROW(arrays.SubtractPedestals(90, 20, n_ticks, block.data(), result.data()),
+                    lariov::IOVDataError);
+
+} // BOOST_AUTO_TEST_CASE(Subtraction)
@@ -0,0 +1,167 @@
+/**
+ * @file   Snapshot_test.cxx
+ * @brief  Channel lookups of Snapshot with and without the direct index
+ * @see    Snapshot.h
+ *
+ * Dense channel sets are looked up through the direct channel index, sparse
+ * ones by binary search.  Both must find exactly the rows that were added,
+ * also after rows were inserted out of order, replaced or removed, or bulk
+ * appended in any order (the last row of a channel wins).
+ */
+
+// Boost libraries
+#define BOOST_TEST_MODULE ( snapshot_test )
+#include <cetlib/quiet_unit_test.hpp> // BOOST_AUTO_TEST_CASE()
+#include <boost/test/test_tools.hpp> // BOOST_CHECK(), BOOST_CHECK_EQUAL()
+
+// LArSoft libraries
+#include "larevt/CalibrationDBI/IOVData/Snapshot.h"
+#include "larevt/CalibrationDBI/IOVData/ChannelStatus.h"
+#include "larevt/CalibrationDBI/IOVData/IOVDataError.h"
+
+// C/C++ standard libraries
+#include <map>
+#include <random>
+
+
+namespace {
+
+  using Snapshot_t = lariov::Snapshot<lariov::ChannelStatus>;
+
+  void Add(Snapshot_t& snapshot, std::map<unsigned int, int>& expected,
+           unsigned int ch, int status) {
+    lariov::ChannelStatus cs(ch);
+    cs.SetStatus(lariov::ChannelStatus::GetStatusFromInt(status));
+    snapshot.AddOrReplaceRow(cs);
+    expected[ch] = status;
+  }
+
+  void Append(Snapshot_t& snapshot, std::map<unsigned int, int>& expected,
+              unsigned int ch, int status) {
+    lariov::ChannelStatus cs(ch);
+    cs.SetStatus(lariov::ChannelStatus::GetStatusFromInt(status));
+    snapshot.AppendRow(cs);
+    expected[ch] = status;
+  }
+
+  /// Checks every channel from 0 to `max_channel` against `expected`
+  void CheckLookups(Snapshot_t const& snapshot, std::map<unsigned int, int> const& expected,
+                    unsigned int max_channel) {
+
+    BOOST_CHECK_EQUAL(snapshot.NChannels(), expected.size());
+    unsigned int mismatches = 0;
+    for (unsigned int ch = 0; ch <= max_channel; ++ch) {
+      auto it = expected.find(ch);
+      lariov::ChannelStatus const* row = snapshot.FindRow(ch);
+      if (it == expected.end()) {
+        if (row != nullptr || snapshot.HasChannel(ch)) ++mismatches;
+        BOOST_CHECK_THROW(snapshot.GetRow(ch), lariov::IOVDataError);
+      }
+      else if (row == nullptr || row->Channel() != ch || (int)row->Status() != it->second
+               || &snapshot.GetRow(ch) != row) {
+        ++mismatches;
+      }
+    }
+    BOOST_CHECK_EQUAL(mismatches, 0U);
+  }
+
+} // local namespace
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(DenseChannels) {
+
+  // channels appended in order keep the index
+  Snapshot_t snapshot;
+  std::map<unsigned int, int> expected;
+  for (unsigned int ch = 100; ch < 20000; ++ch)
+    if (ch % 7 != 0) Add(snapshot, expected, ch, ch % 5);
+  BOOST_CHECK(snapshot.IsIndexed());
+  CheckLookups(snapshot, expected, 20100);
+
+  // replacing rows keeps it
+  for (unsigned int ch = 101; ch < 20000; ch += 3)
+    if (ch % 7 != 0) Add(snapshot, expected, ch, 3);
+  BOOST_CHECK(snapshot.IsIndexed());
+  CheckLookups(snapshot, expected, 20100);
+
+  // inserting and removing rows falls back to the search until the rebuild
+  Add(snapshot, expected, 700, 4);
+  snapshot.RemoveRow(701);
+  expected.erase(701);
+  BOOST_CHECK(!snapshot.IsIndexed());
+  CheckLookups(snapshot, expected, 20100);
+  snapshot.BuildIndex();
+  BOOST_CHECK(snapshot.IsIndexed());
+  CheckLookups(snapshot, expected, 20100);
+
+  // out of order fill
+  snapshot.Clear();
+  expected.clear();
+  std::mt19937 random(20201102);
+  std::uniform_int_distribution<unsigned int> channel(0, 9999);
+  for (unsigned int i = 0; i < 8000; ++i) Add(snapshot, expected, channel(random), i % 5);
+  snapshot.BuildIndex();
+  BOOST_CHECK(snapshot.IsIndexed());
+  CheckLookups(snapshot, expected, 10100);
+
+} // BOOST_AUTO_TEST_CASE(DenseChannels)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(SparseChannels) {
+
+  Snapshot_t snapshot;
+  std::map<unsigned int, int> expected;
+  for (unsigned int ch = 0; ch < 100000; ch += 1000) Add(snapshot, expected, ch, 1);
+  BOOST_CHECK(!snapshot.IsIndexed());
+  CheckLookups(snapshot, expected, 100100);
+
+  snapshot.BuildIndex();
+  BOOST_CHECK(!snapshot.IsIndexed());
+  CheckLookups(snapshot, expected, 100100);
+
+  // an empty snapshot has a (trivial) index
+  snapshot.Clear();
+  expected.clear();
+  BOOST_CHECK(snapshot.IsIndexed());
+  CheckLookups(snapshot, expected, 100);
+
+} // BOOST_AUTO_TEST_CASE(SparseChannels)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(BulkAppend) {
+
+  Snapshot_t snapshot;
+  std::map<unsigned int, int> expected;
+  std::mt19937 random(20201109);
+  std::uniform_int_distribution<unsigned int> channel(0, 4999);
+
+  // unsorted, with duplicates
+  snapshot.Reserve(6000);
+  for (unsigned int i = 0; i < 6000; ++i) Append(snapshot, expected, channel(random), i % 5);
+  snapshot.Finalize();
+  BOOST_CHECK(snapshot.IsIndexed());
+  CheckLookups(snapshot, expected, 5100);
+  for (size_t i = 1; i < snapshot.NChannels(); ++i)
+    BOOST_CHECK_LT(snapshot.Data()[i - 1].Channel(), snapshot.Data()[i].Channel());
+
+  // incremental update: appended rows replace existing ones
+  snapshot.ClearChanges();
+  snapshot.RemoveRow(snapshot.Data().front().Channel());
+  expected.erase(expected.begin());
+  for (unsigned int i = 0; i < 500; ++i) Append(snapshot, expected, channel(random), 2);
+  snapshot.Finalize();
+  CheckLookups(snapshot, expected, 5100);
+  BOOST_CHECK_EQUAL(snapshot.ChangedChannels().size(), 501U);
+
+  // in order appends need no sort
+  snapshot.Clear();
+  expected.clear();
+  for (unsigned int ch = 0; ch < 3000; ch += 2) Append(snapshot, expected, ch, 1);
+  BOOST_CHECK(snapshot.IsIndexed());
+  snapshot.Finalize();
+  CheckLookups(snapshot, expected, 3100);
+
+} // BOOST_AUTO_TEST_CASE(BulkAppend)
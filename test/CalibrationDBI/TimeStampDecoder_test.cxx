@@ -0,0 +1,120 @@
+/**
+ * @file   TimeStampDecoder_test.cxx
+ * @brief  Equivalence of the arithmetic TimeStampDecoder with the string one
+ * @see    TimeStampDecoder.h
+ *
+ * `ReferenceDecode()` is the former string based implementation of
+ * `TimeStampDecoder::DecodeTimeStamp()`.  Both must give the same time stamp,
+ * or both must throw, for every raw time stamp: all short values, all values
+ * around every power of ten, and a large random sample of 19-digit values.
+ */
+
+// Boost libraries
+#define BOOST_TEST_MODULE ( timestampdecoder_test )
+#include <cetlib/quiet_unit_test.hpp> // BOOST_AUTO_TEST_CASE()
+#include <boost/test/test_tools.hpp> // BOOST_CHECK(), BOOST_CHECK_EQUAL()
+
+// LArSoft libraries
+#include "larevt/CalibrationDBI/IOVData/TimeStampDecoder.h"
+#include "larevt/CalibrationDBI/IOVData/IOVDataConstants.h"
+#include "larevt/CalibrationDBI/IOVData/IOVDataError.h"
+
+// C/C++ standard libraries
+#include <limits>
+#include <random>
+#include <string>
+
+
+namespace {
+
+  /// Former implementation, converting through strings
+  lariov::IOVTimeStamp ReferenceDecode(lariov::DBTimeStamp_t ts) {
+
+    std::string time = std::to_string(ts);
+    if (time.length() == 19) {
+      time = time.substr(0, 10 + lariov::kMAX_SUBSTAMP_LENGTH);
+      time.insert(10, ".");
+      return lariov::IOVTimeStamp::GetFromString(time);
+    }
+    else if (time.length() < lariov::kMAX_SUBSTAMP_LENGTH && ts != 0) {
+      return lariov::IOVTimeStamp::GetFromString(time);
+    }
+    else {
+      throw lariov::IOVDataError("TimeStampDecoder: I do not know how to convert this timestamp: " + time);
+    }
+  }
+
+  /// Returns whether both decoders agree on `ts` (same result, or both throw)
+  bool Agree(lariov::DBTimeStamp_t ts) {
+
+    bool reference_threw = false;
+    bool decoder_threw = false;
+    lariov::IOVTimeStamp expected(0), decoded(0);
+    try { expected = ReferenceDecode(ts); }
+    catch (lariov::IOVDataError&) { reference_threw = true; }
+    try { decoded = lariov::TimeStampDecoder::DecodeTimeStamp(ts); }
+    catch (lariov::IOVDataError&) { decoder_threw = true; }
+    if (reference_threw || decoder_threw) return reference_threw == decoder_threw;
+    return decoded == expected;
+  }
+
+  // usable in constant expressions
+  static_assert(lariov::TimeStampDecoder::DecodeTimeStamp(1500001234567891234ULL)
+                == lariov::IOVTimeStamp(1500001234, 567891));
+  static_assert(lariov::TimeStampDecoder::DecodeTimeStamp(12345) == lariov::IOVTimeStamp(12345, 0));
+
+} // local namespace
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(ShortTimeStamps) {
+
+  unsigned int mismatches = 0;
+  for (lariov::DBTimeStamp_t ts = 0; ts <= 1000000; ++ts)
+    if (!Agree(ts)) ++mismatches;
+  BOOST_CHECK_EQUAL(mismatches, 0U);
+
+} // BOOST_AUTO_TEST_CASE(ShortTimeStamps)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(DigitBoundaries) {
+
+  // around every power of ten, including the 19/20 digit boundary
+  lariov::DBTimeStamp_t const max = std::numeric_limits<lariov::DBTimeStamp_t>::max();
+  lariov::DBTimeStamp_t power = 1;
+  for (int digits = 1; digits <= 20; ++digits) {
+    for (lariov::DBTimeStamp_t d = 0; d <= 1000; ++d) {
+      BOOST_CHECK_MESSAGE(Agree(power + d), "time stamp " << power + d);
+      if (power > d) BOOST_CHECK_MESSAGE(Agree(power - d), "time stamp " << power - d);
+    }
+    if (power > max / 10) break;
+    power *= 10;
+  }
+  for (lariov::DBTimeStamp_t d = 0; d <= 1000; ++d)
+    BOOST_CHECK_MESSAGE(Agree(max - d), "time stamp " << max - d);
+
+  // microsecond boundaries of a 19-digit time stamp
+  lariov::DBTimeStamp_t const base = 1500001234000000000ULL;
+  for (lariov::DBTimeStamp_t ns = 0; ns < 1000000000; ns += 997)
+    BOOST_CHECK_MESSAGE(Agree(base + ns), "time stamp " << base + ns);
+
+} // BOOST_AUTO_TEST_CASE(DigitBoundaries)
+
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE(RandomTimeStamps) {
+
+  std::mt19937_64 random(20201026);
+  std::uniform_int_distribution<lariov::DBTimeStamp_t> nineteen_digits
+    (1000000000000000000ULL, 9999999999999999999ULL);
+  std::uniform_int_distribution<lariov::DBTimeStamp_t> any;
+
+  unsigned int mismatches = 0;
+  for (unsigned int i = 0; i < 2000000; ++i) {
+    if (!Agree(nineteen_digits(random))) ++mismatches;
+    if (!Agree(any(random) >> (i % 64))) ++mismatches;
+  }
+  BOOST_CHECK_EQUAL(mismatches, 0U);
+
+} // BOOST_AUTO_TEST_CASE(RandomTimeStamps)